@@ -0,0 +1,387 @@
+/* Linux io_uring(7) based ae.c module
+ * Released under the BSD license. See the COPYING file for more info.
+ *
+ * File events are implemented as one-shot IORING_OP_POLL_ADD requests, one
+ * per fd and direction. Arming, re-arming and removing polls only queues
+ * SQEs: they reach the kernel together with the wait in a single
+ * io_uring_enter() call per event loop iteration, instead of costing one
+ * epoll_ctl() each.
+ *
+ * Multishot polls are not used on purpose: they only post a completion
+ * when the socket wait queue is woken up, so a handler that does not drain
+ * the socket (hiredis reads a bounded chunk per event) would never be
+ * called again for the remaining data. One-shot polls are level triggered
+ * when armed, exactly like the other ae modules.
+ *
+ * When the running kernel can't setup a ring with the features we need,
+ * the epoll module is used instead. */
+
+#include <errno.h>
+#include <string.h>
+#include <endian.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+/* Pull in the epoll module under different names, as runtime fallback. */
+#define aeApiState aeEpollState
+#define aeApiCreate aeEpollCreate
+#define aeApiFree aeEpollFree
+#define aeApiAddEvent aeEpollAddEvent
+#define aeApiDelEvent aeEpollDelEvent
+#define aeApiPoll aeEpollPoll
+#define aeApiName aeEpollName
+#include "ae_epoll.c"
+#undef aeApiState
+#undef aeApiCreate
+#undef aeApiFree
+#undef aeApiAddEvent
+#undef aeApiDelEvent
+#undef aeApiPoll
+#undef aeApiName
+
+#define AE_URING_ENTRIES 4096 /* SQ entries, the kernel makes the CQ twice as big */
+
+/* The user_data of every poll request encodes the fd in the low 32 bits,
+ * the direction (0 = readable, 1 = writable) in bit 32 and the generation
+ * of the request in the remaining bits, so that completions of requests
+ * that were removed or replaced in the meantime can be detected. */
+#define AE_URING_GENMASK 0x7fffffffU
+#define AE_URING_DATA(fd,dir,gen) ((unsigned long long)(unsigned)(fd) | \
+                                   ((unsigned long long)(dir) << 32) | \
+                                   ((unsigned long long)((gen) & AE_URING_GENMASK) << 33))
+#define AE_URING_NOOP_DATA (~0ULL) /* POLL_REMOVE completions, ignored */
+
+typedef struct aeUringPoll {
+    unsigned int gen; /* generation of the last armed request */
+    int armed;        /* request in flight for this fd/direction */
+} aeUringPoll;
+
+typedef struct aeApiState {
+    void *epoll; /* epoll state when io_uring is not available */
+    int ringfd;
+
+    /* Submission queue ring */
+    void *sqring;
+    size_t sqringsize;
+    unsigned *sqhead, *sqtail, *sqmask, *sqarray;
+    unsigned sqentries;
+    struct io_uring_sqe *sqes;
+    size_t sqessize;
+    unsigned pending; /* SQEs queued but not yet submitted */
+
+    /* Completion queue ring */
+    void *cqring;
+    size_t cqringsize;
+    unsigned *cqhead, *cqtail, *cqmask;
+    struct io_uring_cqe *cqes;
+
+    aeUringPoll polls[AE_SETSIZE][2];
+    int firedidx[AE_SETSIZE]; /* fired[] slot+1 of an fd in the current poll */
+    int lastfired; /* number of fired events returned by the last poll */
+} aeApiState;
+
+/* Name of the module selected by the last aeApiCreate(). */
+static int aeUringUsed = 0;
+
+/* The epoll functions find their state in eventLoop->apidata, so the
+ * fallback state is swapped in for the duration of the call. */
+#define aeUringFallback(el,state,call) do { \
+    (el)->apidata = (state)->epoll; \
+    call; \
+    (el)->apidata = (state); \
+} while(0)
+
+static int aeUringSetup(aeApiState *state) {
+    struct io_uring_params p;
+    int fd;
+
+    memset(&p,0,sizeof(p));
+    fd = syscall(__NR_io_uring_setup,AE_URING_ENTRIES,&p);
+    if (fd == -1) return -1;
+
+    /* EXT_ARG is needed to wait with a timeout in the same io_uring_enter()
+     * call that submits, NODROP so that a burst of completions larger than
+     * the CQ can't be lost. */
+    if (!(p.features & IORING_FEAT_EXT_ARG) ||
+        !(p.features & IORING_FEAT_NODROP))
+    {
+        close(fd);
+        return -1;
+    }
+
+    state->sqringsize = p.sq_off.array + p.sq_entries*sizeof(unsigned);
+    state->cqringsize = p.cq_off.cqes + p.cq_entries*sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (state->cqringsize > state->sqringsize)
+            state->sqringsize = state->cqringsize;
+        state->cqringsize = state->sqringsize;
+    }
+
+    state->sqring = mmap(NULL,state->sqringsize,PROT_READ|PROT_WRITE,
+        MAP_SHARED,fd,IORING_OFF_SQ_RING);
+    if (state->sqring == MAP_FAILED) goto err;
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        state->cqring = state->sqring;
+    } else {
+        state->cqring = mmap(NULL,state->cqringsize,PROT_READ|PROT_WRITE,
+            MAP_SHARED,fd,IORING_OFF_CQ_RING);
+        if (state->cqring == MAP_FAILED) goto err;
+    }
+    state->sqessize = p.sq_entries*sizeof(struct io_uring_sqe);
+    state->sqes = mmap(NULL,state->sqessize,PROT_READ|PROT_WRITE,
+        MAP_SHARED,fd,IORING_OFF_SQES);
+    if (state->sqes == MAP_FAILED) goto err;
+
+    state->sqhead = (unsigned*)((char*)state->sqring+p.sq_off.head);
+    state->sqtail = (unsigned*)((char*)state->sqring+p.sq_off.tail);
+    state->sqmask = (unsigned*)((char*)state->sqring+p.sq_off.ring_mask);
+    state->sqarray = (unsigned*)((char*)state->sqring+p.sq_off.array);
+    state->sqentries = p.sq_entries;
+    state->cqhead = (unsigned*)((char*)state->cqring+p.cq_off.head);
+    state->cqtail = (unsigned*)((char*)state->cqring+p.cq_off.tail);
+    state->cqmask = (unsigned*)((char*)state->cqring+p.cq_off.ring_mask);
+    state->cqes = (struct io_uring_cqe*)((char*)state->cqring+p.cq_off.cqes);
+    state->ringfd = fd;
+    return 0;
+
+err:
+    if (state->sqring != MAP_FAILED)
+        munmap(state->sqring,state->sqringsize);
+    if (state->cqring != MAP_FAILED && state->cqring != state->sqring)
+        munmap(state->cqring,state->cqringsize);
+    close(fd);
+    return -1;
+}
+
+/* Submit the queued SQEs, optionally waiting for at least one completion
+ * for at most the time specified by tvp (forever if NULL). */
+static int aeUringEnter(aeApiState *state, int wait, struct timeval *tvp) {
+    struct io_uring_getevents_arg arg;
+    struct __kernel_timespec ts;
+    unsigned flags = 0;
+    void *argp = NULL;
+    size_t argsz = 0;
+    int retval;
+
+    if (wait) {
+        flags |= IORING_ENTER_GETEVENTS;
+        if (tvp) {
+            ts.tv_sec = tvp->tv_sec;
+            ts.tv_nsec = tvp->tv_usec*1000;
+            memset(&arg,0,sizeof(arg));
+            arg.ts = (unsigned long long)(size_t)&ts;
+            flags |= IORING_ENTER_EXT_ARG;
+            argp = &arg;
+            argsz = sizeof(arg);
+        }
+    }
+    retval = syscall(__NR_io_uring_enter,state->ringfd,state->pending,
+        wait ? 1 : 0,flags,argp,argsz);
+    if (retval == -1) {
+        /* Timeouts and signals are not errors for the caller. */
+        if (errno == ETIME || errno == EINTR) return 0;
+        return -1;
+    }
+    state->pending -= retval;
+    return 0;
+}
+
+/* Return a zeroed SQE. It is handed to the kernel by aeUringCommit(). */
+static struct io_uring_sqe *aeUringGetSqe(aeApiState *state) {
+    unsigned head = __atomic_load_n(state->sqhead,__ATOMIC_ACQUIRE);
+    unsigned tail = *state->sqtail;
+    struct io_uring_sqe *sqe;
+
+    if (tail-head >= state->sqentries) {
+        /* The SQ is full: submit without waiting to make room. */
+        if (aeUringEnter(state,0,NULL) == -1) return NULL;
+        head = __atomic_load_n(state->sqhead,__ATOMIC_ACQUIRE);
+        if (tail-head >= state->sqentries) return NULL;
+    }
+    sqe = &state->sqes[tail & *state->sqmask];
+    memset(sqe,0,sizeof(*sqe));
+    return sqe;
+}
+
+static void aeUringCommit(aeApiState *state) {
+    unsigned tail = *state->sqtail;
+    unsigned idx = tail & *state->sqmask;
+
+    state->sqarray[idx] = idx;
+    __atomic_store_n(state->sqtail,tail+1,__ATOMIC_RELEASE);
+    state->pending++;
+}
+
+static int aeUringArm(aeApiState *state, int fd, int dir) {
+    aeUringPoll *p = &state->polls[fd][dir];
+    struct io_uring_sqe *sqe = aeUringGetSqe(state);
+    unsigned events = dir ? POLLOUT : POLLIN;
+
+    if (!sqe) return -1;
+    p->gen++;
+    p->armed = 1;
+#if __BYTE_ORDER == __BIG_ENDIAN
+    events = (events << 16) | (events >> 16);
+#endif
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = events;
+    sqe->user_data = AE_URING_DATA(fd,dir,p->gen);
+    aeUringCommit(state);
+    return 0;
+}
+
+static void aeUringDisarm(aeApiState *state, int fd, int dir) {
+    aeUringPoll *p = &state->polls[fd][dir];
+    struct io_uring_sqe *sqe;
+
+    if (!p->armed) return;
+    /* Even if the remove can't be queued the request is ignored from now
+     * on, since completions are only accepted for armed polls. */
+    p->armed = 0;
+    if ((sqe = aeUringGetSqe(state)) == NULL) return;
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = AE_URING_DATA(fd,dir,p->gen);
+    sqe->user_data = AE_URING_NOOP_DATA;
+    aeUringCommit(state);
+}
+
+static int aeApiCreate(aeEventLoop *eventLoop) {
+    aeApiState *state = zmalloc(sizeof(aeApiState));
+
+    if (!state) return -1;
+    memset(state,0,sizeof(*state));
+    state->ringfd = -1;
+    state->sqring = state->cqring = MAP_FAILED;
+    if (aeUringSetup(state) == -1) {
+        /* No usable io_uring on this kernel, fall back to epoll. */
+        if (aeEpollCreate(eventLoop) == -1) {
+            zfree(state);
+            return -1;
+        }
+        state->epoll = eventLoop->apidata;
+    }
+    aeUringUsed = (state->ringfd != -1);
+    eventLoop->apidata = state;
+    return 0;
+}
+
+static void aeApiFree(aeEventLoop *eventLoop) {
+    aeApiState *state = eventLoop->apidata;
+
+    if (state->ringfd == -1) {
+        aeUringFallback(eventLoop,state,aeEpollFree(eventLoop));
+    } else {
+        munmap(state->sqes,state->sqessize);
+        if (state->cqring != state->sqring)
+            munmap(state->cqring,state->cqringsize);
+        munmap(state->sqring,state->sqringsize);
+        close(state->ringfd);
+    }
+    zfree(state);
+}
+
+static int aeApiAddEvent(aeEventLoop *eventLoop, int fd, int mask) {
+    aeApiState *state = eventLoop->apidata;
+    int retval = 0;
+
+    if (state->ringfd == -1) {
+        aeUringFallback(eventLoop,state,
+            retval = aeEpollAddEvent(eventLoop,fd,mask));
+        return retval;
+    }
+    if (mask & AE_READABLE && !state->polls[fd][0].armed)
+        if (aeUringArm(state,fd,0) == -1) return -1;
+    if (mask & AE_WRITABLE && !state->polls[fd][1].armed)
+        if (aeUringArm(state,fd,1) == -1) return -1;
+    return 0;
+}
+
+static void aeApiDelEvent(aeEventLoop *eventLoop, int fd, int delmask) {
+    aeApiState *state = eventLoop->apidata;
+
+    if (state->ringfd == -1) {
+        aeUringFallback(eventLoop,state,
+            aeEpollDelEvent(eventLoop,fd,delmask));
+        return;
+    }
+    if (delmask & AE_READABLE) aeUringDisarm(state,fd,0);
+    if (delmask & AE_WRITABLE) aeUringDisarm(state,fd,1);
+}
+
+static int aeApiPoll(aeEventLoop *eventLoop, struct timeval *tvp) {
+    aeApiState *state = eventLoop->apidata;
+    unsigned head, tail;
+    int j, wait, numevents = 0;
+
+    if (state->ringfd == -1) {
+        aeUringFallback(eventLoop,state,
+            numevents = aeEpollPoll(eventLoop,tvp));
+        return numevents;
+    }
+
+    /* Polls are one-shot: re-arm the ones that fired in the previous
+     * iteration and are still registered after their handlers ran. */
+    for (j = 0; j < state->lastfired; j++) {
+        int fd = eventLoop->fired[j].fd;
+        int mask = eventLoop->events[fd].mask;
+
+        if (mask & AE_READABLE && !state->polls[fd][0].armed)
+            aeUringArm(state,fd,0);
+        if (mask & AE_WRITABLE && !state->polls[fd][1].armed)
+            aeUringArm(state,fd,1);
+    }
+
+    /* Don't block if completions are already there or we were asked to
+     * return ASAP. */
+    wait = !(tvp && tvp->tv_sec == 0 && tvp->tv_usec == 0);
+    if (*state->cqhead != __atomic_load_n(state->cqtail,__ATOMIC_ACQUIRE))
+        wait = 0;
+    if (aeUringEnter(state,wait,tvp) == -1) {
+        state->lastfired = 0;
+        return 0;
+    }
+
+    head = *state->cqhead;
+    tail = __atomic_load_n(state->cqtail,__ATOMIC_ACQUIRE);
+    while (head != tail && numevents < AE_SETSIZE) {
+        struct io_uring_cqe *cqe = &state->cqes[head & *state->cqmask];
+        unsigned long long data = cqe->user_data;
+        int fd, dir, mask;
+        aeUringPoll *p;
+
+        head++;
+        if (data == AE_URING_NOOP_DATA) continue;
+        fd = (int)(data & 0xffffffffULL);
+        dir = (int)((data >> 32) & 1);
+        p = &state->polls[fd][dir];
+        /* Skip completions of removed or replaced requests. */
+        if (!p->armed || (p->gen & AE_URING_GENMASK) != (data >> 33))
+            continue;
+        p->armed = 0;
+
+        /* Errors and hangups are reported in the direction of the poll,
+         * the handler will get the error performing the I/O. */
+        mask = dir ? AE_WRITABLE : AE_READABLE;
+        if (state->firedidx[fd]) {
+            eventLoop->fired[state->firedidx[fd]-1].mask |= mask;
+        } else {
+            eventLoop->fired[numevents].fd = fd;
+            eventLoop->fired[numevents].mask = mask;
+            state->firedidx[fd] = ++numevents;
+        }
+    }
+    __atomic_store_n(state->cqhead,head,__ATOMIC_RELEASE);
+
+    for (j = 0; j < numevents; j++)
+        state->firedidx[eventLoop->fired[j].fd] = 0;
+    state->lastfired = numevents;
+    return numevents;
+}
+
+static char *aeApiName(void) {
+    return aeUringUsed ? "io_uring" : aeEpollName();
+}
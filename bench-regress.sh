@@ -0,0 +1,136 @@
+#!/bin/bash
+#
+# Regression benchmark for redis-load and hiredis.
+#
+# Runs a fixed matrix of scenarios (parser microbenchmarks, async PING,
+# pipelined SET/GET, large values, redis-load) against the stand-in server
+# a few times, and writes the median and the noise (relative standard
+# deviation, in percent) of every scenario to the results file, one line
+# "scenario median noise unit" each. Higher values are better.
+#
+# The results are then compared with the stored baseline. A scenario has
+# regressed when it is slower than the baseline by more than three times
+# the larger noise of the two measurements, and never less than the
+# minimum threshold. The exit status is 1 when something regressed.
+#
+# Usage: ./bench-regress.sh [-n runs] [-b baseline] [-o results] [-t min%] [-s]
+#   -n  runs of every scenario (default 5)
+#   -b  baseline file (default bench-baseline.txt)
+#   -o  results file (default bench-results.txt)
+#   -t  minimum regression threshold in percent (default 3)
+#   -s  store the results as the new baseline instead of comparing
+
+set -e
+set -o pipefail
+cd "$(dirname "$0")"
+
+RUNS=5
+BASELINE=bench-baseline.txt
+RESULTS=bench-results.txt
+MINTHRESHOLD=3
+SAVE=0
+
+while getopts "n:b:o:t:s" opt; do
+    case $opt in
+    n) RUNS=$OPTARG ;;
+    b) BASELINE=$OPTARG ;;
+    o) RESULTS=$OPTARG ;;
+    t) MINTHRESHOLD=$OPTARG ;;
+    s) SAVE=1 ;;
+    *) sed -n '16,21p' "$0"; exit 2 ;;
+    esac
+done
+
+SAMPLES=$(mktemp)
+trap 'rm -f $SAMPLES' EXIT
+
+# Every scenario appends "scenario value unit" lines to $SAMPLES, and
+# check fails the run when one of them appended nothing, so a scenario can
+# not silently go missing from the results and the baseline.
+check() {
+    if [ $(wc -l < $SAMPLES) -le $LINES ]; then
+        echo "Scenario '$1' produced no results" >&2
+        exit 1
+    fi
+    LINES=$(wc -l < $SAMPLES)
+}
+LINES=0
+
+# The reader is linked with the rpath ".", so it runs from its directory.
+parser() {
+    (cd deps/hiredis && ./hiredis-bench-reader 5 csv) |
+        awk -F, '{print "parser-" $1 "-" $2, $4, "replies/s"}' >> $SAMPLES
+    check parser
+}
+
+adapters() {
+    local name=$1; shift
+    ./redis-bench-adapters csv loop ae-coalesce "$@" |
+        awk -F, -v name=$name '{print name, $2, "req/s"}' >> $SAMPLES
+    check $name
+}
+
+load() {
+    ./redis-load standin seed 1 quiet "$@" |
+        awk '/requests per second/ {print "load-standin", $1, "req/s"}' \
+        >> $SAMPLES
+    check load-standin
+}
+
+for run in $(seq $RUNS); do
+    echo "Run $run of $RUNS..." >&2
+    parser
+    adapters async-ping workload ping requests 100000
+    adapters pipelined-setget workload setget pipeline 32 requests 200000
+    adapters large-values workload setget datasize 65536 pipeline 4 \
+        requests 20000
+    load requests 100000
+done
+
+sort -k1,1 -k2,2g $SAMPLES | awk '
+function flush(   i, mean, sd, med) {
+    if (n == 0) return
+    med = (n % 2) ? v[(n+1)/2] : (v[n/2]+v[n/2+1])/2
+    mean = sum/n
+    sd = 0
+    for (i = 1; i <= n; i++) sd += (v[i]-mean)^2
+    sd = (n > 1) ? sqrt(sd/(n-1)) : 0
+    printf "%s %.2f %.2f %s\n", name, med, mean ? sd*100/mean : 0, unit
+    n = sum = 0
+}
+$1 != name { flush(); name = $1; unit = $3 }
+{ v[++n] = $2; sum += $2 }
+END { flush() }' > $RESULTS
+echo "Results written to $RESULTS" >&2
+
+if [ $SAVE = 1 ]; then
+    cp $RESULTS $BASELINE
+    echo "Stored as the new baseline in $BASELINE" >&2
+    exit 0
+fi
+if [ ! -f $BASELINE ]; then
+    echo "No baseline in $BASELINE, store one with -s" >&2
+    exit 0
+fi
+
+awk -v min=$MINTHRESHOLD '
+NR == FNR { base[$1] = $2; noise[$1] = $3; next }
+FNR == 1 {
+    printf "%-28s %14s %14s %8s %6s\n", "scenario", "baseline", "current",
+        "change", "limit"
+}
+!($1 in base) {
+    printf "%-28s %14s %14.0f %8s %6s  new\n", $1, "-", $2, "-", "-"
+    next
+}
+{
+    change = ($2-base[$1])*100/base[$1]
+    limit = 3 * ($3 > noise[$1] ? $3 : noise[$1])
+    if (limit < min) limit = min
+    status = "ok"
+    if (change < -limit) { status = "REGRESSION"; bad = 1 }
+    else if (change > limit) status = "faster"
+    printf "%-28s %14.0f %14.0f %7.1f%% %5.1f%%  %s\n", $1, base[$1], $2,
+        change, limit, status
+}
+END { exit bad }' $BASELINE $RESULTS
@@ -31,6 +31,15 @@
 #define HAVE_EPOLL 1
 #endif
 
+/* io_uring with IORING_FEAT_EXT_ARG needs Linux >= 5.11 headers, the ae
+ * module checks the running kernel and falls back to epoll if needed. */
+#ifdef __linux__
+#include <linux/version.h>
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5,11,0)
+#define HAVE_IO_URING 1
+#endif
+#endif
+
 #if (defined(__APPLE__) && defined(MAC_OS_X_VERSION_10_6)) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined (__NetBSD__)
 #define HAVE_KQUEUE 1
 #endif
@@ -8,8 +8,18 @@ typedef struct redisAeEvents {
     aeEventLoop *loop;
     int fd;
     int reading, writing;
+    int dirty, flushing; /* write coalescing state, see redisAeFlushWrites */
+    struct redisAeEvents *prevdirty, *nextdirty;
 } redisAeEvents;
 
+/* Write coalescing: when enabled, scheduling a write doesn't register the
+ * fd for writability. The context is queued instead and redisAeFlushWrites()
+ * tries to write its output buffer directly before the loop goes to sleep.
+ * Only when the socket buffer is full the write event is registered, so a
+ * request/reply cycle costs a write() and a read() but no epoll_ctl().
+ * The flag and the queue are fields of the loop, so every loop has its
+ * own. */
+
 void redisAeReadEvent(aeEventLoop *el, int fd, void *privdata, int mask) {
     ((void)el); ((void)fd); ((void)mask);
 
@@ -42,9 +52,38 @@ void redisAeDelRead(void *privdata) {
     }
 }
 
+static void redisAeUnlinkDirty(redisAeEvents *e) {
+    if (!e->dirty) return;
+    if (e->prevdirty) e->prevdirty->nextdirty = e->nextdirty;
+    else e->loop->dirty = e->nextdirty;
+    if (e->nextdirty) e->nextdirty->prevdirty = e->prevdirty;
+    e->prevdirty = e->nextdirty = NULL;
+    e->dirty = 0;
+}
+
 void redisAeAddWrite(void *privdata) {
     redisAeEvents *e = (redisAeEvents*)privdata;
     aeEventLoop *loop = e->loop;
+    redisContext *c = &(e->context->c);
+
+    /* Defer to the flush when coalescing, unless we are called by the
+     * flush itself because the socket could not take the whole buffer, or
+     * the connection is not yet established (the first writable event is
+     * what tells us the connect completed). */
+    if (loop->coalesce && !e->flushing && !e->writing &&
+        (c->flags & REDIS_CONNECTED))
+    {
+        if (!e->dirty) {
+            redisAeEvents *head = (redisAeEvents*)loop->dirty;
+
+            e->dirty = 1;
+            e->prevdirty = NULL;
+            e->nextdirty = head;
+            if (head) head->prevdirty = e;
+            loop->dirty = e;
+        }
+        return;
+    }
     if (!e->writing) {
         e->writing = 1;
         aeCreateFileEvent(loop,e->fd,AE_WRITABLE,redisAeWriteEvent,e);
@@ -62,9 +101,53 @@ void redisAeDelWrite(void *privdata) {
 
 void redisAeCleanup(void *privdata) {
     redisAeEvents *e = (redisAeEvents*)privdata;
+    redisAeUnlinkDirty(e);
     redisAeDelRead(privdata);
     redisAeDelWrite(privdata);
-    free(e);
+    /* When this happens because a flush failed, let the flush free it. */
+    if (e->flushing)
+        e->context = NULL;
+    else
+        free(e);
+}
+
+/* Write the output buffer of every context queued on "loop". This is
+ * installed as before sleep proc by redisAeEnableWriteCoalescing(),
+ * applications that need their own before sleep proc can call it there. */
+void redisAeFlushWrites(aeEventLoop *loop) {
+    redisAeEvents *e;
+
+    /* Contexts are unlinked before being flushed, as a write error will
+     * disconnect and free them, and the callbacks of the disconnection may
+     * free other queued contexts: so always take the head. */
+    while ((e = (redisAeEvents*)loop->dirty) != NULL) {
+        redisAeUnlinkDirty(e);
+        e->flushing = 1;
+        redisAsyncHandleWrite(e->context);
+        if (e->context == NULL)
+            free(e); /* disconnected by a write error */
+        else
+            e->flushing = 0;
+    }
+}
+
+static void redisAeBeforeSleep(aeEventLoop *loop) {
+    redisAeFlushWrites(loop);
+}
+
+/* Enable write coalescing for all the contexts attached to "loop". Note that
+ * the loop before sleep proc is used for this. */
+void redisAeEnableWriteCoalescing(aeEventLoop *loop) {
+    loop->coalesce = 1;
+    aeSetBeforeSleepProc(loop,redisAeBeforeSleep);
+}
+
+/* Write what is queued and go back to registering the write events. */
+void redisAeDisableWriteCoalescing(aeEventLoop *loop) {
+    redisAeFlushWrites(loop);
+    loop->coalesce = 0;
+    if (loop->beforesleep == redisAeBeforeSleep)
+        aeSetBeforeSleepProc(loop,NULL);
 }
 
 int redisAeAttach(aeEventLoop *loop, redisAsyncContext *ac) {
@@ -81,6 +164,8 @@ int redisAeAttach(aeEventLoop *loop, redisAsyncContext *ac) {
     e->loop = loop;
     e->fd = c->fd;
     e->reading = e->writing = 0;
+    e->dirty = e->flushing = 0;
+    e->prevdirty = e->nextdirty = NULL;
 
     /* Register functions to start/stop listening for events */
     ac->evAddRead = redisAeAddRead;
@@ -92,4 +177,3 @@ int redisAeAttach(aeEventLoop *loop, redisAsyncContext *ac) {
 
     return REDIS_OK;
 }
-
@@ -29,14 +29,18 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include "fmacros.h"
 #include <string.h>
 #include <assert.h>
+#include <sys/time.h>
 #include "async.h"
 #include "sds.h"
 #include "util.h"
 
-/* Forward declaration of function in hiredis.c */
+/* Forward declaration of functions in hiredis.c */
 void __redisAppendCommand(redisContext *c, char *cmd, size_t len);
+int __redisOutputPending(redisContext *c);
+int __redisReaderPending(redisContext *c);
 
 static redisAsyncContext *redisAsyncInitialize(redisContext *c) {
     redisAsyncContext *ac = realloc(c,sizeof(redisAsyncContext));
@@ -61,8 +65,16 @@ static redisAsyncContext *redisAsyncInitialize(redisContext *c) {
     ac->onConnect = NULL;
     ac->onDisconnect = NULL;
 
-    ac->replies.head = NULL;
-    ac->replies.tail = NULL;
+    ac->replies.cb = NULL;
+    ac->replies.size = 0;
+    ac->replies.head = 0;
+    ac->replies.count = 0;
+
+    ac->timing = 0;
+    ac->written = 0;
+    ac->lastread = 0;
+    ac->curtiming = NULL;
+    ac->usecwrite = ac->usecread = ac->usecparse = ac->useccallback = 0;
     return ac;
 }
 
@@ -93,6 +105,42 @@ int redisAsyncSetReplyObjectFunctions(redisAsyncContext *ac, redisReplyObjectFun
     return redisSetReplyObjectFunctions(c,fn);
 }
 
+void redisAsyncEnableTiming(redisAsyncContext *ac) {
+    ac->timing = 1;
+}
+
+const redisTiming *redisAsyncGetTiming(const redisAsyncContext *ac) {
+    return ac->curtiming;
+}
+
+static long long __redisUsec(void) {
+    struct timeval tv;
+    gettimeofday(&tv,NULL);
+    return (((long long)tv.tv_sec)*1000000)+tv.tv_usec;
+}
+
+/* Return the callback at position "idx" from the head of the list. */
+static redisCallback *__redisCallbackAt(redisCallbackList *list, unsigned int idx) {
+    return list->cb+((list->head+idx) & (list->size-1));
+}
+
+/* Update the write timestamps of the commands after a write that ended at
+ * "now". Commands are written in order, so only the ones after the last
+ * fully written command need to be checked. */
+static void __redisTimeWrites(redisAsyncContext *ac, long long now) {
+    redisContext *c = &(ac->c);
+    redisCallback *cb;
+
+    while (ac->written < ac->replies.count) {
+        cb = __redisCallbackAt(&ac->replies,ac->written);
+        if (cb->ostart >= c->owritten) break;
+        if (cb->timing.firstwrite == 0) cb->timing.firstwrite = now;
+        if (cb->oend > c->owritten) break;
+        cb->timing.lastwrite = now;
+        ac->written++;
+    }
+}
+
 int redisAsyncSetConnectCallback(redisAsyncContext *ac, redisConnectCallback *fn) {
     if (ac->onConnect == NULL) {
         ac->onConnect = fn;
@@ -112,35 +160,36 @@ int redisAsyncSetDisconnectCallback(redisAsyncContext *ac, redisDisconnectCallba
 /* Helper functions to push/shift callbacks */
 static int __redisPushCallback(redisCallbackList *list, redisCallback *source) {
     redisCallback *cb;
-
-    /* Copy callback from stack to heap */
-    cb = calloc(1,sizeof(*cb));
-    if (!cb) redisOOM();
-    if (source != NULL) {
-        cb->fn = source->fn;
-        cb->privdata = source->privdata;
+    unsigned int size;
+
+    /* Double the ring when it is full. The callbacks that wrapped around to
+     * the start of the old ring are moved right after its end. */
+    if (list->count == list->size) {
+        size = list->size ? list->size*2 : 16;
+        cb = realloc(list->cb,sizeof(*cb)*size);
+        if (!cb) redisOOM();
+        memcpy(cb+list->size,cb,sizeof(*cb)*list->head);
+        list->cb = cb;
+        list->size = size;
     }
 
-    /* Store callback in list */
-    if (list->head == NULL)
-        list->head = cb;
-    if (list->tail != NULL)
-        list->tail->next = cb;
-    list->tail = cb;
+    /* Copy callback from stack to the ring */
+    cb = list->cb+((list->head+list->count) & (list->size-1));
+    if (source != NULL)
+        memcpy(cb,source,sizeof(*cb));
+    else
+        memset(cb,0,sizeof(*cb));
+    list->count++;
     return REDIS_OK;
 }
 
 static int __redisShiftCallback(redisCallbackList *list, redisCallback *target) {
-    redisCallback *cb = list->head;
-    if (cb != NULL) {
-        list->head = cb->next;
-        if (cb == list->tail)
-            list->tail = NULL;
-
-        /* Copy callback from heap to stack */
+    if (list->count > 0) {
+        /* Copy callback from the ring to stack */
         if (target != NULL)
-            memcpy(target,cb,sizeof(*cb));
-        free(cb);
+            memcpy(target,list->cb+list->head,sizeof(*target));
+        list->head = (list->head+1) & (list->size-1);
+        list->count--;
         return REDIS_OK;
     }
     return REDIS_ERR;
@@ -190,6 +239,7 @@ static void __redisAsyncDisconnect(redisAsyncContext *ac) {
     if (ac->onDisconnect) ac->onDisconnect(ac,status);
 
     /* Cleanup self */
+    free(ac->replies.cb);
     redisFree(c);
 }
 
@@ -198,12 +248,17 @@ void redisProcessCallbacks(redisAsyncContext *ac) {
     redisCallback cb;
     void *reply = NULL;
     int status;
+    long long start = ac->timing ? __redisUsec() : 0, now = 0;
 
     while((status = redisGetReply(c,&reply)) == REDIS_OK) {
         if (reply == NULL) {
+            if (ac->timing && start) ac->usecparse += __redisUsec()-start;
+
             /* When the connection is being disconnected and there are
              * no more replies, this is the cue to really disconnect. */
-            if (c->flags & REDIS_DISCONNECTING && sdslen(c->obuf) == 0) {
+            if (c->flags & REDIS_DISCONNECTING && !__redisOutputPending(c) &&
+                ac->replies.count == 0)
+            {
                 __redisAsyncDisconnect(ac);
                 return;
             }
@@ -215,11 +270,28 @@ void redisProcessCallbacks(redisAsyncContext *ac) {
 
         /* Shift callback and execute it */
         assert(__redisShiftCallback(&ac->replies,&cb) == REDIS_OK);
+        if (ac->timing) {
+            cb.timing.completed = now = __redisUsec();
+            if (start) ac->usecparse += now-start;
+            if (ac->written > 0) ac->written--;
+
+            /* The next reply started in the last read when there are bytes
+             * left to parse, otherwise it will start in the next one. */
+            if (ac->replies.count > 0 && __redisReaderPending(c))
+                __redisCallbackAt(&ac->replies,0)->timing.firstread = ac->lastread;
+            ac->curtiming = &cb.timing;
+        }
         if (cb.fn != NULL) {
             cb.fn(ac,reply,cb.privdata);
         } else {
             c->fn->freeObject(reply);
         }
+        /* Timing may have been enabled by the callback itself. */
+        if (ac->timing) {
+            start = __redisUsec();
+            if (now) ac->useccallback += start-now;
+        }
+        ac->curtiming = NULL;
     }
 
     /* Disconnect when there was an error reading the reply */
@@ -232,10 +304,19 @@ void redisProcessCallbacks(redisAsyncContext *ac) {
  */
 void redisAsyncHandleRead(redisAsyncContext *ac) {
     redisContext *c = &(ac->c);
+    long long start = ac->timing ? __redisUsec() : 0;
 
     if (redisBufferRead(c) == REDIS_ERR) {
         __redisAsyncDisconnect(ac);
     } else {
+        if (ac->timing) {
+            ac->lastread = __redisUsec();
+            ac->usecread += ac->lastread-start;
+            if (ac->replies.count > 0 &&
+                __redisCallbackAt(&ac->replies,0)->timing.firstread == 0)
+                __redisCallbackAt(&ac->replies,0)->timing.firstread = ac->lastread;
+        }
+
         /* Always re-schedule reads */
         if (ac->evAddRead) ac->evAddRead(ac->_adapter_data);
         redisProcessCallbacks(ac);
@@ -244,11 +325,18 @@ void redisAsyncHandleRead(redisAsyncContext *ac) {
 
 void redisAsyncHandleWrite(redisAsyncContext *ac) {
     redisContext *c = &(ac->c);
+    long long start = ac->timing ? __redisUsec() : 0, now;
     int done = 0;
 
     if (redisBufferWrite(c,&done) == REDIS_ERR) {
         __redisAsyncDisconnect(ac);
     } else {
+        if (ac->timing) {
+            now = __redisUsec();
+            ac->usecwrite += now-start;
+            __redisTimeWrites(ac,now);
+        }
+
         /* Continue writing when not done, stop writing otherwise */
         if (!done) {
             if (ac->evAddWrite) ac->evAddWrite(ac->_adapter_data);
@@ -267,22 +355,18 @@ void redisAsyncHandleWrite(redisAsyncContext *ac) {
     }
 }
 
-/* Helper function for the redisAsyncCommand* family of functions.
- *
- * Write a formatted command to the output buffer and register the provided
- * callback function with the context.
- */
-static int __redisAsyncCommand(redisAsyncContext *ac, redisCallbackFn *fn, void *privdata, char *cmd, size_t len) {
-    redisContext *c = &(ac->c);
+/* Register the callback for a command that was just appended to the output
+ * of the context, and schedule the write. */
+static int __redisAsyncCommandQueued(redisAsyncContext *ac, redisCallbackFn *fn, void *privdata, unsigned long long ostart) {
     redisCallback cb;
 
-    /* Don't accept new commands when the connection is lazily closed. */
-    if (c->flags & REDIS_DISCONNECTING) return REDIS_ERR;
-    __redisAppendCommand(c,cmd,len);
-
     /* Store callback */
     cb.fn = fn;
     cb.privdata = privdata;
+    memset(&cb.timing,0,sizeof(cb.timing));
+    if (ac->timing) cb.timing.enqueued = __redisUsec();
+    cb.ostart = ostart;
+    cb.oend = ac->c.obytes;
     __redisPushCallback(&ac->replies,&cb);
 
     /* Always schedule a write when the write buffer is non-empty */
@@ -291,6 +375,21 @@ static int __redisAsyncCommand(redisAsyncContext *ac, redisCallbackFn *fn, void
     return REDIS_OK;
 }
 
+/* Helper function for the redisAsyncCommand* family of functions.
+ *
+ * Write a formatted command to the output buffer and register the provided
+ * callback function with the context.
+ */
+static int __redisAsyncCommand(redisAsyncContext *ac, redisCallbackFn *fn, void *privdata, char *cmd, size_t len) {
+    redisContext *c = &(ac->c);
+    unsigned long long ostart = c->obytes;
+
+    /* Don't accept new commands when the connection is lazily closed. */
+    if (c->flags & REDIS_DISCONNECTING) return REDIS_ERR;
+    __redisAppendCommand(c,cmd,len);
+    return __redisAsyncCommandQueued(ac,fn,privdata,ostart);
+}
+
 int redisvAsyncCommand(redisAsyncContext *ac, redisCallbackFn *fn, void *privdata, const char *format, va_list ap) {
     char *cmd;
     int len;
@@ -319,3 +418,12 @@ int redisAsyncCommandArgv(redisAsyncContext *ac, redisCallbackFn *fn, void *priv
     free(cmd);
     return status;
 }
+
+int redisAsyncCommandArgvRef(redisAsyncContext *ac, redisCallbackFn *fn, void *privdata, int argc, const char **argv, const size_t *argvlen) {
+    redisContext *c = &(ac->c);
+    unsigned long long ostart = c->obytes;
+
+    if (c->flags & REDIS_DISCONNECTING) return REDIS_ERR;
+    redisAppendCommandArgvRef(c,argc,argv,argvlen);
+    return __redisAsyncCommandQueued(ac,fn,privdata,ostart);
+}
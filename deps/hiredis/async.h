@@ -37,17 +37,34 @@ extern "C" {
 
 struct redisAsyncContext; /* need forward declaration of redisAsyncContext */
 
+/* Timestamps of a command, in microseconds, taken when timing is enabled
+ * with redisAsyncEnableTiming(). A field is 0 when the event didn't happen,
+ * for instance because the connection was lost. */
+typedef struct redisTiming {
+    long long enqueued; /* command appended to the output */
+    long long firstwrite; /* first byte of the command written */
+    long long lastwrite; /* last byte of the command written */
+    long long firstread; /* first byte of the reply read */
+    long long completed; /* reply parsed, right before the callback */
+} redisTiming;
+
 /* Reply callback prototype and container */
 typedef void (redisCallbackFn)(struct redisAsyncContext*, void*, void*);
 typedef struct redisCallback {
-    struct redisCallback *next; /* simple singly linked list */
     redisCallbackFn *fn;
     void *privdata;
+    redisTiming timing;
+    unsigned long long ostart, oend; /* offsets of the command in the output */
 } redisCallback;
 
-/* List of callbacks for either regular replies or pub/sub */
+/* Queue of callbacks for either regular replies or pub/sub. It is a ring
+ * buffer that only grows, so pushing and shifting callbacks doesn't hit the
+ * allocator once the queue is as deep as the pipeline. */
 typedef struct redisCallbackList {
-    redisCallback *head, *tail;
+    redisCallback *cb; /* ring of "size" callbacks, size is a power of 2 */
+    unsigned int size;
+    unsigned int head; /* index of the first callback */
+    unsigned int count; /* number of callbacks in the queue */
 } redisCallbackList;
 
 /* Connection callback prototypes */
@@ -86,6 +103,18 @@ typedef struct redisAsyncContext {
 
     /* Reply callbacks */
     redisCallbackList replies;
+
+    /* Per command timing, see redisAsyncEnableTiming() */
+    int timing;
+    unsigned int written; /* callbacks at the head whose command was written */
+    long long lastread; /* time of the last read from the socket */
+    redisTiming *curtiming; /* timing of the command whose callback runs */
+
+    /* Microseconds spent handling events, kept when timing is enabled */
+    long long usecwrite; /* writing to the socket */
+    long long usecread; /* reading from the socket */
+    long long usecparse; /* parsing replies */
+    long long useccallback; /* running reply callbacks */
 } redisAsyncContext;
 
 /* Functions that proxy to hiredis */
@@ -96,6 +125,14 @@ int redisAsyncSetConnectCallback(redisAsyncContext *ac, redisConnectCallback *fn
 int redisAsyncSetDisconnectCallback(redisAsyncContext *ac, redisDisconnectCallback *fn);
 void redisAsyncDisconnect(redisAsyncContext *ac);
 
+/* Record the timestamps of every command (see redisTiming), and the time
+ * spent writing, reading, parsing and in callbacks (the usec* fields of the
+ * context). The timestamps of the command whose reply is being handled are
+ * returned by redisAsyncGetTiming(), that is only valid inside reply
+ * callbacks. */
+void redisAsyncEnableTiming(redisAsyncContext *ac);
+const redisTiming *redisAsyncGetTiming(const redisAsyncContext *ac);
+
 /* Handle read/write events */
 void redisAsyncHandleRead(redisAsyncContext *ac);
 void redisAsyncHandleWrite(redisAsyncContext *ac);
@@ -106,6 +143,10 @@ int redisvAsyncCommand(redisAsyncContext *ac, redisCallbackFn *fn, void *privdat
 int redisAsyncCommand(redisAsyncContext *ac, redisCallbackFn *fn, void *privdata, const char *format, ...);
 int redisAsyncCommandArgv(redisAsyncContext *ac, redisCallbackFn *fn, void *privdata, int argc, const char **argv, const size_t *argvlen);
 
+/* Like redisAsyncCommandArgv, but large arguments are not copied: they must
+ * stay unchanged until the reply callback is called. */
+int redisAsyncCommandArgvRef(redisAsyncContext *ac, redisCallbackFn *fn, void *privdata, int argc, const char **argv, const size_t *argvlen);
+
 #ifdef __cplusplus
 }
 #endif
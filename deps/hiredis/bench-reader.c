@@ -0,0 +1,146 @@
+/* Microbenchmark for the reply parser: builds synthetic reply streams and
+ * measures how fast the reader turns them into reply objects with every
+ * available newline search routine, and with arena backed replies. No Redis
+ * server is needed.
+ *
+ * Usage: hiredis-bench-reader [runs] [csv] */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <sys/time.h>
+
+#include "hiredis.h"
+#include "scan.h"
+#include "sds.h"
+
+static long long usec(void) {
+    struct timeval tv;
+    gettimeofday(&tv,NULL);
+    return (((long long)tv.tv_sec)*1000000)+tv.tv_usec;
+}
+
+/* Build a stream of "count" replies, each one produced by "gen". */
+static sds buildStream(sds (*gen)(sds, int), int count, int *replies) {
+    sds s = sdsempty();
+    int i;
+
+    for (i = 0; i < count; i++) s = gen(s,i);
+    *replies = count;
+    return s;
+}
+
+static sds genInteger(sds s, int i) {
+    return sdscatprintf(s,":%d\r\n",i*7919);
+}
+
+static sds genStatus(sds s, int i) {
+    (void)i;
+    return sdscatlen(s,"+OK\r\n",5);
+}
+
+static sds genHash(sds s, int i) {
+    int j;
+
+    /* HGETALL of a 50 fields hash. */
+    s = sdscatlen(s,"*100\r\n",6);
+    for (j = 0; j < 50; j++)
+        s = sdscatprintf(s,"$9\r\nfield:%03d\r\n$6\r\n%06d\r\n",j,i+j);
+    return s;
+}
+
+static sds genError(sds s, int i) {
+    (void)i;
+    return sdscat(s,"-ERR Operation against a key holding the wrong kind "
+                    "of value, please check the type of the key\r\n");
+}
+
+/* Parse the whole stream "runs" times, feeding it in pieces of 16k as a
+ * socket would, building replies with "fn". Returns the elapsed
+ * microseconds. */
+static long long parseStream(sds stream, int replies, int runs,
+                             redisReplyObjectFunctions *fn)
+{
+    void *reader = redisReplyReaderCreate();
+    void *reply;
+    long long start = usec();
+    size_t off, chunk;
+    int n, j;
+
+    if (fn) redisReplyReaderSetReplyObjectFunctions(reader,fn);
+    for (j = 0; j < runs; j++) {
+        n = 0;
+        for (off = 0; off < sdslen(stream); off += chunk) {
+            chunk = sdslen(stream)-off;
+            if (chunk > 16384) chunk = 16384;
+            redisReplyReaderFeed(reader,stream+off,chunk);
+            while (redisReplyReaderGetReply(reader,&reply) == REDIS_OK &&
+                   reply != NULL)
+            {
+                if (fn) fn->freeObject(reply); else freeReplyObject(reply);
+                n++;
+            }
+        }
+        assert(n == replies);
+    }
+    redisReplyReaderFree(reader);
+    return usec()-start;
+}
+
+/* Print MB/s and replies/s, as a line of a table or in machine readable
+ * form: stream,routine,MB/s,replies/s */
+static void report(int csv, const char *stream, const char *impl,
+                   size_t len, int replies, int runs, long long elapsed)
+{
+    double mbs = ((double)len*runs)/elapsed;
+    double rps = ((double)replies*runs*1000000)/elapsed;
+
+    if (csv)
+        printf("%s,%s,%.2f,%.0f\n", stream, impl, mbs, rps);
+    else
+        printf("\t%-8s %8.2f MB/s %10.0f replies/s\n", impl, mbs, rps);
+}
+
+int main(int argc, char **argv) {
+    static const char *impls[] = {"scalar", "memchr", "sse2", "avx2", NULL};
+    static struct {
+        const char *name;
+        sds (*gen)(sds, int);
+        int count;
+    } streams[] = {
+        {"integers", genInteger, 100000},
+        {"statuses", genStatus, 100000},
+        {"hgetall", genHash, 2000},
+        {"errors", genError, 50000},
+        {NULL, NULL, 0}
+    };
+    int runs = argc > 1 ? atoi(argv[1]) : 20;
+    int csv = argc > 2 && !strcmp(argv[2],"csv");
+    int i, j, replies;
+    long long elapsed;
+    const char *defimpl = redisScanGetImpl();
+    sds stream;
+
+    if (!csv) printf("Default search routine: %s\n", defimpl);
+    for (i = 0; streams[i].name; i++) {
+        stream = buildStream(streams[i].gen,streams[i].count,&replies);
+        if (!csv) {
+            printf("%s (%d replies, %lu bytes):\n", streams[i].name, replies,
+                (unsigned long)sdslen(stream));
+        }
+        for (j = 0; impls[j]; j++) {
+            if (!redisScanSetImpl(impls[j])) continue;
+            elapsed = parseStream(stream,replies,runs,NULL);
+            report(csv,streams[i].name,impls[j],sdslen(stream),replies,runs,
+                   elapsed);
+        }
+
+        /* Same stream with the default routine and arena replies. */
+        redisScanSetImpl(defimpl);
+        elapsed = parseStream(stream,replies,runs,&redisArenaReplyFunctions);
+        report(csv,streams[i].name,"arena",sdslen(stream),replies,runs,
+               elapsed);
+        sdsfree(stream);
+    }
+    return 0;
+}
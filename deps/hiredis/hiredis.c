@@ -35,9 +35,11 @@
 #include <assert.h>
 #include <errno.h>
 #include <ctype.h>
+#include <sys/uio.h>
 
 #include "hiredis.h"
 #include "net.h"
+#include "scan.h"
 #include "sds.h"
 #include "util.h"
 
@@ -47,10 +49,13 @@ typedef struct redisReader {
     void *reply; /* holds temporary reply */
 
     sds buf; /* read buffer */
-    size_t pos; /* buffer cursor */
-    size_t len; /* buffer length */
+    size_t pos; /* read cursor: bytes before it were already parsed */
+    size_t len; /* write cursor: length of the data in the buffer */
+    size_t want; /* bytes missing to complete the current bulk, 0 if unknown */
+    size_t delivered; /* bulk bytes already passed to fn->stringChunk */
 
-    redisReadTask rstack[3]; /* stack of read tasks */
+    redisReadTask *rstack; /* stack of read tasks, one per nesting level */
+    int rsize; /* number of tasks the stack can hold */
     int ridx; /* index of stack */
     void *privdata; /* user-settable arbitrary field */
 } redisReader;
@@ -68,7 +73,8 @@ static redisReplyObjectFunctions defaultFunctions = {
     createArrayObject,
     createIntegerObject,
     createNilObject,
-    freeReplyObject
+    freeReplyObject,
+    NULL
 };
 
 /* Create a reply object */
@@ -158,70 +164,163 @@ static void *createNilObject(const redisReadTask *task) {
     return r;
 }
 
-static char *readBytes(redisReader *r, unsigned int bytes) {
-    char *p;
-    if (r->len-r->pos >= bytes) {
-        p = r->buf+r->pos;
-        r->pos += bytes;
-        return p;
+/* Arena backed replies: all the objects of a reply tree are carved from a
+ * few big blocks. The first block starts with the arena header, followed by
+ * the root object, so the whole tree can be found and released from the
+ * root pointer alone. */
+typedef struct replyArenaBlock {
+    struct replyArenaBlock *next;
+} replyArenaBlock;
+
+typedef struct replyArena {
+    replyArenaBlock *blocks; /* blocks allocated after the first one */
+    char *cur; /* first free byte in the current block */
+    char *end; /* end of the current block */
+    size_t blocksize; /* size of the last block allocated */
+} replyArena;
+
+#define ARENA_ALIGN(n) (((n)+sizeof(long long)-1) & ~(sizeof(long long)-1))
+#define ARENA_HDRLEN ARENA_ALIGN(sizeof(replyArena))
+#define ARENA_ROOT(a) ((redisReply*)((char*)(a)+ARENA_HDRLEN))
+#define ARENA_OF(r) ((replyArena*)((char*)(r)-ARENA_HDRLEN))
+#define ARENA_MIN_BLOCK 4096
+#define ARENA_MAX_BLOCK (1024*1024)
+
+static void *createArenaString(const redisReadTask *task, char *str, size_t len);
+static void *createArenaArray(const redisReadTask *task, int elements);
+static void *createArenaInteger(const redisReadTask *task, long long value);
+static void *createArenaNil(const redisReadTask *task);
+
+redisReplyObjectFunctions redisArenaReplyFunctions = {
+    createArenaString,
+    createArenaArray,
+    createArenaInteger,
+    createArenaNil,
+    freeArenaReplyObject,
+    NULL
+};
+
+static void *arenaAlloc(replyArena *a, size_t size) {
+    replyArenaBlock *b;
+    size_t blocksize;
+    void *p;
+
+    size = ARENA_ALIGN(size);
+    if ((size_t)(a->end-a->cur) < size) {
+        blocksize = a->blocksize*2;
+        if (blocksize < ARENA_MIN_BLOCK) blocksize = ARENA_MIN_BLOCK;
+        if (blocksize > ARENA_MAX_BLOCK) blocksize = ARENA_MAX_BLOCK;
+        if (blocksize < size) blocksize = size;
+        if ((b = malloc(ARENA_ALIGN(sizeof(*b))+blocksize)) == NULL)
+            redisOOM();
+        b->next = a->blocks;
+        a->blocks = b;
+        a->cur = (char*)b+ARENA_ALIGN(sizeof(*b));
+        a->end = a->cur+blocksize;
+        a->blocksize = blocksize;
     }
-    return NULL;
+    p = a->cur;
+    a->cur += size;
+    return p;
 }
 
-/* Find pointer to \r\n. */
-static char *seekNewline(char *s, size_t len) {
-    int pos = 0;
-    int _len = len-1;
-
-    /* Position should be < len-1 because the character at "pos" should be
-     * followed by a \n. Note that strchr cannot be used because it doesn't
-     * allow to search a limited length and the buffer that is being searched
-     * might not have a trailing NULL character. */
-    while (pos < _len) {
-        while(pos < _len && s[pos] != '\r') pos++;
-        if (s[pos] != '\r') {
-            /* Not found. */
-            return NULL;
-        } else {
-            if (s[pos+1] == '\n') {
-                /* Found. */
-                return s+pos;
-            } else {
-                /* Continue searching. */
-                pos++;
-            }
-        }
+/* Create the object for a read task. The root task gets a new arena with
+ * room for "size" more bytes after the root object, the other tasks get an
+ * object from the arena of the root. The arena is stored in *arena. */
+static redisReply *createArenaObject(const redisReadTask *task, int type,
+                                     size_t size, replyArena **arena)
+{
+    const redisReadTask *root = task;
+    redisReply *r, *parent;
+    replyArena *a;
+
+    if (task->parent == NULL) {
+        if ((a = malloc(ARENA_HDRLEN+ARENA_ALIGN(sizeof(*r))+size)) == NULL)
+            redisOOM();
+        r = ARENA_ROOT(a);
+        a->blocks = NULL;
+        a->cur = (char*)r+ARENA_ALIGN(sizeof(*r));
+        a->end = a->cur+size;
+        a->blocksize = size;
+    } else {
+        while (root->parent) root = root->parent;
+        a = ARENA_OF(root->obj);
+        r = arenaAlloc(a,sizeof(*r));
+        parent = task->parent->obj;
+        assert(parent->type == REDIS_REPLY_ARRAY);
+        parent->element[task->idx] = r;
     }
-    return NULL;
+    r->type = type;
+    *arena = a;
+    return r;
 }
 
-/* Read a long long value starting at *s, under the assumption that it will be
- * terminated by \r\n. Ambiguously returns -1 for unexpected input. */
-static long long readLongLong(char *s) {
-    long long v = 0;
-    int dec, mult = 1;
-    char c;
+/* Free a reply tree created with redisArenaReplyFunctions. */
+void freeArenaReplyObject(void *reply) {
+    replyArena *a = ARENA_OF(reply);
+    replyArenaBlock *b, *next;
 
-    if (*s == '-') {
-        mult = -1;
-        s++;
-    } else if (*s == '+') {
-        mult = 1;
-        s++;
+    for (b = a->blocks; b != NULL; b = next) {
+        next = b->next;
+        free(b);
     }
+    free(a);
+}
 
-    while ((c = *(s++)) != '\r') {
-        dec = c - '0';
-        if (dec >= 0 && dec < 10) {
-            v *= 10;
-            v += dec;
-        } else {
-            /* Should not happen... */
-            return -1;
-        }
-    }
+static void *createArenaString(const redisReadTask *task, char *str, size_t len) {
+    replyArena *a;
+    redisReply *r = createArenaObject(task,task->type,ARENA_ALIGN(len+1),&a);
+
+    assert(task->type == REDIS_REPLY_ERROR ||
+           task->type == REDIS_REPLY_STATUS ||
+           task->type == REDIS_REPLY_STRING);
+
+    /* Copy string value */
+    r->str = arenaAlloc(a,len+1);
+    memcpy(r->str,str,len);
+    r->str[len] = '\0';
+    r->len = len;
+    return r;
+}
+
+static void *createArenaArray(const redisReadTask *task, int elements) {
+    replyArena *a;
+    redisReply *r;
+    size_t size = ARENA_ALIGN(sizeof(redisReply*)*elements), hint;
+
+    /* Guess the room needed by the elements of a root array, so that most
+     * replies fit in a single block. */
+    hint = (size_t)elements*(ARENA_ALIGN(sizeof(redisReply))+16);
+    if (hint > ARENA_MAX_BLOCK) hint = ARENA_MAX_BLOCK;
+    r = createArenaObject(task,REDIS_REPLY_ARRAY,size+hint,&a);
+    r->elements = elements;
+    r->element = arenaAlloc(a,size);
+    memset(r->element,0,size);
+    return r;
+}
+
+static void *createArenaInteger(const redisReadTask *task, long long value) {
+    replyArena *a;
+    redisReply *r = createArenaObject(task,REDIS_REPLY_INTEGER,0,&a);
+
+    r->integer = value;
+    return r;
+}
+
+static void *createArenaNil(const redisReadTask *task) {
+    replyArena *a;
 
-    return mult*v;
+    return createArenaObject(task,REDIS_REPLY_NIL,0,&a);
+}
+
+static char *readBytes(redisReader *r, unsigned int bytes) {
+    char *p;
+    if (r->len-r->pos >= bytes) {
+        p = r->buf+r->pos;
+        r->pos += bytes;
+        return p;
+    }
+    return NULL;
 }
 
 static char *readLine(redisReader *r, int *_len) {
@@ -229,7 +328,7 @@ static char *readLine(redisReader *r, int *_len) {
     int len;
 
     p = r->buf+r->pos;
-    s = seekNewline(p,(r->len-r->pos));
+    s = redisSeekNewline(p,(r->len-r->pos));
     if (s != NULL) {
         len = s-(r->buf+r->pos);
         r->pos += len+2; /* skip \r\n */
@@ -239,6 +338,19 @@ static char *readLine(redisReader *r, int *_len) {
     return NULL;
 }
 
+/* Parse the integer in a line returned by readLine(). Sets a protocol error
+ * and returns -1 when the line is not a valid integer. */
+static int readInteger(redisReader *r, char *p, int len, long long *value) {
+    sds repr;
+
+    if (redisString2ll(p,len,value)) return 0;
+    repr = sdscatrepr(sdsempty(),p,len);
+    redisSetReplyReaderError(r,sdscatprintf(sdsempty(),
+        "Protocol error, bad integer value %s", repr));
+    sdsfree(repr);
+    return -1;
+}
+
 static void moveToNextTask(redisReader *r) {
     redisReadTask *cur, *prv;
     while (r->ridx >= 0) {
@@ -258,6 +370,7 @@ static void moveToNextTask(redisReader *r) {
             assert(cur->idx < prv->elements);
             cur->type = -1;
             cur->elements = -1;
+            cur->bulklen = -1;
             cur->idx++;
             return;
         }
@@ -269,11 +382,14 @@ static int processLineItem(redisReader *r) {
     void *obj;
     char *p;
     int len;
+    long long v;
 
     if ((p = readLine(r,&len)) != NULL) {
+        if (cur->type == REDIS_REPLY_INTEGER && readInteger(r,p,len,&v) < 0)
+            return -1;
         if (r->fn) {
             if (cur->type == REDIS_REPLY_INTEGER) {
-                obj = r->fn->createInteger(cur,readLongLong(p));
+                obj = r->fn->createInteger(cur,v);
             } else {
                 obj = r->fn->createString(cur,p,len);
             }
@@ -292,62 +408,86 @@ static int processLineItem(redisReader *r) {
 static int processBulkItem(redisReader *r) {
     redisReadTask *cur = &(r->rstack[r->ridx]);
     void *obj = NULL;
-    char *p, *s;
-    long len;
-    unsigned long bytelen;
-    int success = 0;
+    char *p;
+    int linelen;
+    size_t avail;
+    long long len;
 
-    p = r->buf+r->pos;
-    s = seekNewline(p,r->len-r->pos);
-    if (s != NULL) {
-        p = r->buf+r->pos;
-        bytelen = s-(r->buf+r->pos)+2; /* include \r\n */
-        len = readLongLong(p);
+    /* Parse the length only once: later calls just check the byte count. */
+    if (cur->bulklen == -1) {
+        if ((p = readLine(r,&linelen)) == NULL)
+            return -1;
+        if (readInteger(r,p,linelen,&len) < 0)
+            return -1;
+        cur->bulklen = len < 0 ? -2 : len;
+    }
 
-        if (len < 0) {
-            /* The nil object can always be created. */
-            obj = r->fn ? r->fn->createNil(cur) :
-                (void*)REDIS_REPLY_NIL;
-            success = 1;
-        } else {
-            /* Only continue when the buffer contains the entire bulk item. */
-            bytelen += len+2; /* include \r\n */
-            if (r->pos+bytelen <= r->len) {
-                obj = r->fn ? r->fn->createString(cur,s+2,len) :
-                    (void*)REDIS_REPLY_STRING;
-                success = 1;
-            }
+    if (cur->bulklen == -2) {
+        /* The nil object can always be created. */
+        obj = r->fn ? r->fn->createNil(cur) :
+            (void*)REDIS_REPLY_NIL;
+    } else {
+        avail = r->len-r->pos;
+
+        /* Hand the payload to the chunk callback as it arrives, so that
+         * a large value never needs to be held in the buffer. */
+        if (r->fn && r->fn->stringChunk && cur->bulklen > 0 && avail > 0) {
+            len = (long long)avail < cur->bulklen ? (long long)avail :
+                                                    cur->bulklen;
+            r->fn->stringChunk(cur,r->buf+r->pos,len);
+            r->pos += len;
+            r->delivered += len;
+            cur->bulklen -= len;
+            avail -= len;
         }
 
-        /* Proceed when obj was created. */
-        if (success) {
-            r->pos += bytelen;
+        /* Only continue when the buffer contains the entire bulk item. */
+        if ((long long)avail < cur->bulklen+2) {
+            /* Remember how much is missing so the next read can be sized. */
+            if (!(r->fn && r->fn->stringChunk))
+                r->want = cur->bulklen+2-avail;
+            return -1;
+        }
 
-            /* Set reply if this is the root object. */
-            if (r->ridx == 0) r->reply = obj;
-            moveToNextTask(r);
-            return 0;
+        if (r->fn && r->fn->stringChunk) {
+            obj = r->fn->createString(cur,NULL,r->delivered);
+            r->delivered = 0;
+        } else {
+            obj = r->fn ? r->fn->createString(cur,r->buf+r->pos,cur->bulklen) :
+                (void*)REDIS_REPLY_STRING;
         }
+        r->pos += cur->bulklen+2; /* include \r\n */
     }
-    return -1;
+    r->want = 0;
+
+    /* Set reply if this is the root object. */
+    if (r->ridx == 0) r->reply = obj;
+    moveToNextTask(r);
+    return 0;
+}
+
+/* Double the size of the task stack. The parent pointers of the tasks are
+ * fixed up, as they point inside the stack. */
+static void redisGrowTaskStack(redisReader *r) {
+    int j;
+
+    r->rsize *= 2;
+    r->rstack = realloc(r->rstack,sizeof(redisReadTask)*r->rsize);
+    if (!r->rstack) redisOOM();
+    for (j = 1; j <= r->ridx; j++)
+        r->rstack[j].parent = &(r->rstack[j-1]);
 }
 
 static int processMultiBulkItem(redisReader *r) {
     redisReadTask *cur = &(r->rstack[r->ridx]);
     void *obj;
     char *p;
-    long elements;
-    int root = 0;
-
-    /* Set error for nested multi bulks with depth > 1 */
-    if (r->ridx == 2) {
-        redisSetReplyReaderError(r,sdscatprintf(sdsempty(),
-            "No support for nested multi bulk replies with depth > 1"));
-        return -1;
-    }
+    long long elements;
+    int len, root = 0;
 
-    if ((p = readLine(r,NULL)) != NULL) {
-        elements = readLongLong(p);
+    if ((p = readLine(r,&len)) != NULL) {
+        if (readInteger(r,p,len,&elements) < 0)
+            return -1;
         root = (r->ridx == 0);
 
         if (elements == -1) {
@@ -362,9 +502,14 @@ static int processMultiBulkItem(redisReader *r) {
             if (elements > 0) {
                 cur->elements = elements;
                 cur->obj = obj;
+                if (r->ridx+1 == r->rsize) {
+                    redisGrowTaskStack(r);
+                    cur = &(r->rstack[r->ridx]);
+                }
                 r->ridx++;
                 r->rstack[r->ridx].type = -1;
                 r->rstack[r->ridx].elements = -1;
+                r->rstack[r->ridx].bulklen = -1;
                 r->rstack[r->ridx].idx = 0;
                 r->rstack[r->ridx].obj = NULL;
                 r->rstack[r->ridx].parent = cur;
@@ -439,6 +584,9 @@ void *redisReplyReaderCreate() {
     r->error = NULL;
     r->fn = &defaultFunctions;
     r->buf = sdsempty();
+    r->rsize = REDIS_READER_STACK;
+    r->rstack = malloc(sizeof(redisReadTask)*r->rsize);
+    if (!r->rstack) redisOOM();
     r->ridx = -1;
     return r;
 }
@@ -482,6 +630,7 @@ void redisReplyReaderFree(void *reader) {
         r->fn->freeObject(r->reply);
     if (r->buf != NULL)
         sdsfree(r->buf);
+    free(r->rstack);
     free(r);
 }
 
@@ -494,11 +643,28 @@ static void redisSetReplyReaderError(redisReader *r, sds err) {
         sdsfree(r->buf);
         r->buf = sdsempty();
         r->pos = 0;
+        r->len = 0;
     }
+    r->delivered = 0;
     r->ridx = -1;
     r->error = err;
 }
 
+/* Discard the part of the buffer that was already parsed, moving the bytes
+ * that are still to be parsed at the start of the buffer. */
+static void redisReaderCompact(redisReader *r) {
+    if (r->pos == 0) return;
+    if (r->pos == r->len) {
+        /* sdsrange has a quirck on this edge case. Just truncate the
+         * string so the allocation can be reused by the next read. */
+        sdsIncrLen(r->buf,-(int)r->len);
+    } else {
+        r->buf = sdsrange(r->buf,r->pos,r->len);
+    }
+    r->pos = 0;
+    r->len = sdslen(r->buf);
+}
+
 char *redisReplyReaderGetError(void *reader) {
     redisReader *r = reader;
     return r->error;
@@ -509,23 +675,58 @@ void redisReplyReaderFeed(void *reader, char *buf, size_t len) {
 
     /* Copy the provided buffer. */
     if (buf != NULL && len >= 1) {
+        /* Reclaim the parsed prefix before the buffer has to grow. */
+        if (sdsavail(r->buf) < len) redisReaderCompact(r);
         r->buf = sdscatlen(r->buf,buf,len);
         r->len = sdslen(r->buf);
     }
 }
 
+/* Return a pointer to the free space at the end of the reader buffer, so that
+ * data can be read from the socket directly into the buffer without an
+ * intermediate copy. The space is guaranteed to be at least REDIS_READER_IOBUF
+ * bytes, or the number of bytes still missing to complete the bulk item that
+ * is being read when this is larger, so a large reply takes a few big reads
+ * instead of many small ones. The number of free bytes is stored in *avail.
+ * After writing into the buffer, call redisReplyReaderCommit(). */
+char *redisReplyReaderGetBuffer(void *reader, size_t *avail) {
+    redisReader *r = reader;
+    size_t readlen = REDIS_READER_IOBUF;
+
+    if (r->want > readlen) readlen = r->want;
+    if (sdsavail(r->buf) < readlen) {
+        /* Reclaim the parsed prefix before the buffer has to grow. */
+        redisReaderCompact(r);
+        if (sdsavail(r->buf) < readlen)
+            r->buf = sdsMakeRoomFor(r->buf,readlen);
+    }
+    *avail = sdsavail(r->buf);
+    return r->buf+r->len;
+}
+
+/* Account for "len" bytes written in the space returned by
+ * redisReplyReaderGetBuffer(). */
+void redisReplyReaderCommit(void *reader, size_t len) {
+    redisReader *r = reader;
+
+    sdsIncrLen(r->buf,len);
+    r->len = sdslen(r->buf);
+}
+
 int redisReplyReaderGetReply(void *reader, void **reply) {
     redisReader *r = reader;
     if (reply != NULL) *reply = NULL;
 
     /* When the buffer is empty, there will never be a reply. */
-    if (r->len == 0)
+    if (r->pos == r->len)
         return REDIS_OK;
+    r->want = 0;
 
     /* Set first item to process when the stack is empty. */
     if (r->ridx == -1) {
         r->rstack[0].type = -1;
         r->rstack[0].elements = -1;
+        r->rstack[0].bulklen = -1;
         r->rstack[0].idx = -1;
         r->rstack[0].obj = NULL;
         r->rstack[0].parent = NULL;
@@ -538,18 +739,13 @@ int redisReplyReaderGetReply(void *reader, void **reply) {
         if (processItem(r) < 0)
             break;
 
-    /* Discard the consumed part of the buffer. */
-    if (r->pos > 0) {
-        if (r->pos == r->len) {
-            /* sdsrange has a quirck on this edge case. */
-            sdsfree(r->buf);
-            r->buf = sdsempty();
-        } else {
-            r->buf = sdsrange(r->buf,r->pos,r->len);
-        }
-        r->pos = 0;
-        r->len = sdslen(r->buf);
-    }
+    /* Discard the consumed part of the buffer. Moving the unparsed bytes is
+     * only done when the parsed prefix is large and at least as big as what
+     * has to be moved, so a deep pipeline does not cost quadratic copying.
+     * Otherwise the prefix is reclaimed when the buffer has to grow. */
+    if (r->pos == r->len ||
+        (r->pos > REDIS_READER_MAX_PREFIX && r->pos >= r->len-r->pos))
+        redisReaderCompact(r);
 
     /* Emit a reply when there is one. */
     if (r->ridx == -1) {
@@ -816,6 +1012,8 @@ void redisFree(redisContext *c) {
         sdsfree(c->errstr);
     if (c->obuf != NULL)
         sdsfree(c->obuf);
+    if (c->oqueue != NULL)
+        free(c->oqueue);
     if (c->reader != NULL)
         redisReplyReaderFree(c->reader);
     free(c);
@@ -876,8 +1074,13 @@ static void __redisCreateReplyReader(redisContext *c) {
  * After this function is called, you may use redisContextReadReply to
  * see if there is a reply available. */
 int redisBufferRead(redisContext *c) {
-    char buf[2048];
-    int nread = read(c->fd,buf,sizeof(buf));
+    char *buf;
+    size_t avail;
+    ssize_t nread;
+
+    __redisCreateReplyReader(c);
+    buf = redisReplyReaderGetBuffer(c->reader,&avail);
+    nread = read(c->fd,buf,avail);
     if (nread == -1) {
         if (errno == EAGAIN) {
             /* Try again later */
@@ -890,12 +1093,96 @@ int redisBufferRead(redisContext *c) {
             sdsnew("Server closed the connection"));
         return REDIS_ERR;
     } else {
-        __redisCreateReplyReader(c);
-        redisReplyReaderFeed(c->reader,buf,nread);
+        redisReplyReaderCommit(c->reader,nread);
     }
     return REDIS_OK;
 }
 
+/* Return non zero when the reader holds bytes that were not parsed yet. */
+int __redisReaderPending(redisContext *c) {
+    redisReader *r = c->reader;
+    return r != NULL && r->pos < r->len;
+}
+
+/* Return non zero when there is output still to be written. */
+int __redisOutputPending(redisContext *c) {
+    return c->oqtail > c->oqhead || sdslen(c->obuf) > c->opos;
+}
+
+/* Advance the output by "len" bytes that were written to the socket. The
+ * write buffer is only moved when it is empty, or when the written part is
+ * large and at least as big as the pending one. */
+static void __redisConsumeOutput(redisContext *c, size_t len) {
+    redisOutputChunk *ch;
+    size_t n;
+
+    c->owritten += len;
+
+    while (c->oqhead < c->oqtail && len > 0) {
+        ch = c->oqueue+c->oqhead;
+        n = len < ch->len ? len : ch->len;
+        if (ch->buf == NULL)
+            c->opos += n;
+        else
+            ch->buf += n;
+        ch->len -= n;
+        len -= n;
+        if (ch->len == 0) c->oqhead++;
+    }
+    if (c->oqhead == c->oqtail) c->oqhead = c->oqtail = 0;
+
+    /* Without queued chunks the bytes were written straight from obuf. */
+    c->opos += len;
+    if (c->opos == sdslen(c->obuf)) {
+        sdsfree(c->obuf);
+        c->obuf = sdsempty();
+        c->opos = 0;
+    } else if (c->opos > 16*1024 &&
+               c->opos >= sdslen(c->obuf)-c->opos) {
+        c->obuf = sdsrange(c->obuf,c->opos,-1);
+        c->opos = 0;
+    }
+}
+
+/* Add a chunk to the output queue. Consecutive write buffer chunks are
+ * merged together. */
+static void __redisQueueOutput(redisContext *c, const char *buf, size_t len) {
+    redisOutputChunk *ch;
+
+    if (buf == NULL && c->oqtail > c->oqhead &&
+        c->oqueue[c->oqtail-1].buf == NULL)
+    {
+        c->oqueue[c->oqtail-1].len += len;
+        return;
+    }
+
+    if (c->oqtail == c->oqsize) {
+        if (c->oqhead > 0) {
+            memmove(c->oqueue,c->oqueue+c->oqhead,
+                sizeof(*ch)*(c->oqtail-c->oqhead));
+            c->oqtail -= c->oqhead;
+            c->oqhead = 0;
+        } else {
+            c->oqsize = c->oqsize ? c->oqsize*2 : 8;
+            c->oqueue = realloc(c->oqueue,sizeof(*ch)*c->oqsize);
+            if (!c->oqueue) redisOOM();
+        }
+    }
+    ch = c->oqueue+c->oqtail++;
+    ch->buf = buf;
+    ch->len = len;
+}
+
+/* Append "len" bytes owned by the caller to the output without copying
+ * them. The part of the write buffer that is still pending is queued first,
+ * as from now on the output is described by the queue. */
+static void __redisAppendRef(redisContext *c, const char *buf, size_t len) {
+    c->obytes += len;
+    if (c->oqtail == c->oqhead && sdslen(c->obuf) > c->opos)
+        __redisQueueOutput(c,NULL,sdslen(c->obuf)-c->opos);
+    __redisQueueOutput(c,buf,len);
+}
+
 /* Write the output buffer to the socket.
  *
  * Returns REDIS_OK when the buffer is empty, or (a part of) the buffer was
@@ -906,26 +1193,42 @@ int redisBufferRead(redisContext *c) {
  * c->error to hold the appropriate error string.
  */
 int redisBufferWrite(redisContext *c, int *done) {
-    int nwritten;
-    if (sdslen(c->obuf) > 0) {
-        nwritten = write(c->fd,c->obuf,sdslen(c->obuf));
-        if (nwritten == -1) {
-            if (errno == EAGAIN) {
-                /* Try again later */
+    struct iovec iov[REDIS_IOV_MAX];
+    redisOutputChunk *ch;
+    size_t off = c->opos;
+    ssize_t nwritten = 0;
+    int j, iovcnt = 0;
+
+    if (c->oqtail > c->oqhead) {
+        /* Gather the queued chunks: the write buffer ones follow each other
+         * in obuf, starting from what was not written yet. */
+        for (j = c->oqhead; j < c->oqtail && iovcnt < REDIS_IOV_MAX; j++) {
+            ch = c->oqueue+j;
+            if (ch->buf == NULL) {
+                iov[iovcnt].iov_base = c->obuf+off;
+                off += ch->len;
             } else {
-                __redisSetError(c,REDIS_ERR_IO,NULL);
-                return REDIS_ERR;
-            }
-        } else if (nwritten > 0) {
-            if (nwritten == (signed)sdslen(c->obuf)) {
-                sdsfree(c->obuf);
-                c->obuf = sdsempty();
-            } else {
-                c->obuf = sdsrange(c->obuf,nwritten,-1);
+                iov[iovcnt].iov_base = (void*)ch->buf;
             }
+            iov[iovcnt].iov_len = ch->len;
+            iovcnt++;
+        }
+        nwritten = writev(c->fd,iov,iovcnt);
+    } else if (sdslen(c->obuf) > c->opos) {
+        nwritten = write(c->fd,c->obuf+c->opos,sdslen(c->obuf)-c->opos);
+    }
+
+    if (nwritten == -1) {
+        if (errno == EAGAIN) {
+            /* Try again later */
+        } else {
+            __redisSetError(c,REDIS_ERR_IO,NULL);
+            return REDIS_ERR;
         }
+    } else if (nwritten > 0) {
+        __redisConsumeOutput(c,nwritten);
     }
-    if (done != NULL) *done = (sdslen(c->obuf) == 0);
+    if (done != NULL) *done = !__redisOutputPending(c);
     return REDIS_OK;
 }
 
@@ -980,6 +1283,8 @@ int redisGetReply(redisContext *c, void **reply) {
  */
 void __redisAppendCommand(redisContext *c, char *cmd, size_t len) {
     c->obuf = sdscatlen(c->obuf,cmd,len);
+    c->obytes += len;
+    if (c->oqtail > c->oqhead) __redisQueueOutput(c,NULL,len);
 }
 
 void redisvAppendCommand(redisContext *c, const char *format, va_list ap) {
@@ -1005,6 +1310,30 @@ void redisAppendCommandArgv(redisContext *c, int argc, const char **argv, const
     free(cmd);
 }
 
+void redisAppendCommandArgvRef(redisContext *c, int argc, const char **argv, const size_t *argvlen) {
+    sds cmd = sdscatprintf(sdsempty(),"*%d\r\n",argc);
+    size_t len;
+    int j;
+
+    /* Small arguments are copied along with the protocol, large ones are
+     * referenced between the copied parts. */
+    for (j = 0; j < argc; j++) {
+        len = argvlen ? argvlen[j] : strlen(argv[j]);
+        cmd = sdscatprintf(cmd,"$%zu\r\n",len);
+        if (len >= REDIS_REF_MIN_LEN) {
+            __redisAppendCommand(c,cmd,sdslen(cmd));
+            __redisAppendRef(c,argv[j],len);
+            sdsfree(cmd);
+            cmd = sdsempty();
+        } else {
+            cmd = sdscatlen(cmd,argv[j],len);
+        }
+        cmd = sdscatlen(cmd,"\r\n",2);
+    }
+    __redisAppendCommand(c,cmd,sdslen(cmd));
+    sdsfree(cmd);
+}
+
 /* Helper function for the redisCommand* family of functions.
  *
  * Write a formatted command to the output buffer. If the given context is
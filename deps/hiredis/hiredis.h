@@ -64,6 +64,26 @@
  * should be terminated once all replies have been read. */
 #define REDIS_DISCONNECTING 0x4
 
+/* Minimum number of bytes the reader asks for when reading from the socket.
+ * When a large bulk item is being read, the read size grows to the number of
+ * bytes still missing to complete it. */
+#define REDIS_READER_IOBUF (1024*8)
+
+/* Number of already parsed bytes the reader tolerates at the start of its
+ * buffer before moving the unparsed ones over them. */
+#define REDIS_READER_MAX_PREFIX (1024*16)
+
+/* Initial depth of the reader task stack. It grows on demand, so replies
+ * can be nested at any depth. */
+#define REDIS_READER_STACK 9
+
+/* Arguments at least this long are referenced by the output queue instead of
+ * being copied, when a command is appended with the *ArgvRef functions. */
+#define REDIS_REF_MIN_LEN (1024*8)
+
+/* Maximum number of buffers passed to a single writev() call. */
+#define REDIS_IOV_MAX 64
+
 #define REDIS_REPLY_STRING 1
 #define REDIS_REPLY_ARRAY 2
 #define REDIS_REPLY_INTEGER 3
@@ -89,6 +109,7 @@ typedef struct redisReadTask {
     int type;
     int elements; /* number of elements in multibulk container */
     int idx; /* index in parent (array) object */
+    long long bulklen; /* bulk bytes still to read, -1 unknown, -2 nil */
     void *obj; /* holds user-generated value for a read task */
     struct redisReadTask *parent; /* parent task */
     void *privdata; /* user-settable arbitrary field */
@@ -100,8 +121,21 @@ typedef struct redisReplyObjectFunctions {
     void *(*createInteger)(const redisReadTask*, long long);
     void *(*createNil)(const redisReadTask*);
     void (*freeObject)(void*);
+
+    /* Optional. When set, the payload of bulk items is passed to this
+     * function piece by piece as soon as it is received, instead of being
+     * buffered until it is complete. createString is then called with a
+     * NULL pointer and the total length once the whole item was read. */
+    void (*stringChunk)(const redisReadTask*, char*, size_t);
 } redisReplyObjectFunctions;
 
+/* Chunk of the output queue of a context: either the next "len" bytes of
+ * the write buffer (buf is NULL), or a buffer owned by the caller. */
+typedef struct redisOutputChunk {
+    const char *buf;
+    size_t len;
+} redisOutputChunk;
+
 struct redisContext; /* need forward declaration of redisContext */
 
 /* Context for a connection to Redis */
@@ -109,6 +143,11 @@ typedef struct redisContext {
     int fd;
     int flags;
     char *obuf; /* Write buffer */
+    size_t opos; /* bytes at the start of obuf that were already written */
+    redisOutputChunk *oqueue; /* output queue, used once a buffer is referenced */
+    int oqhead, oqtail, oqsize; /* oqueue[oqhead..oqtail-1] are pending */
+    unsigned long long obytes; /* total bytes appended to the output */
+    unsigned long long owritten; /* total bytes written to the socket */
     int err; /* Error flags, 0 when there is no error */
     char *errstr; /* String representation of error when applicable */
 
@@ -117,7 +156,13 @@ typedef struct redisContext {
     void *reader;
 } redisContext;
 
+/* Alternative function set that builds every reply tree in a single arena,
+ * so it takes a few allocations instead of a few per element. Replies built
+ * this way must be released with freeArenaReplyObject(). */
+extern redisReplyObjectFunctions redisArenaReplyFunctions;
+
 void freeReplyObject(void *reply);
+void freeArenaReplyObject(void *reply);
 void *redisReplyReaderCreate();
 int redisReplyReaderSetReplyObjectFunctions(void *reader, redisReplyObjectFunctions *fn);
 int redisReplyReaderSetPrivdata(void *reader, void *privdata);
@@ -125,6 +170,8 @@ void *redisReplyReaderGetObject(void *reader);
 char *redisReplyReaderGetError(void *reader);
 void redisReplyReaderFree(void *ptr);
 void redisReplyReaderFeed(void *reader, char *buf, size_t len);
+char *redisReplyReaderGetBuffer(void *reader, size_t *avail);
+void redisReplyReaderCommit(void *reader, size_t len);
 int redisReplyReaderGetReply(void *reader, void **reply);
 
 /* Functions to format a command according to the protocol. */
@@ -154,6 +201,12 @@ void redisvAppendCommand(redisContext *c, const char *format, va_list ap);
 void redisAppendCommand(redisContext *c, const char *format, ...);
 void redisAppendCommandArgv(redisContext *c, int argc, const char **argv, const size_t *argvlen);
 
+/* Like redisAppendCommandArgv, but arguments of at least REDIS_REF_MIN_LEN
+ * bytes are sent straight from the caller buffers, that must not change
+ * until the command was written (that is surely the case when its reply is
+ * received). */
+void redisAppendCommandArgvRef(redisContext *c, int argc, const char **argv, const size_t *argvlen);
+
 /* Issue a command to Redis. In a blocking context, it is identical to calling
  * redisAppendCommand, followed by redisGetReply. The function will return
  * NULL if there was an error in performing the request, otherwise it will
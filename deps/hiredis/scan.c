@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) 2010, Salvatore Sanfilippo <antirez at gmail dot com>
+ * Copyright (c) 2010, Pieter Noordhuis <pcnoordhuis at gmail dot com>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Redis nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+#include <limits.h>
+
+#include "scan.h"
+
+/* The SIMD versions need GCC style builtins and, for AVX2, the target
+ * attribute so that the rest of the library is still compiled for the
+ * baseline instruction set. */
+#if defined(__GNUC__) && defined(__SSE2__)
+#define HAVE_SCAN_SSE2
+#include <emmintrin.h>
+#endif
+#if defined(HAVE_SCAN_SSE2) && (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define HAVE_SCAN_AVX2
+#include <immintrin.h>
+#endif
+
+/* All the functions below return a pointer to the first '\r' in the "len"
+ * bytes starting at "s", or NULL. They never read past s+len. */
+static char *seekCRScalar(char *s, size_t len) {
+    char *end = s+len;
+
+    for (; s < end; s++)
+        if (*s == '\r') return s;
+    return NULL;
+}
+
+static char *seekCRMemchr(char *s, size_t len) {
+    return memchr(s,'\r',len);
+}
+
+#ifdef HAVE_SCAN_SSE2
+static char *seekCRSSE2(char *s, size_t len) {
+    const __m128i cr = _mm_set1_epi8('\r');
+    int mask;
+
+    while (len >= 16) {
+        mask = _mm_movemask_epi8(_mm_cmpeq_epi8(
+            _mm_loadu_si128((const __m128i*)s),cr));
+        if (mask) return s+__builtin_ctz(mask);
+        s += 16;
+        len -= 16;
+    }
+    return seekCRScalar(s,len);
+}
+#endif
+
+#ifdef HAVE_SCAN_AVX2
+__attribute__((target("avx2")))
+static char *seekCRAVX2(char *s, size_t len) {
+    const __m256i cr = _mm256_set1_epi8('\r');
+    unsigned int mask;
+
+    while (len >= 32) {
+        mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(
+            _mm256_loadu_si256((const __m256i*)s),cr));
+        if (mask) return s+__builtin_ctz(mask);
+        s += 32;
+        len -= 32;
+    }
+    return seekCRSSE2(s,len);
+}
+#endif
+
+static char *seekCRInit(char *s, size_t len);
+
+static struct scanImpl {
+    const char *name;
+    char *(*seekCR)(char*, size_t);
+} scanImpls[] = {
+    {"scalar", seekCRScalar},
+    {"memchr", seekCRMemchr},
+#ifdef HAVE_SCAN_SSE2
+    {"sse2", seekCRSSE2},
+#endif
+#ifdef HAVE_SCAN_AVX2
+    {"avx2", seekCRAVX2},
+#endif
+    {NULL, NULL}
+};
+
+/* Routine in use. Starts as seekCRInit, that picks the best one on the
+ * first call. */
+static char *(*seekCR)(char*, size_t) = seekCRInit;
+
+static int scanImplSupported(const char *name) {
+#ifdef HAVE_SCAN_AVX2
+    if (strcmp(name,"avx2") == 0) {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+    }
+#endif
+    (void)name;
+    return 1;
+}
+
+int redisScanSetImpl(const char *name) {
+    struct scanImpl *impl;
+
+    for (impl = scanImpls; impl->name; impl++) {
+        if (strcmp(impl->name,name) == 0 && scanImplSupported(name)) {
+            seekCR = impl->seekCR;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+const char *redisScanGetImpl(void) {
+    struct scanImpl *impl;
+
+    if (seekCR == seekCRInit) seekCRInit(NULL,0);
+    for (impl = scanImpls; impl->name; impl++)
+        if (impl->seekCR == seekCR) return impl->name;
+    return NULL;
+}
+
+static char *seekCRInit(char *s, size_t len) {
+    if (!redisScanSetImpl("avx2") && !redisScanSetImpl("sse2"))
+        redisScanSetImpl("memchr");
+    return seekCR(s,len);
+}
+
+/* Find pointer to \r\n in the "len" bytes starting at "s". The buffer does
+ * not need to be null terminated. */
+char *redisSeekNewline(char *s, size_t len) {
+    char *end = s+len, *p;
+
+    if (len < 2) return NULL;
+
+    /* The '\r' can't be the last byte since it should be followed by \n. */
+    while (s < end-1 && (p = seekCR(s,end-1-s)) != NULL) {
+        if (p[1] == '\n') return p;
+        s = p+1;
+    }
+    return NULL;
+}
+
+/* Convert the "len" bytes at "s" into a long long stored at *value. Returns
+ * 1 on success, or 0 when the string is not a base 10 integer in the range
+ * of a long long. An optional leading '+' or '-' is accepted. */
+int redisString2ll(const char *s, size_t len, long long *value) {
+    const char *end = s+len;
+    unsigned long long v = 0;
+    unsigned int d;
+    int negative = 0;
+
+    if (len == 0) return 0;
+    if (*s == '-' || *s == '+') {
+        negative = (*s == '-');
+        if (++s == end) return 0;
+    }
+
+    /* A long long has at most 19 digits: shorter strings can't overflow an
+     * unsigned long long, so the range is only checked once at the end. */
+    if (end-s > 19) return 0;
+    while (s < end) {
+        d = (unsigned char)*s++ - '0';
+        if (d > 9) return 0;
+        v = v*10+d;
+    }
+
+    if (negative) {
+        if (v > (unsigned long long)LLONG_MAX+1) return 0;
+        *value = (v == (unsigned long long)LLONG_MAX+1) ? LLONG_MIN :
+                                                          -(long long)v;
+    } else {
+        if (v > LLONG_MAX) return 0;
+        *value = v;
+    }
+    return 1;
+}
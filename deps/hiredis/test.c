@@ -6,6 +6,7 @@
 #include <assert.h>
 #include <unistd.h>
 #include <signal.h>
+#include <limits.h>
 
 #include "hiredis.h"
 
@@ -176,6 +177,25 @@ static void test_blocking_connection() {
     test_cond(reply->len == 11)
     freeReplyObject(reply);
 
+    test("Large arguments can be sent by reference: ");
+    {
+        const char *argv[3] = {"SET", "foo", NULL};
+        size_t argvlen[3] = {3, 3, 100000};
+        char *value = malloc(100000);
+
+        memset(value,'v',100000);
+        argv[2] = value;
+        redisAppendCommandArgvRef(c,3,argv,argvlen);
+        redisAppendCommand(c,"GET foo");
+        assert(redisGetReply(c,(void**)&reply) == REDIS_OK);
+        freeReplyObject(reply);
+        assert(redisGetReply(c,(void**)&reply) == REDIS_OK);
+        test_cond(reply->type == REDIS_REPLY_STRING && reply->len == 100000 &&
+                  memcmp(reply->str,value,100000) == 0);
+        freeReplyObject(reply);
+        free(value);
+    }
+
     test("Can parse nil replies: ");
     reply = redisCommand(c,"GET nokey");
     test_cond(reply->type == REDIS_REPLY_NIL)
@@ -252,11 +272,43 @@ static void test_blocking_connection() {
     __connect(&c);
 }
 
+/* Reply object functions that only count the bytes of streamed bulks. */
+static size_t chunk_bytes = 0, chunk_calls = 0;
+static void countChunk(const redisReadTask *task, char *buf, size_t len) {
+    (void)task; (void)buf;
+    chunk_bytes += len;
+    chunk_calls++;
+}
+
+static void *createCountedString(const redisReadTask *task, char *str, size_t len) {
+    (void)task;
+    return (str == NULL && len == chunk_bytes) ? (void*)REDIS_REPLY_STRING : NULL;
+}
+
+static void *createNoObject(const redisReadTask *task) {
+    (void)task;
+    return NULL;
+}
+
+static void freeNoObject(void *obj) {
+    (void)obj;
+}
+
+static redisReplyObjectFunctions chunkFunctions = {
+    createCountedString,
+    NULL,
+    NULL,
+    createNoObject,
+    freeNoObject,
+    countChunk
+};
+
 static void test_reply_reader() {
     void *reader;
     void *reply;
-    char *err;
-    int ret;
+    char *err, *buf;
+    size_t avail;
+    int ret, i;
 
     test("Error handling in reply parser: ");
     reader = redisReplyReaderCreate();
@@ -280,15 +332,39 @@ static void test_reply_reader() {
               strcasecmp(err,"Protocol error, got \"@\" as reply type byte") == 0);
     redisReplyReaderFree(reader);
 
-    test("Set error on nested multi bulks with depth > 1: ");
+    test("Parses nested multi bulks of any depth: ");
     reader = redisReplyReaderCreate();
-    redisReplyReaderFeed(reader,(char*)"*1\r\n",4);
-    redisReplyReaderFeed(reader,(char*)"*1\r\n",4);
-    redisReplyReaderFeed(reader,(char*)"*1\r\n",4);
+    for (i = 0; i < 1000; i++)
+        redisReplyReaderFeed(reader,(char*)"*2\r\n:1\r\n",8);
+    redisReplyReaderFeed(reader,(char*)"+OK\r\n",5);
+    ret = redisReplyReaderGetReply(reader,&reply);
+    assert(ret == REDIS_OK && reply != NULL);
+    {
+        redisReply *r = reply;
+        for (i = 0; i < 1000 && r->type == REDIS_REPLY_ARRAY; i++)
+            r = r->element[1];
+        test_cond(i == 1000 && r->type == REDIS_REPLY_STATUS);
+    }
+    freeReplyObject(reply);
+    redisReplyReaderFree(reader);
+
+    test("Set error on integers out of range: ");
+    reader = redisReplyReaderCreate();
+    redisReplyReaderFeed(reader,(char*)":9223372036854775808\r\n",23);
     ret = redisReplyReaderGetReply(reader,NULL);
     err = redisReplyReaderGetError(reader);
     test_cond(ret == REDIS_ERR &&
-              strncasecmp(err,"No support for",14) == 0);
+              strncasecmp(err,"Protocol error, bad integer value",33) == 0);
+    redisReplyReaderFree(reader);
+
+    test("Parses integers at the edges of the range: ");
+    reader = redisReplyReaderCreate();
+    redisReplyReaderFeed(reader,(char*)":-9223372036854775808\r\n",24);
+    ret = redisReplyReaderGetReply(reader,&reply);
+    test_cond(ret == REDIS_OK &&
+              ((redisReply*)reply)->type == REDIS_REPLY_INTEGER &&
+              ((redisReply*)reply)->integer == LLONG_MIN);
+    freeReplyObject(reply);
     redisReplyReaderFree(reader);
 
     test("Works with NULL functions for reply: ");
@@ -309,6 +385,73 @@ static void test_reply_reader() {
     ret = redisReplyReaderGetReply(reader,&reply);
     test_cond(ret == REDIS_OK && reply == (void*)REDIS_REPLY_STATUS);
     redisReplyReaderFree(reader);
+
+    test("Read buffer covers the missing part of a large bulk item: ");
+    reader = redisReplyReaderCreate();
+    redisReplyReaderFeed(reader,(char*)"$100000\r\nxx",11);
+    ret = redisReplyReaderGetReply(reader,&reply);
+    assert(ret == REDIS_OK && reply == NULL);
+    buf = redisReplyReaderGetBuffer(reader,&avail);
+    assert(avail >= 100000);
+    memset(buf,'x',99998);
+    memcpy(buf+99998,"\r\n",2);
+    redisReplyReaderCommit(reader,100000);
+    ret = redisReplyReaderGetReply(reader,&reply);
+    test_cond(ret == REDIS_OK &&
+              ((redisReply*)reply)->type == REDIS_REPLY_STRING &&
+              ((redisReply*)reply)->len == 100000);
+    freeReplyObject(reply);
+    redisReplyReaderFree(reader);
+
+    test("Replies are intact when a pipeline is fed in pieces: ");
+    reader = redisReplyReaderCreate();
+    for (i = 0; i < 10000; i++)
+        redisReplyReaderFeed(reader,(char*)":1234\r\n",7);
+    for (i = 0; i < 10000; i++) {
+        if (i % 1000 == 0) redisReplyReaderFeed(reader,(char*)"+OK\r\n",5);
+        ret = redisReplyReaderGetReply(reader,&reply);
+        if (ret != REDIS_OK || reply == NULL ||
+            ((redisReply*)reply)->integer != 1234) break;
+        freeReplyObject(reply);
+    }
+    test_cond(i == 10000);
+    redisReplyReaderFree(reader);
+
+    test("Builds replies in an arena: ");
+    reader = redisReplyReaderCreate();
+    redisReplyReaderSetReplyObjectFunctions(reader,&redisArenaReplyFunctions);
+    redisReplyReaderFeed(reader,(char*)"*3\r\n",4);
+    for (i = 0; i < 3; i++) {
+        redisReplyReaderFeed(reader,(char*)"*1000\r\n",7);
+        for (ret = 0; ret < 500; ret++)
+            redisReplyReaderFeed(reader,(char*)"$5\r\nhello\r\n:42\r\n",16);
+    }
+    ret = redisReplyReaderGetReply(reader,&reply);
+    test_cond(ret == REDIS_OK && reply != NULL &&
+              ((redisReply*)reply)->elements == 3 &&
+              ((redisReply*)reply)->element[2]->elements == 1000 &&
+              strcmp(((redisReply*)reply)->element[2]->element[998]->str,"hello") == 0 &&
+              ((redisReply*)reply)->element[1]->element[999]->integer == 42);
+    freeArenaReplyObject(reply);
+    redisReplyReaderFree(reader);
+
+    test("Bulk payload is streamed to the chunk callback: ");
+    reader = redisReplyReaderCreate();
+    redisReplyReaderSetReplyObjectFunctions(reader,&chunkFunctions);
+    redisReplyReaderFeed(reader,(char*)"$11\r\nhel",8);
+    ret = redisReplyReaderGetReply(reader,&reply);
+    assert(ret == REDIS_OK && reply == NULL && chunk_bytes == 3);
+    redisReplyReaderFeed(reader,(char*)"lo wor",6);
+    ret = redisReplyReaderGetReply(reader,&reply);
+    assert(ret == REDIS_OK && reply == NULL && chunk_bytes == 9);
+    redisReplyReaderFeed(reader,(char*)"ld\r",3);
+    ret = redisReplyReaderGetReply(reader,&reply);
+    assert(ret == REDIS_OK && reply == NULL && chunk_bytes == 11);
+    redisReplyReaderFeed(reader,(char*)"\n",1);
+    ret = redisReplyReaderGetReply(reader,&reply);
+    test_cond(ret == REDIS_OK && reply == (void*)REDIS_REPLY_STRING &&
+              chunk_calls == 3);
+    redisReplyReaderFree(reader);
 }
 
 static void test_throughput() {
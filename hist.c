@@ -0,0 +1,231 @@
+/* Log-linear histogram with constant memory.
+ *
+ * Copyright (c) 2009-2010, Salvatore Sanfilippo <antirez at gmail dot com>
+ * All rights reserved.
+ *
+ * This software is NOT released under a free software license.
+ * It is a commercial tool, under the terms of the license you can find in
+ * the COPYING file in the Redis-Tools distribution.
+ *
+ * The values are counted in buckets, never stored, so any number of samples
+ * takes the same memory (about 15k), and percentiles are computed walking
+ * the buckets. histPrint() renders the histogram as an ASCII bar chart, CSV
+ * or JSON, grouping the buckets in rows of a chosen resolution.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+
+#include "hist.h"
+#include "zmalloc.h"
+
+histogram *histCreate(void) {
+    histogram *h = zmalloc(sizeof(*h));
+
+    histReset(h);
+    return h;
+}
+
+void histRelease(histogram *h) {
+    zfree(h);
+}
+
+void histReset(histogram *h) {
+    memset(h->counts,0,sizeof(h->counts));
+    h->count = 0;
+    h->min = ULLONG_MAX;
+    h->max = 0;
+    h->sum = h->sumsq = 0;
+}
+
+/* The log-linear bucket of "value" when every power of two is split into
+ * 2^bits buckets. */
+static int histBucketBits(unsigned long long value, int bits) {
+    int msb = 63;
+
+    if (value < (1ULL << bits)) return (int)value;
+    while (!(value & (1ULL << msb))) msb--;
+    return ((msb-bits+1) << bits) +
+           (int)((value >> (msb-bits)) & ((1ULL << bits)-1));
+}
+
+int histBucket(unsigned long long value) {
+    return histBucketBits(value,HIST_SUB_BITS);
+}
+
+/* The smallest and the largest value counted in a bucket. */
+unsigned long long histBucketLow(int bucket) {
+    int shift;
+
+    if (bucket < HIST_SUB_BUCKETS) return bucket;
+    shift = bucket/HIST_SUB_BUCKETS-1;
+    return (unsigned long long)(HIST_SUB_BUCKETS+bucket%HIST_SUB_BUCKETS)
+           << shift;
+}
+
+unsigned long long histBucketHigh(int bucket) {
+    if (bucket < HIST_SUB_BUCKETS) return bucket;
+    return histBucketLow(bucket)+
+           ((1ULL << (bucket/HIST_SUB_BUCKETS-1))-1);
+}
+
+void histAdd(histogram *h, unsigned long long value) {
+    h->counts[histBucket(value)]++;
+    h->count++;
+    h->sum += value;
+    h->sumsq += (double)value*value;
+    if (value < h->min) h->min = value;
+    if (value > h->max) h->max = value;
+}
+
+void histMerge(histogram *dst, histogram *src) {
+    int j;
+
+    for (j = 0; j < HIST_BUCKETS; j++) dst->counts[j] += src->counts[j];
+    dst->count += src->count;
+    dst->sum += src->sum;
+    dst->sumsq += src->sumsq;
+    if (src->min < dst->min) dst->min = src->min;
+    if (src->max > dst->max) dst->max = src->max;
+}
+
+double histMean(histogram *h) {
+    return h->count ? h->sum/h->count : 0;
+}
+
+double histStddev(histogram *h) {
+    double mean = histMean(h), var;
+
+    if (h->count == 0) return 0;
+    var = h->sumsq/h->count-mean*mean;
+    return var > 0 ? sqrt(var) : 0;
+}
+
+/* The value below which "perc" percent of the samples are: the largest
+ * value of the bucket where that sample is, but never more than the
+ * largest sample. */
+unsigned long long histPercentile(histogram *h, double perc) {
+    unsigned long long rank, seen = 0, value;
+    int j;
+
+    if (h->count == 0) return 0;
+    rank = (unsigned long long)(perc*h->count/100+0.5);
+    if (rank < 1) rank = 1;
+    if (rank > h->count) rank = h->count;
+    for (j = 0; j < HIST_BUCKETS; j++) {
+        seen += h->counts[j];
+        if (seen >= rank) break;
+    }
+    value = histBucketHigh(j);
+    if (value > h->max) value = h->max;
+    if (value < h->min) value = h->min;
+    return value;
+}
+
+/* Rows of the printed histogram: the buckets are grouped so that every
+ * power of two is split into 2^rowbits rows (rowbits 0 is a power of two
+ * scale). As rowbits <= HIST_SUB_BITS no bucket spans two rows. Only the
+ * rows from the smallest to the largest sample are printed, and the empty
+ * ones between them only in the chart, where a run of them, as found
+ * before a few outliers, is shortened to its first row and "...". */
+#define HIST_BAR_LEN 50
+#define HIST_PERCENTILES 5
+static double histPercentiles[HIST_PERCENTILES] = {50,90,99,99.9,99.99};
+
+static int histRow(int bucket, int rowbits) {
+    return histBucketBits(histBucketLow(bucket),rowbits);
+}
+
+void histPrint(histogram *h, int format, int rowbits) {
+    unsigned long long rowcount, maxrow = 0, seen = 0, low;
+    int first, last, j, k, rows = 0, empty = 0;
+
+    if (rowbits < 0) rowbits = 0;
+    if (rowbits > HIST_SUB_BITS) rowbits = HIST_SUB_BITS;
+    if (h->count == 0) {
+        first = 0;
+        last = -1;
+    } else {
+        first = histBucket(h->min);
+        last = histBucket(h->max);
+        while (first > 0 && histRow(first-1,rowbits) == histRow(first,rowbits))
+            first--;
+        while (last < HIST_BUCKETS-1 &&
+               histRow(last+1,rowbits) == histRow(last,rowbits))
+            last++;
+    }
+
+    /* The largest row, to scale the bars. */
+    for (j = first; j <= last; j = k) {
+        rowcount = 0;
+        for (k = j; k <= last && histRow(k,rowbits) == histRow(j,rowbits); k++)
+            rowcount += h->counts[k];
+        if (rowcount > maxrow) maxrow = rowcount;
+    }
+
+    if (format == HIST_FORMAT_CSV) {
+        printf("from,to,count,percent,cumulative\n");
+    } else if (format == HIST_FORMAT_JSON) {
+        printf("{\"count\":%llu,\"min\":%llu,\"max\":%llu,"
+               "\"mean\":%.2f,\"stddev\":%.2f,\"percentiles\":{",
+            h->count, h->count ? h->min : 0, h->max, histMean(h),
+            histStddev(h));
+        for (j = 0; j < HIST_PERCENTILES; j++)
+            printf("%s\"%g\":%llu", j ? "," : "", histPercentiles[j],
+                histPercentile(h,histPercentiles[j]));
+        printf("},\"rows\":[");
+    }
+
+    for (j = first; j <= last; j = k) {
+        unsigned long long high;
+
+        low = histBucketLow(j);
+        rowcount = 0;
+        for (k = j; k <= last && histRow(k,rowbits) == histRow(j,rowbits); k++)
+            rowcount += h->counts[k];
+        high = histBucketHigh(k-1);
+        seen += rowcount;
+
+        if (rowcount == 0 && (format != HIST_FORMAT_TEXT || empty++)) {
+            if (empty == 2) printf("...\n");
+            continue;
+        }
+        if (rowcount) empty = 0;
+
+        if (format == HIST_FORMAT_CSV) {
+            printf("%llu,%llu,%llu,%.4f,%.4f\n", low, high, rowcount,
+                (double)rowcount*100/h->count, (double)seen*100/h->count);
+        } else if (format == HIST_FORMAT_JSON) {
+            printf("%s{\"from\":%llu,\"to\":%llu,\"count\":%llu}",
+                rows ? "," : "", low, high, rowcount);
+        } else {
+            char range[64], bar[HIST_BAR_LEN+1];
+            int barlen = (int)(rowcount*HIST_BAR_LEN/maxrow);
+
+            if (low == high)
+                snprintf(range,sizeof(range),"%llu",low);
+            else
+                snprintf(range,sizeof(range),"%llu-%llu",low,high);
+            memset(bar,'-',barlen);
+            bar[barlen] = '\0';
+            printf("%-21s |%-*s %6.2f%% %7.2f%%\n", range, HIST_BAR_LEN,
+                bar, (double)rowcount*100/h->count,
+                (double)seen*100/h->count);
+        }
+        rows++;
+    }
+
+    if (format == HIST_FORMAT_JSON) {
+        printf("]}\n");
+    } else if (format == HIST_FORMAT_TEXT) {
+        printf("\n%llu samples, min %llu, mean %.2f, max %llu, "
+               "stddev %.2f\n", h->count, h->count ? h->min : 0,
+            histMean(h), h->max, histStddev(h));
+        for (j = 0; j < HIST_PERCENTILES; j++)
+            printf("%sp%g %llu", j ? ", " : "", histPercentiles[j],
+                histPercentile(h,histPercentiles[j]));
+        printf("\n");
+    }
+}
@@ -0,0 +1,46 @@
+/* Log-linear histogram with constant memory.
+ *
+ * Copyright (c) 2009-2010, Salvatore Sanfilippo <antirez at gmail dot com>
+ * All rights reserved.
+ *
+ * This software is NOT released under a free software license.
+ * It is a commercial tool, under the terms of the license you can find in
+ * the COPYING file in the Redis-Tools distribution.
+ */
+
+#ifndef __REDISTOOLS_HIST_H
+#define __REDISTOOLS_HIST_H
+
+/* Every power of two is split into 2^HIST_SUB_BITS linear buckets, so the
+ * value reported for a bucket is within 1/2^HIST_SUB_BITS of the values
+ * counted in it (about 3%). Values below 2^HIST_SUB_BITS are exact. */
+#define HIST_SUB_BITS 5
+#define HIST_SUB_BUCKETS (1<<HIST_SUB_BITS)
+#define HIST_BUCKETS ((64-HIST_SUB_BITS+1)*HIST_SUB_BUCKETS)
+
+/* Output formats of histPrint(). */
+#define HIST_FORMAT_TEXT 0
+#define HIST_FORMAT_CSV 1
+#define HIST_FORMAT_JSON 2
+
+typedef struct histogram {
+    unsigned long long counts[HIST_BUCKETS];
+    unsigned long long count;
+    unsigned long long min, max;
+    double sum, sumsq;
+} histogram;
+
+histogram *histCreate(void);
+void histRelease(histogram *h);
+void histReset(histogram *h);
+void histAdd(histogram *h, unsigned long long value);
+void histMerge(histogram *dst, histogram *src);
+double histMean(histogram *h);
+double histStddev(histogram *h);
+unsigned long long histPercentile(histogram *h, double perc);
+int histBucket(unsigned long long value);
+unsigned long long histBucketLow(int bucket);
+unsigned long long histBucketHigh(int bucket);
+void histPrint(histogram *h, int format, int rowbits);
+
+#endif
@@ -0,0 +1,193 @@
+/* Parser for the output of the INFO command.
+ *
+ * Copyright (c) 2009-2010, Salvatore Sanfilippo <antirez at gmail dot com>
+ * All rights reserved.
+ *
+ * This software is NOT released under a free software license.
+ * It is a commercial tool, under the terms of the license you can find in
+ * the COPYING file in the Redis-Tools distribution.
+ *
+ * The INFO text is parsed once per sample: names and values are copied into
+ * a single buffer, and a hash table indexes the fields by their exact name,
+ * so looking up "used_memory" never returns "used_memory_rss" and the cost
+ * of a lookup does not depend on the size of the INFO output. The buffers
+ * are kept across calls to infoParse(), so polling the same instance again
+ * and again does not allocate once they are big enough.
+ */
+
+#include "fmacros.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <ctype.h>
+
+#include "info.h"
+#include "zmalloc.h"
+
+#define INFO_TABLE_MIN 64
+
+info *infoCreate(void) {
+    info *i = zmalloc(sizeof(*i));
+
+    i->buf = NULL;
+    i->len = i->alloc = 0;
+    i->fields = NULL;
+    i->numfields = i->maxfields = 0;
+    i->table = NULL;
+    i->tablesize = 0;
+    return i;
+}
+
+void infoRelease(info *i) {
+    zfree(i->buf);
+    zfree(i->fields);
+    zfree(i->table);
+    zfree(i);
+}
+
+static unsigned int infoHash(const char *s) {
+    unsigned int hash = 5381;
+
+    while (*s) hash = ((hash << 5) + hash) + (unsigned char)*s++;
+    return hash;
+}
+
+/* Append "len" bytes of "s" to the buffer, or nothing when "s" is NULL. */
+static void infoAppend(info *i, const char *s, size_t len) {
+    if (i->len+len+1 > i->alloc) {
+        i->alloc = (i->len+len+1)*2;
+        i->buf = zrealloc(i->buf,i->alloc);
+    }
+    if (s) memcpy(i->buf+i->len,s,len);
+    i->len += len;
+}
+
+/* Add a field. When "sub" is not NULL the name is "name.sub". */
+static void infoAddField(info *i, const char *name, size_t namelen,
+                         const char *sub, size_t sublen,
+                         const char *value, size_t valuelen)
+{
+    infoField *f;
+
+    if (i->numfields == i->maxfields) {
+        i->maxfields = i->maxfields ? i->maxfields*2 : 128;
+        i->fields = zrealloc(i->fields,sizeof(infoField)*i->maxfields);
+    }
+    f = i->fields+i->numfields++;
+    f->name = i->len;
+    infoAppend(i,name,namelen);
+    if (sub) {
+        infoAppend(i,".",1);
+        infoAppend(i,sub,sublen);
+    }
+    infoAppend(i,"",1);
+    f->value = i->len;
+    infoAppend(i,value,valuelen);
+    infoAppend(i,"",1);
+}
+
+/* Add one field for every "k=v" pair of a "k=v,k=v" value. */
+static void infoAddPairs(info *i, const char *name, size_t namelen,
+                         const char *p, const char *end)
+{
+    while (p < end) {
+        const char *comma = memchr(p,',',end-p);
+        const char *eq;
+
+        if (comma == NULL) comma = end;
+        eq = memchr(p,'=',comma-p);
+        if (eq) infoAddField(i,name,namelen,p,eq-p,eq+1,comma-(eq+1));
+        p = comma+1;
+    }
+}
+
+static void infoBuildTable(info *i) {
+    unsigned int size = INFO_TABLE_MIN, mask, h;
+    int j;
+
+    while (size < (unsigned int)i->numfields*2) size *= 2;
+    if (size > i->tablesize) {
+        zfree(i->table);
+        i->table = zmalloc(sizeof(int)*size);
+        i->tablesize = size;
+    }
+    memset(i->table,-1,sizeof(int)*i->tablesize);
+    mask = i->tablesize-1;
+    for (j = 0; j < i->numfields; j++) {
+        infoField *f = i->fields+j;
+
+        f->hash = infoHash(infoName(i,f));
+        h = f->hash & mask;
+        while (i->table[h] != -1) h = (h+1) & mask;
+        i->table[h] = j;
+    }
+}
+
+/* Parse the INFO output "text" into "i", replacing what it held before.
+ * Empty lines and "# Section" headers are skipped. Returns the number of
+ * fields. */
+int infoParse(info *i, const char *text, size_t len) {
+    const char *p = text, *end = text+len;
+
+    i->len = 0;
+    i->numfields = 0;
+    while (p < end) {
+        const char *eol = memchr(p,'\n',end-p), *next, *colon;
+
+        if (eol == NULL) eol = end;
+        next = eol+1;
+        if (eol > p && eol[-1] == '\r') eol--;
+        if (eol > p && *p != '#' && (colon = memchr(p,':',eol-p)) != NULL) {
+            infoAddField(i,p,colon-p,NULL,0,colon+1,eol-(colon+1));
+            if (memchr(colon+1,'=',eol-(colon+1)))
+                infoAddPairs(i,p,colon-p,colon+1,eol);
+        }
+        p = next;
+    }
+    infoBuildTable(i);
+    return i->numfields;
+}
+
+/* Return the value of the field with exactly this name, or NULL. */
+const char *infoGet(info *i, const char *name) {
+    unsigned int hash = infoHash(name), mask, h;
+    int j;
+
+    if (i->tablesize == 0) return NULL;
+    mask = i->tablesize-1;
+    for (h = hash & mask; (j = i->table[h]) != -1; h = (h+1) & mask) {
+        infoField *f = i->fields+j;
+
+        if (f->hash == hash && !strcmp(infoName(i,f),name))
+            return infoValue(i,f);
+    }
+    return NULL;
+}
+
+/* Like infoGet() but converts the value into a long. LONG_MIN is returned
+ * when the field is missing. */
+long infoGetLong(info *i, const char *name) {
+    const char *value = infoGet(i,name);
+
+    return value ? strtol(value,NULL,10) : LONG_MIN;
+}
+
+/* Sum the "k" values of all the keyspace lines, "db0.keys" + "db1.keys" and
+ * so forth for "keys". */
+long infoSumKeyspace(info *i, const char *k) {
+    long sum = 0;
+    int j;
+
+    for (j = 0; j < i->numfields; j++) {
+        const char *name = infoName(i,i->fields+j);
+
+        if (strncmp(name,"db",2) || !isdigit((unsigned char)name[2]))
+            continue;
+        name += 2;
+        while (isdigit((unsigned char)*name)) name++;
+        if (*name == '.' && !strcmp(name+1,k))
+            sum += strtol(infoValue(i,i->fields+j),NULL,10);
+    }
+    return sum;
+}
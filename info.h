@@ -0,0 +1,45 @@
+/* Parser for the output of the INFO command.
+ *
+ * Copyright (c) 2009-2010, Salvatore Sanfilippo <antirez at gmail dot com>
+ * All rights reserved.
+ *
+ * This software is NOT released under a free software license.
+ * It is a commercial tool, under the terms of the license you can find in
+ * the COPYING file in the Redis-Tools distribution.
+ */
+
+#ifndef __REDISTOOLS_INFO_H
+#define __REDISTOOLS_INFO_H
+
+#include <stddef.h>
+
+typedef struct infoField {
+    size_t name;            /* offset of the field name in info->buf */
+    size_t value;           /* offset of the value in info->buf */
+    unsigned int hash;
+} infoField;
+
+/* A parsed INFO reply. Every "name:value" line is a field, and values made
+ * of "k=v,k=v" pairs (the keyspace "db0:keys=1,expires=0" lines, the
+ * slaves, the command stats) also get one field for every pair, named
+ * "name.k", so that "db0.keys" can be looked up directly. */
+typedef struct info {
+    char *buf;              /* NUL terminated names and values */
+    size_t len, alloc;
+    infoField *fields;      /* in the order of the INFO output */
+    int numfields, maxfields;
+    int *table;             /* open addressing index into fields, -1 = free */
+    unsigned int tablesize;
+} info;
+
+info *infoCreate(void);
+void infoRelease(info *i);
+int infoParse(info *i, const char *text, size_t len);
+const char *infoGet(info *i, const char *name);
+long infoGetLong(info *i, const char *name);
+long infoSumKeyspace(info *i, const char *k);
+
+#define infoName(i,f) ((i)->buf+(f)->name)
+#define infoValue(i,f) ((i)->buf+(f)->value)
+
+#endif
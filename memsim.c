@@ -0,0 +1,365 @@
+/* Simulation of the memory used by a dataset under different allocators.
+ *
+ * Copyright (c) 2009-2010, Salvatore Sanfilippo <antirez at gmail dot com>
+ * All rights reserved.
+ *
+ * This software is NOT released under a free software license.
+ * It is a commercial tool, under the terms of the license you can find in
+ * the COPYING file in the Redis-Tools distribution.
+ *
+ * Given the sampled lengths of keys and values, how much memory does a key
+ * really take? Every key is turned into the allocations Redis makes for a
+ * string key (the dict entry, the key sds, the object and the value sds, or
+ * a single embedded string for short values), and these are fed to a model
+ * of every allocator: its size classes, and slabs of pages holding the
+ * objects of a class, tracked with a bitmap. Large allocations get their
+ * own run of pages. The keys are first created, then all replaced once in a
+ * random order, so that the slabs get the holes of a long running server.
+ *
+ * Rounding to the size class is the internal fragmentation, the free slots
+ * in the slabs the external one. The allocators are simulated in parallel,
+ * one thread each, on the same sequence of keys.
+ */
+
+#include "fmacros.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "memsim.h"
+#include "zmalloc.h"
+#include "utils.h"
+
+#define SIM_CLASS_TABLE 1024
+#define SIM_ALLOCS_PER_KEY 4
+#define SIM_TOP_CLASSES 10
+#define SIM_EMBSTR_MAX 44   /* longest value embedded with its object */
+
+typedef struct simAllocator {
+    char *name;
+    size_t (*classify)(size_t size);
+    size_t pagesize;
+    size_t smallmax;        /* larger allocations get their own pages */
+} simAllocator;
+
+typedef struct simExtent {
+    struct simExtent *prev, *next; /* extents of the class with free slots */
+    unsigned int slots, used;
+    unsigned long long bitmap[1]; /* (slots+63)/64 words */
+} simExtent;
+
+typedef struct simClass {
+    size_t size;
+    size_t extentsize;
+    unsigned int slots;     /* per extent */
+    simExtent *free;
+    unsigned long long objects, requested, extents;
+    struct simClass *next;  /* in the same hash bucket */
+} simClass;
+
+typedef struct simObject {
+    simClass *cls;
+    simExtent *ext;
+    unsigned int slot;
+    size_t requested;
+} simObject;
+
+typedef struct simulation {
+    simAllocator *allocator;
+    simClass *table[SIM_CLASS_TABLE];
+    int numclasses;
+    simObject *objects;     /* SIM_ALLOCS_PER_KEY for every key */
+    size_t *keydata;        /* key and value length of every key */
+    size_t *valuelens, *keylens;
+    int numsamples, numkeys;
+    unsigned long long requested, allocated, resident, data;
+    unsigned int seed;
+    pthread_t thread;
+} simulation;
+
+/* jemalloc: multiples of 16 up to 128, then four classes every power of
+ * two. Allocations above 14k are served directly from pages. */
+static size_t jemallocClass(size_t size) {
+    size_t spacing;
+    int lg = 0;
+
+    if (size <= 8) return 8;
+    if (size <= 128) return (size+15) & ~(size_t)15;
+    while (((size_t)1 << (lg+1)) < size) lg++;
+    spacing = (size_t)1 << (lg-2);
+    return (size+spacing-1) & ~(spacing-1);
+}
+
+/* glibc malloc: an 8 bytes header, 16 bytes alignment, 32 bytes at least.
+ * Allocations from 128k are mmap()ed. */
+static size_t libcClass(size_t size) {
+    size_t chunk = (size+8+15) & ~(size_t)15;
+
+    return chunk < 32 ? 32 : chunk;
+}
+
+/* No rounding but the 8 bytes alignment: the lower bound. */
+static size_t exactClass(size_t size) {
+    return (size+7) & ~(size_t)7;
+}
+
+static simAllocator allocators[] = {
+    {"jemalloc",jemallocClass,4096,14336},
+    {"jemalloc 64k pages",jemallocClass,65536,14336},
+    {"libc",libcClass,4096,131072},
+    {"exact",exactClass,4096,14336},
+};
+#define SIM_ALLOCATORS (sizeof(allocators)/sizeof(allocators[0]))
+
+static simClass *simGetClass(simulation *sim, size_t size) {
+    simAllocator *a = sim->allocator;
+    simClass *cls;
+    size_t pages;
+
+    size = a->classify(size);
+    for (cls = sim->table[size % SIM_CLASS_TABLE]; cls; cls = cls->next)
+        if (cls->size == size) return cls;
+
+    cls = zmalloc(sizeof(*cls));
+    cls->size = size;
+    if (size > a->smallmax) {
+        cls->extentsize = (size+a->pagesize-1)/a->pagesize*a->pagesize;
+        cls->slots = 1;
+    } else {
+        /* The smallest slab of at least a page wasting less than 1/16. */
+        pages = (size+a->pagesize-1)/a->pagesize;
+        while ((pages*a->pagesize) % size > pages*a->pagesize/16 &&
+               pages < 16) pages++;
+        cls->extentsize = pages*a->pagesize;
+        cls->slots = cls->extentsize/size;
+    }
+    cls->free = NULL;
+    cls->objects = cls->requested = cls->extents = 0;
+    cls->next = sim->table[size % SIM_CLASS_TABLE];
+    sim->table[size % SIM_CLASS_TABLE] = cls;
+    sim->numclasses++;
+    return cls;
+}
+
+static void simUnlinkExtent(simClass *cls, simExtent *e) {
+    if (e->prev) e->prev->next = e->next;
+    else cls->free = e->next;
+    if (e->next) e->next->prev = e->prev;
+}
+
+static void simLinkExtent(simClass *cls, simExtent *e) {
+    e->prev = NULL;
+    e->next = cls->free;
+    if (cls->free) cls->free->prev = e;
+    cls->free = e;
+}
+
+static void simAlloc(simulation *sim, simObject *o, size_t size) {
+    simClass *cls = simGetClass(sim,size);
+    simExtent *e = cls->free;
+    unsigned int w = 0, bit = 0;
+
+    if (e == NULL) {
+        size_t words = (cls->slots+63)/64;
+
+        e = zmalloc(sizeof(*e)+sizeof(unsigned long long)*(words-1));
+        memset(e->bitmap,0,sizeof(unsigned long long)*words);
+        e->slots = cls->slots;
+        e->used = 0;
+        simLinkExtent(cls,e);
+        cls->extents++;
+        sim->resident += cls->extentsize;
+    }
+    while (e->bitmap[w] == ~0ULL) w++;
+    while (e->bitmap[w] & (1ULL << bit)) bit++;
+    e->bitmap[w] |= 1ULL << bit;
+    if (++e->used == e->slots) simUnlinkExtent(cls,e);
+
+    o->cls = cls;
+    o->ext = e;
+    o->slot = w*64+bit;
+    o->requested = size;
+    cls->objects++;
+    cls->requested += size;
+    sim->requested += size;
+    sim->allocated += cls->size;
+}
+
+static void simFree(simulation *sim, simObject *o) {
+    simClass *cls = o->cls;
+    simExtent *e = o->ext;
+
+    if (cls == NULL) return;
+    e->bitmap[o->slot/64] &= ~(1ULL << (o->slot%64));
+    if (e->used-- == e->slots) simLinkExtent(cls,e);
+    if (e->used == 0) {
+        simUnlinkExtent(cls,e);
+        zfree(e);
+        cls->extents--;
+        sim->resident -= cls->extentsize;
+    }
+    cls->objects--;
+    cls->requested -= o->requested;
+    sim->requested -= o->requested;
+    sim->allocated -= cls->size;
+    o->cls = NULL;
+}
+
+static size_t sdsAllocSize(size_t len) {
+    return len+1+(len < 256 ? 3 : (len < 65536 ? 5 : 9));
+}
+
+/* Create key "k" with the lengths of a random sample. */
+static void simCreateKey(simulation *sim, int k) {
+    simObject *o = sim->objects+k*SIM_ALLOCS_PER_KEY;
+    int s = rand_r(&sim->seed) % sim->numsamples;
+    size_t keylen = sim->keylens[s], valuelen = sim->valuelens[s];
+
+    simAlloc(sim,o,24);                         /* dictEntry */
+    simAlloc(sim,o+1,sdsAllocSize(keylen));     /* key */
+    if (valuelen <= SIM_EMBSTR_MAX) {
+        simAlloc(sim,o+2,16+sdsAllocSize(valuelen)); /* embedded string */
+    } else {
+        simAlloc(sim,o+2,16);                   /* robj */
+        simAlloc(sim,o+3,sdsAllocSize(valuelen));
+    }
+    sim->keydata[k] = keylen+valuelen;
+    sim->data += keylen+valuelen;
+}
+
+static void simDeleteKey(simulation *sim, int k) {
+    simObject *o = sim->objects+k*SIM_ALLOCS_PER_KEY;
+    int j;
+
+    sim->data -= sim->keydata[k];
+    for (j = 0; j < SIM_ALLOCS_PER_KEY; j++) simFree(sim,o+j);
+}
+
+static void *simRun(void *arg) {
+    simulation *sim = arg;
+    int j;
+
+    for (j = 0; j < sim->numkeys; j++) simCreateKey(sim,j);
+    for (j = 0; j < sim->numkeys; j++) {
+        int k = rand_r(&sim->seed) % sim->numkeys;
+
+        simDeleteKey(sim,k);
+        simCreateKey(sim,k);
+    }
+    return NULL;
+}
+
+static int simCompareWaste(const void *a, const void *b) {
+    const simClass *ca = *(simClass**)a, *cb = *(simClass**)b;
+    unsigned long long wa = ca->objects*ca->size-ca->requested;
+    unsigned long long wb = cb->objects*cb->size-cb->requested;
+
+    return wa < wb ? 1 : (wa > wb ? -1 : 0);
+}
+
+static int simCompareSize(const void *a, const void *b) {
+    const simClass *ca = *(simClass**)a, *cb = *(simClass**)b;
+
+    return ca->size < cb->size ? -1 : (ca->size > cb->size ? 1 : 0);
+}
+
+static void simReport(simulation *sim) {
+    simClass **classes = zmalloc(sizeof(simClass*)*(sim->numclasses+1));
+    char buf[3][64];
+    int j, n = 0;
+
+    for (j = 0; j < SIM_CLASS_TABLE; j++) {
+        simClass *cls;
+
+        for (cls = sim->table[j]; cls; cls = cls->next)
+            if (cls->objects) classes[n++] = cls;
+    }
+    printf("%s: %.1f bytes per key (%.1f of data), "
+           "internal fragmentation %.2f%%, external %.2f%%\n",
+        sim->allocator->name, (double)sim->resident/sim->numkeys,
+        (double)sim->data/sim->numkeys,
+        (double)(sim->allocated-sim->requested)*100/sim->allocated,
+        (double)(sim->resident-sim->allocated)*100/sim->resident);
+
+    /* The classes wasting more memory, by size. */
+    qsort(classes,n,sizeof(simClass*),simCompareWaste);
+    if (n > SIM_TOP_CLASSES) n = SIM_TOP_CLASSES;
+    qsort(classes,n,sizeof(simClass*),simCompareSize);
+    printf("  %10s %10s %10s %10s %8s\n", "class", "objects", "requested",
+        "wasted", "waste");
+    for (j = 0; j < n; j++) {
+        simClass *cls = classes[j];
+        unsigned long long allocated = cls->objects*cls->size;
+
+        bytesToHuman(buf[0],cls->size);
+        bytesToHuman(buf[1],cls->requested);
+        bytesToHuman(buf[2],allocated-cls->requested);
+        printf("  %10s %10llu %10s %10s %7.2f%%\n", buf[0], cls->objects,
+            buf[1], buf[2], (double)(allocated-cls->requested)*100/allocated);
+    }
+    printf("\n");
+    zfree(classes);
+}
+
+static void simRelease(simulation *sim) {
+    int j;
+
+    for (j = 0; j < sim->numkeys*SIM_ALLOCS_PER_KEY; j++)
+        simFree(sim,sim->objects+j);
+    for (j = 0; j < SIM_CLASS_TABLE; j++) {
+        simClass *cls = sim->table[j], *next;
+
+        for (; cls; cls = next) {
+            next = cls->next;
+            zfree(cls);
+        }
+    }
+    zfree(sim->objects);
+    zfree(sim->keydata);
+    zfree(sim);
+}
+
+/* Simulate "numkeys" keys with the lengths of the samples under every
+ * allocator and print the results. */
+void memsimRun(size_t *valuelens, size_t *keylens, int numsamples,
+               int numkeys)
+{
+    simulation *sims[SIM_ALLOCATORS];
+    size_t best = 0, j;
+
+    zmalloc_enable_thread_safeness();
+    printf("Simulating %d keys with %d allocators...\n\n", numkeys,
+        (int)SIM_ALLOCATORS);
+    for (j = 0; j < SIM_ALLOCATORS; j++) {
+        simulation *sim = zmalloc(sizeof(*sim));
+
+        memset(sim,0,sizeof(*sim));
+        sim->allocator = allocators+j;
+        sim->objects = zmalloc(sizeof(simObject)*numkeys*SIM_ALLOCS_PER_KEY);
+        memset(sim->objects,0,sizeof(simObject)*numkeys*SIM_ALLOCS_PER_KEY);
+        sim->keydata = zmalloc(sizeof(size_t)*numkeys);
+        sim->valuelens = valuelens;
+        sim->keylens = keylens;
+        sim->numsamples = numsamples;
+        sim->numkeys = numkeys;
+        sim->seed = 1; /* the same keys for everybody */
+        if (pthread_create(&sim->thread,NULL,simRun,sim) != 0) {
+            perror("pthread_create");
+            exit(1);
+        }
+        sims[j] = sim;
+    }
+    for (j = 0; j < SIM_ALLOCATORS; j++) {
+        pthread_join(sims[j]->thread,NULL);
+        simReport(sims[j]);
+        /* The exact allocator is there for reference only. */
+        if (sims[j]->allocator->classify != exactClass &&
+            sims[j]->resident < sims[best]->resident) best = j;
+    }
+    printf("Least memory with %s: %.1f bytes per key\n",
+        sims[best]->allocator->name,
+        (double)sims[best]->resident/numkeys);
+    for (j = 0; j < SIM_ALLOCATORS; j++) simRelease(sims[j]);
+}
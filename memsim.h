@@ -0,0 +1,19 @@
+/* Simulation of the memory used by a dataset under different allocators.
+ *
+ * Copyright (c) 2009-2010, Salvatore Sanfilippo <antirez at gmail dot com>
+ * All rights reserved.
+ *
+ * This software is NOT released under a free software license.
+ * It is a commercial tool, under the terms of the license you can find in
+ * the COPYING file in the Redis-Tools distribution.
+ */
+
+#ifndef __REDISTOOLS_MEMSIM_H
+#define __REDISTOOLS_MEMSIM_H
+
+#include <stddef.h>
+
+void memsimRun(size_t *valuelens, size_t *keylens, int numsamples,
+               int numkeys);
+
+#endif
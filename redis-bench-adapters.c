@@ -0,0 +1,432 @@
+/* Benchmark of the hiredis event loop adapters.
+ *
+ * Copyright (c) 2009-2010, Salvatore Sanfilippo <antirez at gmail dot com>
+ * All rights reserved.
+ *
+ * This software is NOT released under a free software license.
+ * It is a commercial tool, under the terms of the license you can find in
+ * the COPYING file in the Redis-Tools distribution.
+ *
+ * The same async PING/GET workload is run through every adapter compiled
+ * in (ae, ae with write coalescing, libevent and libev) against a stand-in
+ * server started in a child process, reporting throughput, latency
+ * percentiles and the number of I/O and polling system calls per request.
+ */
+
+#define _GNU_SOURCE /* RTLD_NEXT */
+#include "fmacros.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <signal.h>
+#include <assert.h>
+#include <dlfcn.h>
+#include <poll.h>
+#include <sys/uio.h>
+#include <sys/select.h>
+
+#include "hiredis.h"
+#include "adapters/ae.h"
+#ifdef HAVE_LIBEVENT
+#include "adapters/libevent.h"
+#endif
+#ifdef HAVE_LIBEV
+#include "adapters/libev.h"
+#endif
+#include "zmalloc.h"
+#include "utils.h"
+#include "standin.h"
+
+#define REDIS_NOTUSED(V) ((void) V)
+
+#define WORKLOAD_MIXED 0    /* PING and GET */
+#define WORKLOAD_PING 1     /* PING only */
+#define WORKLOAD_SETGET 2   /* SET of a "datasize" value, then GET */
+
+static struct config {
+    int num_clients;
+    int num_requests;
+    int pipeline;
+    int datasize;
+    char *hostip;
+    int hostport;
+    const char *only;       /* run just the loop with this name */
+    int workload;
+    int csv;                /* machine readable output */
+    char *value;            /* value of the SETs */
+    /* State of the current run */
+    int issued;
+    int completed;
+    int connected;
+    long long *latency;     /* microseconds, one per completed request */
+    redisAsyncContext **contexts;
+} config;
+
+/* ------------------------------ Syscall count ------------------------------
+ * The I/O and polling functions of libc are interposed so that the calls
+ * made by hiredis, ae and the shared libevent/libev libraries can be
+ * counted. ae talks to io_uring with syscall(), so that is counted as well.
+ * Other calls (connect, close, ...) are the same for every loop and are
+ * not counted. */
+static unsigned long long syscalls;
+
+#define REAL(name) \
+    static void *real_##name = NULL; \
+    if (real_##name == NULL) real_##name = dlsym(RTLD_NEXT,#name); \
+    syscalls++;
+
+#define CALL_REAL(name,proto) (*(proto)&real_##name)
+
+ssize_t read(int fd, void *buf, size_t count) {
+    REAL(read);
+    return CALL_REAL(read,ssize_t(**)(int,void*,size_t))(fd,buf,count);
+}
+
+ssize_t write(int fd, const void *buf, size_t count) {
+    REAL(write);
+    return CALL_REAL(write,ssize_t(**)(int,const void*,size_t))(fd,buf,count);
+}
+
+ssize_t writev(int fd, const struct iovec *iov, int iovcnt) {
+    REAL(writev);
+    return CALL_REAL(writev,ssize_t(**)(int,const struct iovec*,int))
+        (fd,iov,iovcnt);
+}
+
+int poll(struct pollfd *fds, nfds_t nfds, int timeout) {
+    REAL(poll);
+    return CALL_REAL(poll,int(**)(struct pollfd*,nfds_t,int))
+        (fds,nfds,timeout);
+}
+
+int select(int nfds, fd_set *r, fd_set *w, fd_set *e, struct timeval *tv) {
+    REAL(select);
+    return CALL_REAL(select,int(**)(int,fd_set*,fd_set*,fd_set*,struct timeval*))
+        (nfds,r,w,e,tv);
+}
+
+#ifdef __linux__
+#include <sys/epoll.h>
+
+int epoll_wait(int epfd, struct epoll_event *events, int max, int timeout) {
+    REAL(epoll_wait);
+    return CALL_REAL(epoll_wait,int(**)(int,struct epoll_event*,int,int))
+        (epfd,events,max,timeout);
+}
+
+int epoll_ctl(int epfd, int op, int fd, struct epoll_event *event) {
+    REAL(epoll_ctl);
+    return CALL_REAL(epoll_ctl,int(**)(int,int,int,struct epoll_event*))
+        (epfd,op,fd,event);
+}
+
+/* syscall() takes up to six register sized arguments, passing more than
+ * the call uses is harmless. */
+long syscall(long number, ...) {
+    long a[6];
+    va_list ap;
+    int j;
+
+    va_start(ap,number);
+    for (j = 0; j < 6; j++) a[j] = va_arg(ap,long);
+    va_end(ap);
+    REAL(syscall);
+    return CALL_REAL(syscall,long(**)(long,...))
+        (number,a[0],a[1],a[2],a[3],a[4],a[5]);
+}
+#endif
+
+/* --------------------------------- Loops ---------------------------------- */
+typedef struct benchLoop {
+    const char *name;
+    void (*create)(void);
+    int (*attach)(redisAsyncContext *ac);
+    void (*run)(void);
+    void (*stop)(void);
+    void (*release)(void);
+} benchLoop;
+
+static aeEventLoop *ael;
+
+static void aeLoopCreate(void) { ael = aeCreateEventLoop(); }
+static void aeLoopCreateCoalescing(void) {
+    ael = aeCreateEventLoop();
+    redisAeEnableWriteCoalescing(ael);
+}
+static int aeLoopAttach(redisAsyncContext *ac) { return redisAeAttach(ael,ac); }
+static void aeLoopRun(void) { aeMain(ael); }
+static void aeLoopStop(void) { aeStop(ael); }
+static void aeLoopRelease(void) { aeDeleteEventLoop(ael); }
+
+#ifdef HAVE_LIBEVENT
+static struct event_base *evbase;
+
+static void eventLoopCreate(void) { evbase = event_base_new(); }
+static int eventLoopAttach(redisAsyncContext *ac) {
+    return redisLibeventAttach(ac,evbase);
+}
+static void eventLoopRun(void) { event_base_dispatch(evbase); }
+static void eventLoopStop(void) { event_base_loopbreak(evbase); }
+static void eventLoopRelease(void) { event_base_free(evbase); }
+#endif
+
+#ifdef HAVE_LIBEV
+static struct ev_loop *evloop;
+
+static void evLoopCreate(void) { evloop = ev_loop_new(EVFLAG_AUTO); }
+static int evLoopAttach(redisAsyncContext *ac) {
+    return redisLibevAttach(evloop,ac);
+}
+static void evLoopRun(void) { ev_run(evloop,0); }
+static void evLoopStop(void) { ev_break(evloop,EVBREAK_ALL); }
+static void evLoopRelease(void) { ev_loop_destroy(evloop); }
+#endif
+
+static benchLoop loops[] = {
+    {"ae",aeLoopCreate,aeLoopAttach,aeLoopRun,aeLoopStop,aeLoopRelease},
+    {"ae-coalesce",aeLoopCreateCoalescing,aeLoopAttach,aeLoopRun,aeLoopStop,
+     aeLoopRelease},
+#ifdef HAVE_LIBEVENT
+    {"libevent",eventLoopCreate,eventLoopAttach,eventLoopRun,eventLoopStop,
+     eventLoopRelease},
+#endif
+#ifdef HAVE_LIBEV
+    {"libev",evLoopCreate,evLoopAttach,evLoopRun,evLoopStop,evLoopRelease},
+#endif
+    {NULL,NULL,NULL,NULL,NULL,NULL}
+};
+
+static benchLoop *loop; /* loop of the current run */
+
+/* -------------------------------- Workload -------------------------------- */
+static void issueRequest(redisAsyncContext *ac);
+
+static void clientDisconnected(const redisAsyncContext *ac, int status) {
+    if (status != REDIS_OK) {
+        fprintf(stderr,"Disconnected: %s\n",ac->errstr);
+        exit(1);
+    }
+    if (--config.connected == 0) loop->stop();
+}
+
+static void handleReply(redisAsyncContext *ac, void *_reply, void *privdata) {
+    redisReply *reply = _reply;
+    const redisTiming *t = redisAsyncGetTiming(ac);
+    REDIS_NOTUSED(privdata);
+
+    if (reply == NULL) {
+        if (ac->err) fprintf(stderr,"Error: %s\n",ac->errstr);
+        exit(1);
+    }
+    if (reply->type == REDIS_REPLY_ERROR) {
+        fprintf(stderr,"Error: %s\n",reply->str);
+        exit(1);
+    }
+    config.latency[config.completed++] = t->completed-t->enqueued;
+    freeReplyObject(reply);
+
+    /* The disconnection happens once the pending replies are processed. */
+    if (config.issued < config.num_requests)
+        issueRequest(ac);
+    else
+        redisAsyncDisconnect(ac);
+}
+
+/* In the mixed workload odd requests are PINGs and even ones GETs of a
+ * value of "datasize" bytes. The set/get workload writes a value of the same
+ * size and reads it back. */
+static void issueRequest(redisAsyncContext *ac) {
+    int n = config.issued++;
+
+    if (config.workload == WORKLOAD_PING ||
+        (config.workload == WORKLOAD_MIXED && (n & 1)))
+        redisAsyncCommand(ac,handleReply,NULL,"PING");
+    else if (config.workload == WORKLOAD_SETGET && !(n & 1))
+        redisAsyncCommand(ac,handleReply,NULL,"SET key:%d %b",n,
+                          config.value,(size_t)config.datasize);
+    else
+        redisAsyncCommand(ac,handleReply,NULL,"GET key:%d",n & ~1);
+}
+
+static int cmplonglong(const void *a, const void *b) {
+    long long x = *(const long long*)a, y = *(const long long*)b;
+    return (x > y) - (x < y);
+}
+
+static long long percentile(double p) {
+    return config.latency[(long)((config.completed-1)*p/100)];
+}
+
+static void runBenchmark(benchLoop *l) {
+    unsigned long long startcalls;
+    long long start, elapsed;
+    int j, k;
+
+    loop = l;
+    config.issued = config.completed = 0;
+    config.connected = config.num_clients;
+    loop->create();
+    for (j = 0; j < config.num_clients; j++) {
+        redisAsyncContext *ac = redisAsyncConnect(config.hostip,config.hostport);
+
+        if (ac->err) {
+            fprintf(stderr,"Connect: %s\n",ac->errstr);
+            exit(1);
+        }
+        redisAsyncSetDisconnectCallback(ac,clientDisconnected);
+        redisAsyncEnableTiming(ac);
+        loop->attach(ac);
+        config.contexts[j] = ac;
+    }
+
+    start = microseconds();
+    startcalls = syscalls;
+    for (j = 0; j < config.num_clients; j++) {
+        for (k = 0; k < config.pipeline; k++) {
+            if (config.issued == config.num_requests) break;
+            issueRequest(config.contexts[j]);
+        }
+    }
+    loop->run();
+    elapsed = microseconds()-start;
+    startcalls = syscalls-startcalls;
+    loop->release();
+
+    qsort(config.latency,config.completed,sizeof(long long),cmplonglong);
+    if (config.csv) {
+        printf("%s,%.0f,%lld,%lld,%lld,%lld,%lld,%.2f\n",
+            l->name,
+            (double)config.completed*1000000/(elapsed ? elapsed : 1),
+            percentile(50), percentile(90), percentile(99), percentile(99.9),
+            config.latency[config.completed-1],
+            (double)startcalls/config.completed);
+        return;
+    }
+    printf("%-12s %10.0f %7lld %7lld %7lld %7lld %7lld %8.2f\n",
+        l->name,
+        (double)config.completed*1000000/(elapsed ? elapsed : 1),
+        percentile(50), percentile(90), percentile(99), percentile(99.9),
+        config.latency[config.completed-1],
+        (double)startcalls/config.completed);
+}
+
+static void usage(char *wrong) {
+    if (wrong)
+        printf("Wrong option '%s' or option argument missing\n\n",wrong);
+    printf(
+"Usage: redis-bench-adapters ... options ...\n\n"
+" host <hostname>      Server hostname (default: built-in stand-in server)\n"
+" port <port>          Server port (default: built-in stand-in server)\n"
+" clients <clients>    Number of parallel connections (default 50)\n"
+" requests <requests>  Number of requests for every loop (default 100k)\n"
+" pipeline <n>         Requests in flight for every connection (default 1)\n"
+" datasize <size>      Size of the GET value of the stand-in (default 64)\n"
+" workload <name>      mixed (PING and GET), ping or setget (default mixed)\n"
+" loop <name>          Only benchmark this loop\n"
+" csv                  Machine readable output: one line for every loop with\n"
+"                      name,req/s,p50,p90,p99,p99.9,max,sys/req\n"
+"\n"
+"Loops compiled in:");
+    for (benchLoop *l = loops; l->name; l++) printf(" %s",l->name);
+    printf("\n");
+    exit(1);
+}
+
+static void parseOptions(int argc, char **argv) {
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        int lastarg = i==argc-1;
+
+        if (!strcmp(argv[i],"clients") && !lastarg) {
+            config.num_clients = atoi(argv[++i]);
+        } else if (!strcmp(argv[i],"requests") && !lastarg) {
+            config.num_requests = atoi(argv[++i]);
+        } else if (!strcmp(argv[i],"pipeline") && !lastarg) {
+            config.pipeline = atoi(argv[++i]);
+        } else if (!strcmp(argv[i],"datasize") && !lastarg) {
+            config.datasize = atoi(argv[++i]);
+        } else if (!strcmp(argv[i],"host") && !lastarg) {
+            config.hostip = argv[++i];
+        } else if (!strcmp(argv[i],"port") && !lastarg) {
+            config.hostport = atoi(argv[++i]);
+        } else if (!strcmp(argv[i],"loop") && !lastarg) {
+            config.only = argv[++i];
+        } else if (!strcmp(argv[i],"workload") && !lastarg) {
+            i++;
+            if (!strcmp(argv[i],"mixed")) config.workload = WORKLOAD_MIXED;
+            else if (!strcmp(argv[i],"ping")) config.workload = WORKLOAD_PING;
+            else if (!strcmp(argv[i],"setget")) config.workload = WORKLOAD_SETGET;
+            else usage(argv[i]);
+        } else if (!strcmp(argv[i],"csv")) {
+            config.csv = 1;
+        } else if (!strcmp(argv[i],"help")) {
+            usage(NULL);
+        } else {
+            usage(argv[i]);
+        }
+    }
+    /* Sanitize options */
+    if (config.num_clients < 1) config.num_clients = 1;
+    if (config.num_requests < config.num_clients)
+        config.num_requests = config.num_clients;
+    if (config.pipeline < 1) config.pipeline = 1;
+    if (config.datasize < 0) config.datasize = 0;
+}
+
+int main(int argc, char **argv) {
+    standinConfig sc;
+    pid_t standin = 0;
+    benchLoop *l;
+
+    signal(SIGHUP, SIG_IGN);
+    signal(SIGPIPE, SIG_IGN);
+
+    config.num_clients = 50;
+    config.num_requests = 100000;
+    config.pipeline = 1;
+    config.datasize = 64;
+    config.hostip = "127.0.0.1";
+    config.hostport = 0;
+    config.only = NULL;
+    config.workload = WORKLOAD_MIXED;
+    config.csv = 0;
+    parseOptions(argc,argv);
+
+    if (config.hostport == 0) {
+        standinDefaultConfig(&sc);
+        sc.valuelen = config.datasize;
+        if ((standin = standinSpawn(&sc)) == -1) {
+            perror("Starting the stand-in server");
+            exit(1);
+        }
+        config.hostport = sc.port;
+    }
+    config.latency = zmalloc(sizeof(long long)*config.num_requests);
+    config.value = zmalloc(config.datasize+1);
+    memset(config.value,'x',config.datasize);
+    config.contexts = zmalloc(sizeof(redisAsyncContext*)*config.num_clients);
+
+    if (!config.csv) {
+        printf("%d clients, %d requests, pipeline %d, %d bytes values\n\n",
+               config.num_clients, config.num_requests, config.pipeline,
+               config.datasize);
+        printf("%-12s %10s %7s %7s %7s %7s %7s %8s\n", "loop", "req/s",
+               "p50", "p90", "p99", "p99.9", "max", "sys/req");
+    }
+    for (l = loops; l->name; l++) {
+        if (config.only && strcmp(config.only,l->name)) continue;
+        runBenchmark(l);
+    }
+    if (!config.csv) {
+        printf("\nLatencies in microseconds, sys/req counts read, write, "
+               "writev, poll, select,\nepoll_wait, epoll_ctl and syscall() "
+               "calls. ae polls with %s.\n", aeGetApiName());
+    }
+
+    standinKill(standin);
+    return 0;
+}
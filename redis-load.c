@@ -20,6 +20,8 @@
 #include <signal.h>
 #include <math.h>
 #include <limits.h>
+#include <sys/time.h>
+#include <sys/resource.h>
 
 #include "hiredis.h"
 #include "adapters/ae.h"
@@ -27,6 +29,7 @@
 #include "zmalloc.h"
 #include "rc4rand.h"
 #include "utils.h"
+#include "standin.h"
 
 #define REDIS_IDLE 0
 #define REDIS_GET 1
@@ -45,6 +48,25 @@
 
 #define REDIS_NOTUSED(V) ((void) V)
 
+#define STATS_PROBE_MS 100 /* event loop lag and depth sampling period */
+#define STATS_PROBES_PER_INTERVAL 10
+#define STATS_SATURATED 90 /* percentage of CPU or busy loop */
+
+/* Cumulative counters of the client side work, in microseconds. */
+typedef struct loadStats {
+    long long wall;
+    long long requests;     /* replies received */
+    long long cpu;          /* user + system CPU time of redis-load */
+    long long busy;         /* event loop not sleeping */
+    long long issue;        /* in issueRequest(), format included */
+    long long format;       /* formatting and queueing commands */
+    long long issuecb;      /* issue time spent inside reply callbacks */
+    long long write;        /* the following ones are kept by hiredis */
+    long long read;
+    long long parse;
+    long long callback;
+} loadStats;
+
 static struct config {
     aeEventLoop *el;
     int debug;
@@ -56,7 +78,6 @@ static struct config {
 
     int datasize_min;
     int datasize_max;
-    unsigned char *databuf;
 
     int keyspace;
     int hashkeyspace;
@@ -76,10 +97,25 @@ static struct config {
     int longtail_order;
     char *hostip;
     int hostport;
+    int standin; /* run against a built-in stand-in server */
     int keepalive;
+    int coalesce;
     long long start;
     long long totlatency;
     int *latency;
+    long long timed; /* requests with a complete redisTiming */
+    long long phase[4]; /* microseconds queued, writing, waiting, reading */
+    /* Self saturation detection, see statsCron() */
+    int stats;          /* print the client side stats every second */
+    long long completed;
+    long long outstanding; /* requests waiting for their reply */
+    loadStats self;     /* own counters and the ones of freed contexts */
+    loadStats laststats, startstats;
+    long long wake;     /* when the event loop woke up */
+    long long lastprobe;
+    long long lagsum, lagmax, depthsum, depthmax;
+    int probes;
+    int intervals, saturated;
     int quiet;
     int loop;
     int idlemode;
@@ -102,6 +138,7 @@ typedef struct _client {
     int reqtype;        /* request type. REDIS_GET, REDIS_SET, ... */
     long long start;    /* start time in milliseconds */
     long keyid;          /* the key name for this request is "key:<keyid>" */
+    unsigned char *databuf; /* payload of the last write request */
 } *client;
 
 /* Prototypes */
@@ -123,6 +160,148 @@ unsigned long longtailprng(unsigned long min, unsigned long max, int n) {
     return (max-1-pl)+min;
 }
 
+/* ------------------------- Self saturation detection -------------------------
+ * When redis-load runs out of CPU the latencies it measures include the time
+ * replies wait for the generator itself. Every STATS_PROBE_MS the lag of the
+ * event loop timer and the number of outstanding requests are sampled, and
+ * every STATS_PROBES_PER_INTERVAL probes the CPU time and the time the loop
+ * was busy are compared with the wall clock, with a breakdown of where the
+ * client side time went. */
+
+/* Account the time to format and queue a command. */
+#define FORMAT(call) do { \
+    long long _start = microseconds(); \
+    call; \
+    config.self.format += microseconds()-_start; \
+} while(0)
+
+static long long tv2usec(struct timeval *tv) {
+    return ((long long)tv->tv_sec)*1000000+tv->tv_usec;
+}
+
+static void addContextStats(loadStats *s, const redisAsyncContext *ac) {
+    s->write += ac->usecwrite;
+    s->read += ac->usecread;
+    s->parse += ac->usecparse;
+    s->callback += ac->useccallback;
+}
+
+static void collectStats(loadStats *s) {
+    struct rusage ru;
+    listIter li;
+    listNode *ln;
+
+    *s = config.self;
+    s->wall = microseconds();
+    s->requests = config.completed;
+    getrusage(RUSAGE_SELF,&ru);
+    s->cpu = tv2usec(&ru.ru_utime)+tv2usec(&ru.ru_stime);
+    listRewind(config.clients,&li);
+    while ((ln = listNext(&li)) != NULL)
+        addContextStats(s,((client)listNodeValue(ln))->context);
+}
+
+static void diffStats(loadStats *d, loadStats *a, loadStats *b) {
+    d->wall = a->wall-b->wall;
+    d->requests = a->requests-b->requests;
+    d->cpu = a->cpu-b->cpu;
+    d->busy = a->busy-b->busy;
+    d->issue = a->issue-b->issue;
+    d->format = a->format-b->format;
+    d->issuecb = a->issuecb-b->issuecb;
+    d->write = a->write-b->write;
+    d->read = a->read-b->read;
+    d->parse = a->parse-b->parse;
+    d->callback = a->callback-b->callback;
+}
+
+/* Print the client side microseconds per request. Issuing the next request
+ * happens inside the reply callback, so it is not counted twice. */
+static void printOverhead(loadStats *d) {
+    double n = d->requests ? d->requests : 1;
+
+    printf("usec per request: %.1f cpu (issue %.1f, format %.1f, write %.1f, "
+           "read %.1f, parse %.1f, callbacks %.1f)",
+        d->cpu/n, (d->issue-d->format)/n, d->format/n, d->write/n,
+        d->read/n, d->parse/n, (d->callback-d->issuecb)/n);
+}
+
+/* The client is the bottleneck when it uses most of a CPU, its event loop
+ * hardly sleeps, or the timer of the probes is late by more than a probe
+ * period on average ("lag", in microseconds). */
+static int isSaturated(loadStats *d, long long lag) {
+    return d->wall && (d->cpu*100/d->wall >= STATS_SATURATED ||
+                       d->busy*100/d->wall >= STATS_SATURATED ||
+                       lag > STATS_PROBE_MS*1000);
+}
+
+static void statsInterval(void) {
+    loadStats now, d;
+    double wall;
+    long long lag = config.lagsum/config.probes;
+
+    collectStats(&now);
+    diffStats(&d,&now,&config.laststats);
+    config.laststats = now;
+    if (d.wall == 0 || config.idlemode) return;
+    wall = d.wall;
+
+    config.intervals++;
+    if (config.stats) {
+        printf("%.0f req/s, cpu %.0f%%, busy %.0f%%, lag %.1f/%.1f ms, "
+               "outstanding %.0f/%lld, ",
+            d.requests*1000000/wall, d.cpu*100/wall, d.busy*100/wall,
+            (double)lag/1000, (double)config.lagmax/1000,
+            (double)config.depthsum/config.probes, config.depthmax);
+        printOverhead(&d);
+        printf("\n");
+    }
+    if (isSaturated(&d,lag)) {
+        config.saturated++;
+        printf("WARNING: redis-load is the bottleneck (cpu %.0f%%, "
+               "busy %.0f%%, lag %.1f ms), latencies include client side "
+               "queuing. Client overhead: %.1f usec per request\n",
+            d.cpu*100/wall, d.busy*100/wall, (double)lag/1000,
+            d.requests ? (double)d.cpu/d.requests : 0);
+    }
+}
+
+static int statsCron(aeEventLoop *el, long long id, void *privdata) {
+    long long now = microseconds(), lag = 0;
+    REDIS_NOTUSED(el);
+    REDIS_NOTUSED(id);
+    REDIS_NOTUSED(privdata);
+
+    if (config.lastprobe) lag = now-config.lastprobe-STATS_PROBE_MS*1000;
+    if (lag < 0) lag = 0;
+    config.lastprobe = now;
+    config.lagsum += lag;
+    if (lag > config.lagmax) config.lagmax = lag;
+    config.depthsum += config.outstanding;
+    if (config.outstanding > config.depthmax)
+        config.depthmax = config.outstanding;
+
+    if (++config.probes == STATS_PROBES_PER_INTERVAL) {
+        statsInterval();
+        config.probes = 0;
+        config.lagsum = config.lagmax = 0;
+        config.depthsum = config.depthmax = 0;
+    }
+    return STATS_PROBE_MS;
+}
+
+/* The loop is busy from when it wakes up to when it goes to sleep again,
+ * the coalesced writes included. */
+static void beforeSleep(aeEventLoop *el) {
+    if (config.coalesce) redisAeFlushWrites(el);
+    if (config.wake) config.self.busy += microseconds()-config.wake;
+}
+
+static void afterSleep(aeEventLoop *el) {
+    REDIS_NOTUSED(el);
+    config.wake = microseconds();
+}
+
 static void clientDisconnected(const redisAsyncContext *context, int status) {
     listNode *ln;
     client c = (client)context->data;
@@ -135,6 +314,8 @@ static void clientDisconnected(const redisAsyncContext *context, int status) {
     ln = listSearchKey(config.clients,c);
     assert(ln != NULL);
     listDelNode(config.clients,ln);
+    addContextStats(&config.self,context);
+    if (c->databuf) zfree(c->databuf);
     zfree(c);
 
     /* The run was not done, create new client(s). */
@@ -151,9 +332,11 @@ static void clientDisconnected(const redisAsyncContext *context, int status) {
 static client createClient(void) {
     client c = zmalloc(sizeof(struct _client));
 
+    c->databuf = NULL;
     c->context = redisAsyncConnect(config.hostip,config.hostport);
     c->context->data = c;
     redisAsyncSetDisconnectCallback(c->context,clientDisconnected);
+    redisAsyncEnableTiming(c->context);
     if (c->context->err) {
         fprintf(stderr,"Connect: %s\n",c->context->errstr);
         exit(1);
@@ -196,6 +379,19 @@ static void checkDataIntegrity(client c, redisReply *reply) {
     }
 }
 
+/* Split the time of a request into the time the command waited in the
+ * output buffer, the time to write it, the time waiting for the first byte
+ * of the reply (network and server) and the time to read the reply. */
+static void accountTiming(const redisTiming *t) {
+    if (t == NULL || !t->firstwrite || !t->lastwrite || !t->firstread)
+        return;
+    config.phase[0] += t->firstwrite-t->enqueued;
+    config.phase[1] += t->lastwrite-t->firstwrite;
+    config.phase[2] += t->firstread-t->lastwrite;
+    config.phase[3] += t->completed-t->firstread;
+    config.timed++;
+}
+
 static void handleReply(redisAsyncContext *context, void *_reply, void *privdata) {
     REDIS_NOTUSED(privdata);
     redisReply *reply = (redisReply*)_reply;
@@ -215,6 +411,9 @@ static void handleReply(redisAsyncContext *context, void *_reply, void *privdata
 
     if (latency > MAX_LATENCY) latency = MAX_LATENCY;
     config.latency[latency]++;
+    config.completed++;
+    config.outstanding--;
+    accountTiming(redisAsyncGetTiming(context));
 
     if (config.check) checkDataIntegrity(c,reply);
     freeReplyObject(reply);
@@ -225,37 +424,64 @@ static void handleReply(redisAsyncContext *context, void *_reply, void *privdata
     }
 
     if (config.keepalive) {
+        long long issue = config.self.issue;
+
         issueRequest(c);
+        config.self.issuecb += config.self.issue-issue;
     } else {
         /* createMissingClients will be called in the disconnection callback */
         redisAsyncDisconnect(c->context);
     }
 }
 
-static unsigned long randomData(long seed) {
+static unsigned long randomData(client c, long seed) {
     unsigned long datalen;
 
+    if (c->databuf == NULL) c->databuf = zmalloc(config.datasize_max);
+
     /* We use the key number as seed of the PRNG, so we'll be able to check if
      * a given key contains the right data later, without the use of additional
      * memory. */
     if (config.check) {
         rc4rand_seed(seed);
         datalen = rc4rand_between(config.datasize_min,config.datasize_max);
-        rc4rand_set(config.databuf,datalen);
+        rc4rand_set(c->databuf,datalen);
     } else {
         datalen = randbetween(config.datasize_min,config.datasize_max);
         if (config.rand) {
             rc4rand_seed(seed);
-            rc4rand_set(config.databuf,datalen);
+            rc4rand_set(c->databuf,datalen);
         } else {
-            memset(config.databuf,'x',datalen);
+            memset(c->databuf,'x',datalen);
         }
     }
 
     return datalen;
 }
 
+/* Issue a write command whose last argument is the payload of the client.
+ * Large payloads are referenced by the output queue of the context instead
+ * of being copied. This is safe as the buffer is only rewritten by the next
+ * request of the client, that is issued after the reply to this one. */
+static void issueWriteRequest(client c, const char *cmd, const char *key,
+                              const char *field, unsigned long datalen)
+{
+    const char *argv[4];
+    size_t argvlen[4];
+    int argc = 0;
+
+    argv[argc] = cmd; argvlen[argc++] = strlen(cmd);
+    argv[argc] = key; argvlen[argc++] = strlen(key);
+    if (field) {
+        argv[argc] = field; argvlen[argc++] = strlen(field);
+    }
+    argv[argc] = (char*)c->databuf; argvlen[argc++] = datalen;
+    FORMAT(redisAsyncCommandArgvRef(c->context,handleReply,NULL,
+                                    argc,argv,argvlen));
+}
+
 static void issueRequest(client c) {
+    char keyname[64], field[32];
     int op = config.optab[random() % 100];
     long key, hashkey;
     unsigned long datalen;
@@ -278,35 +504,42 @@ static void issueRequest(client c) {
     if (op == REDIS_IDLE) {
         /* Idle */
     } else if (op == REDIS_SET) {
-        datalen = randomData(key);
-        redisAsyncCommand(c->context,handleReply,NULL,"SET string:%ld %b",key,config.databuf,datalen);
+        datalen = randomData(c,key);
+        snprintf(keyname,sizeof(keyname),"string:%ld",key);
+        issueWriteRequest(c,"SET",keyname,NULL,datalen);
     } else if (op == REDIS_GET) {
-        redisAsyncCommand(c->context,handleReply,NULL,"GET string:%ld",key);
+        FORMAT(redisAsyncCommand(c->context,handleReply,NULL,"GET string:%ld",key));
     } else if (op == REDIS_DEL) {
-        redisAsyncCommand(c->context,handleReply,NULL,"DEL string:%ld list:%ld hash:%ld",key,key,key);
+        FORMAT(redisAsyncCommand(c->context,handleReply,NULL,"DEL string:%ld list:%ld hash:%ld",key,key,key));
     } else if (op == REDIS_LPUSH) {
-        datalen = randomData(key);
-        redisAsyncCommand(c->context,handleReply,NULL,"LPUSH list:%ld %b",key,config.databuf,datalen);
+        datalen = randomData(c,key);
+        snprintf(keyname,sizeof(keyname),"list:%ld",key);
+        issueWriteRequest(c,"LPUSH",keyname,NULL,datalen);
     } else if (op == REDIS_LPOP) {
-        redisAsyncCommand(c->context,handleReply,NULL,"LPOP list:%ld",key);
+        FORMAT(redisAsyncCommand(c->context,handleReply,NULL,"LPOP list:%ld",key));
     } else if (op == REDIS_HSET) {
-        datalen = randomData(key);
-        redisAsyncCommand(c->context,handleReply,NULL,"HSET hash:%ld key:%ld %b",key,hashkey,config.databuf,datalen);
+        datalen = randomData(c,key);
+        snprintf(keyname,sizeof(keyname),"hash:%ld",key);
+        snprintf(field,sizeof(field),"key:%ld",hashkey);
+        issueWriteRequest(c,"HSET",keyname,field,datalen);
     } else if (op == REDIS_HGET) {
-        redisAsyncCommand(c->context,handleReply,NULL,"HGET hash:%ld key:%ld",key,hashkey);
+        FORMAT(redisAsyncCommand(c->context,handleReply,NULL,"HGET hash:%ld key:%ld",key,hashkey));
     } else if (op == REDIS_HGETALL) {
-        redisAsyncCommand(c->context,handleReply,NULL,"HGETALL hash:%ld",key);
+        FORMAT(redisAsyncCommand(c->context,handleReply,NULL,"HGETALL hash:%ld",key));
     } else if (op == REDIS_SWAPIN) {
         /* Only accepts a single argument, so for now only works with string keys. */
-        redisAsyncCommand(c->context,handleReply,NULL,"DEBUG SWAPIN string:%ld",key);
+        FORMAT(redisAsyncCommand(c->context,handleReply,NULL,"DEBUG SWAPIN string:%ld",key));
     } else {
         assert(NULL);
     }
+    if (op != REDIS_IDLE) config.outstanding++;
+    config.self.issue += microseconds()-c->start;
 }
 
 static void showLatencyReport(void) {
     int j, seen = 0;
     float perc, reqpersec;
+    loadStats now, d;
 
     reqpersec = (float)config.issued_requests/((float)config.totlatency/1000);
     if (!config.quiet) {
@@ -317,6 +550,27 @@ static void showLatencyReport(void) {
         printf("  %d parallel clients\n", config.num_clients);
         printf("  payload: %d..%d bytes\n", config.datasize_min, config.datasize_max);
         printf("  keep alive: %d\n", config.keepalive);
+        if (config.timed) {
+            printf("  avg usec per request: %.1f queued, %.1f writing, "
+                   "%.1f waiting reply, %.1f reading\n",
+                (double)config.phase[0]/config.timed,
+                (double)config.phase[1]/config.timed,
+                (double)config.phase[2]/config.timed,
+                (double)config.phase[3]/config.timed);
+        }
+        collectStats(&now);
+        diffStats(&d,&now,&config.startstats);
+        if (d.wall) {
+            printf("  client cpu %.0f%%, loop busy %.0f%%, ",
+                (double)d.cpu*100/d.wall, (double)d.busy*100/d.wall);
+            printOverhead(&d);
+            printf("\n");
+        }
+        if (config.saturated) {
+            printf("  WARNING: redis-load was the bottleneck for %d of %d "
+                   "seconds, the latencies\n  below include client side "
+                   "queuing\n", config.saturated, config.intervals);
+        }
         printf("\n");
         for (j = 0; j <= MAX_LATENCY; j++) {
             if (config.latency[j]) {
@@ -332,8 +586,13 @@ static void showLatencyReport(void) {
 
 static void prepareForBenchmark(void) {
     memset(config.latency,0,sizeof(int)*(MAX_LATENCY+1));
+    memset(config.phase,0,sizeof(config.phase));
+    config.timed = 0;
     config.start = microseconds();
     config.issued_requests = 0;
+    collectStats(&config.startstats);
+    config.laststats = config.startstats;
+    config.intervals = config.saturated = 0;
 }
 
 static void endBenchmark(void) {
@@ -348,12 +607,15 @@ static void usage(char *wrong) {
 "Usage: redis-load ... options ...\n\n"
 " host <hostname>      Server hostname (default 127.0.0.1)\n"
 " port <hostname>      Server port (default 6379)\n"
+" standin              Run against a built-in stand-in server, that keeps\n"
+"                      the data in memory, to measure the load generator\n"
 " clients <clients>    Number of parallel connections (default 50)\n"
 " requests <requests>  Total number of requests (default 10k)\n"
 " mindatasize <size>   Min data size of string values in bytes (default 1)\n"
 " maxdatasize <size>   Min data size of string values in bytes (default 64)\n"
 " datasize <size>      Set both min and max data size to the same value\n"
 " keepalive            1=keep alive 0=reconnect (default 1)\n"
+" coalesce             1=coalesce writes before sleeping 0=write on event (default 1)\n"
 " keyspace             The number of different keys to use (default 100k)\n"
 " rand                 Use random data payload (incompressible)\n"
 " check                Check integrity where reading data back (implies rand)\n"
@@ -372,6 +634,9 @@ static void usage(char *wrong) {
 " big                  alias for keyspace 1000000 requests 1000000\n"
 " verybig              alias for keyspace 10000000 requests 10000000\n"
 " quiet                Quiet mode, less verbose\n"
+" stats                Print client side stats every second: CPU, event loop\n"
+"                      busy time and lag, outstanding requests, and where\n"
+"                      the time of every request goes\n"
 " loop                 Loop. Run the tests forever\n"
 " idle                 Idle mode. Just open N idle connections and wait.\n"
 " debug                Debug mode. more verbose.\n"
@@ -431,12 +696,17 @@ static void parseOptions(int argc, char **argv) {
         } else if (!strcmp(argv[i],"keepalive") && !lastarg) {
             config.keepalive = atoi(argv[i+1]);
             i++;
+        } else if (!strcmp(argv[i],"coalesce") && !lastarg) {
+            config.coalesce = atoi(argv[i+1]);
+            i++;
         } else if (!strcmp(argv[i],"host") && !lastarg) {
             config.hostip = argv[i+1];
             i++;
         } else if (!strcmp(argv[i],"port") && !lastarg) {
             config.hostport = atoi(argv[i+1]);
             i++;
+        } else if (!strcmp(argv[i],"standin")) {
+            config.standin = 1;
         } else if (!strcmp(argv[i],"datasize") && !lastarg) {
             config.datasize_max = config.datasize_min = atoi(argv[i+1]);
             i++;
@@ -463,6 +733,8 @@ static void parseOptions(int argc, char **argv) {
             config.num_requests = 10000000;
         } else if (!strcmp(argv[i],"quiet")) {
             config.quiet = 1;
+        } else if (!strcmp(argv[i],"stats")) {
+            config.stats = 1;
         } else if (!strcmp(argv[i],"check")) {
             config.check = 1;
         } else if (!strcmp(argv[i],"rand")) {
@@ -540,6 +812,7 @@ int main(int argc, char **argv) {
     config.issued_requests = 0;
 
     config.keepalive = 1;
+    config.coalesce = 1;
     config.set_perc = 50;
     config.del_perc = 0;
     config.swapin_perc = 0;
@@ -556,6 +829,7 @@ int main(int argc, char **argv) {
     config.rand = 0;
     config.longtail = 0;
     config.quiet = 0;
+    config.stats = 0;
     config.loop = 0;
     config.idlemode = 0;
     config.latency = NULL;
@@ -565,9 +839,25 @@ int main(int argc, char **argv) {
 
     config.hostip = "127.0.0.1";
     config.hostport = 6379;
+    config.standin = 0;
 
     parseOptions(argc,argv);
-    config.databuf = zmalloc(config.datasize_max);
+    if (config.standin) {
+        standinConfig sc;
+
+        standinDefaultConfig(&sc);
+        sc.store = 1;
+        if (standinSpawn(&sc) == -1) {
+            perror("Starting the stand-in server");
+            exit(1);
+        }
+        config.hostip = "127.0.0.1";
+        config.hostport = sc.port;
+    }
+    if (config.coalesce) redisAeEnableWriteCoalescing(config.el);
+    aeSetBeforeSleepProc(config.el,beforeSleep);
+    aeSetAfterSleepProc(config.el,afterSleep);
+    aeCreateTimeEvent(config.el,STATS_PROBE_MS,statsCron,NULL,NULL);
 
     if (config.keepalive == 0) {
         printf("WARNING: keepalive disabled, you probably need 'echo 1 > /proc/sys/net/ipv4/tcp_tw_reuse' for Linux and 'sudo sysctl -w net.inet.tcp.msl=1000' for Mac OS X in order to use a lot of clients/requests\n");
@@ -0,0 +1,71 @@
+/* Redis stand-in server, to benchmark clients without a real Redis.
+ *
+ * Copyright (c) 2009-2010, Salvatore Sanfilippo <antirez at gmail dot com>
+ * All rights reserved.
+ *
+ * This software is NOT released under a free software license.
+ * It is a commercial tool, under the terms of the license you can find in
+ * the COPYING file in the Redis-Tools distribution.
+ */
+
+#include "fmacros.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "standin.h"
+
+static void usage(char *wrong) {
+    if (wrong)
+        printf("Wrong option '%s' or option argument missing\n\n",wrong);
+    printf(
+"Usage: redis-standin ... options ...\n\n"
+" port <port>          TCP port, bound on 127.0.0.1 (default 6379)\n"
+" store                Keep the data in memory instead of canned replies\n"
+" datasize <size>      Size of the canned values in bytes (default 64)\n"
+" delay <ms>           Delay replies by this number of milliseconds\n"
+" delayperc <perc>     Percentage of the commands delayed (default 100)\n"
+"\n"
+"Commands: PING ECHO SELECT DEBUG INFO GET SET INCR DEL EXISTS LPUSH RPUSH\n"
+"          LPOP RPOP LLEN HSET HGET HGETALL DBSIZE FLUSHALL\n"
+);
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    standinConfig cfg;
+    int i, fd;
+
+    standinDefaultConfig(&cfg);
+    cfg.port = 6379;
+    for (i = 1; i < argc; i++) {
+        int lastarg = i==argc-1;
+
+        if (!strcmp(argv[i],"port") && !lastarg) {
+            cfg.port = atoi(argv[++i]);
+        } else if (!strcmp(argv[i],"store")) {
+            cfg.store = 1;
+        } else if (!strcmp(argv[i],"datasize") && !lastarg) {
+            cfg.valuelen = strtoul(argv[++i],NULL,10);
+        } else if (!strcmp(argv[i],"delay") && !lastarg) {
+            cfg.delay = atoi(argv[++i]);
+        } else if (!strcmp(argv[i],"delayperc") && !lastarg) {
+            cfg.delayperc = atoi(argv[++i]);
+        } else if (!strcmp(argv[i],"help")) {
+            usage(NULL);
+        } else {
+            usage(argv[i]);
+        }
+    }
+
+    if ((fd = standinListen(&cfg.port)) == -1) {
+        perror("Listening");
+        exit(1);
+    }
+    printf("Stand-in server listening on 127.0.0.1:%d (%s)\n", cfg.port,
+        cfg.store ? "in-memory data" : "canned replies");
+    fflush(stdout);
+    standinServe(&cfg,fd);
+    return 0;
+}
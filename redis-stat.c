@@ -18,19 +18,41 @@
 #include <limits.h>
 #include <math.h>
 #include <sys/time.h>
+#include <time.h>
 #include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
 
 #include "zmalloc.h"
 #include "hiredis.h"
+#include "async.h"
+#include "adapters/ae.h"
 #include "utils.h"
+#include "info.h"
+#include "hist.h"
+#include "memsim.h"
+#include "tseries.h"
+#include "sds.h"
 
 #define REDIS_NOTUSED(V) ((void) V)
 
 #define STAT_VMSTAT 0
-#define STAT_VMPAGE 1
+#define STAT_MEMORY_EFFICIENCY 1
 #define STAT_OVERVIEW 2
 #define STAT_ONDISK_SIZE 3
 #define STAT_LATENCY 4
+#define STAT_MEMORY_SIZE 5
+#define STAT_ANALYZE 6
+#define STAT_BIGKEYS 7
+#define STAT_INTRINSIC_LATENCY 8
+#define STAT_REPLAY 9
+#define STAT_EXPORTER 10
+
+struct instance;
 
 static struct config {
     char *hostip;
@@ -40,39 +62,35 @@ static struct config {
     int stat; /* The kind of output to produce: STAT_* */
     int samplesize;
     int logscale;
+    int format;             /* HIST_FORMAT_* of the value size graphs */
+    int rate;               /* PINGs per second of the latency stat */
+    info *info; /* The last INFO sample, parsed */
+    /* Multi instance mode */
+    struct instance **instances;
+    int numinstances;
+    aeEventLoop *el;
+    long long round;        /* current polling round */
+    long long tick;         /* ms timestamp of the next tick */
+    long long roundtick;    /* ms timestamp of the current round */
+    int waiting;            /* instances of this round yet to reply */
+    int printed;            /* the current round was printed */
+    long long replies;      /* INFO replies (or errors) so far */
+    /* Keyspace scan */
+    int connections;        /* parallel SCAN connections */
+    int scancount;          /* COUNT argument of SCAN */
+    int budget;             /* PING latency budget in ms, 0 = no throttle */
+    int top;                /* keys and prefixes listed by bigkeys */
+    int prefixnodes;        /* budget of the bigkeys prefix trie */
+    char delimiter;         /* of the prefixes of key names */
+    /* Recording and replay */
+    char *recordfile;       /* record the INFO samples here */
+    tsWriter *recorder;
+    char *replayfile;
+    char *fields;           /* comma separated fields to replay */
+    char *from, *to;        /* window of the replay */
+    char *listen;           /* [ip:]port of the metrics exporter */
 } config;
 
-/* Return the specified INFO field from the INFO command output "info".
- * A new buffer is allocated for the result, that needs to be free'd.
- * If the field is not found NULL is returned. */
-static char *getInfoField(char *info, char *field) {
-    char *p = strstr(info,field);
-    char *n1, *n2;
-    char *result;
-
-    if (!p) return NULL;
-    p += strlen(field)+1;
-    n1 = strchr(p,'\r');
-    n2 = strchr(p,',');
-    if (n2 && n2 < n1) n1 = n2;
-    result = malloc(sizeof(char)*(n1-p)+1);
-    memcpy(result,p,(n1-p));
-    result[n1-p] = '\0';
-    return result;
-}
-
-/* Like the above function but automatically convert the result into
- * a long. On error (missing field) LONG_MIN is returned. */
-static long getLongInfoField(char *info, char *field) {
-    char *value = getInfoField(info,field);
-    long l;
-
-    if (!value) return LONG_MIN;
-    l = strtol(value,NULL,10);
-    free(value);
-    return l;
-}
-
 static redisReply *reconnectingCommand(const char *cmd) {
     redisContext *c = config.context;
     redisReply *reply = NULL;
@@ -102,20 +120,50 @@ static redisReply *reconnectingCommand(const char *cmd) {
     return reply;
 }
 
+/* Open the recording of the samples of an instance, exiting on errors. */
+static tsWriter *openRecording(const char *filename) {
+    tsWriter *w = tsCreateWriter(filename);
+
+    if (w == NULL) {
+        fprintf(stderr, "Error opening %s: %s\n", filename,
+            errno == EINVAL ? "not a redis-stat recording" : strerror(errno));
+        exit(1);
+    }
+    return w;
+}
+
+static void record(tsWriter *w, long long ms, info *info) {
+    if (tsAppend(w,ms,info) == -1) {
+        fprintf(stderr, "Error writing %s: %s\n", w->filename,
+            strerror(errno));
+        exit(1);
+    }
+}
+
+/* Fetch and parse INFO, recording it with "record". The result is valid
+ * until the next call. */
+static info *sampleInfo(void) {
+    redisReply *reply = reconnectingCommand("INFO");
+
+    if (reply->type == REDIS_REPLY_ERROR) {
+        fprintf(stderr, "Error: %s\n", reply->str);
+        exit(1);
+    }
+    infoParse(config.info,reply->str,reply->len);
+    freeReplyObject(reply);
+    if (config.recorder) record(config.recorder,microseconds()/1000,config.info);
+    return config.info;
+}
+
 static void overview() {
-    redisReply *reply;
+    info *info;
     long aux, requests = 0;
     int i = 0;
 
     while(1) {
         char buf[64];
-        int j;
 
-        reply = reconnectingCommand("INFO");
-        if (reply->type == REDIS_REPLY_ERROR) {
-            printf("ERROR: %s\n", reply->str);
-            exit(1);
-        }
+        info = sampleInfo();
 
         if ((i++ % 20) == 0) {
             printf(
@@ -124,47 +172,39 @@ static void overview() {
         }
 
         /* Keys */
-        aux = 0;
-        for (j = 0; j < 20; j++) {
-            long k;
-
-            sprintf(buf,"db%d:keys",j);
-            k = getLongInfoField(reply->str,buf);
-            if (k == LONG_MIN) continue;
-            aux += k;
-        }
+        aux = infoSumKeyspace(info,"keys");
         sprintf(buf,"%ld",aux);
         printf("%-11s",buf);
 
         /* Used memory */
-        aux = getLongInfoField(reply->str,"used_memory");
+        aux = infoGetLong(info,"used_memory");
         bytesToHuman(buf,aux);
         printf("%-8s",buf);
 
         /* Clients */
-        aux = getLongInfoField(reply->str,"connected_clients");
+        aux = infoGetLong(info,"connected_clients");
         sprintf(buf,"%ld",aux);
         printf(" %-8s",buf);
 
         /* Blocked (BLPOPPING) Clients */
-        aux = getLongInfoField(reply->str,"blocked_clients");
+        aux = infoGetLong(info,"blocked_clients");
         sprintf(buf,"%ld",aux);
         printf("%-8s",buf);
 
         /* Requets */
-        aux = getLongInfoField(reply->str,"total_commands_processed");
+        aux = infoGetLong(info,"total_commands_processed");
         sprintf(buf,"%ld (+%ld)",aux,requests == 0 ? 0 : aux-requests);
         printf("%-19s",buf);
         requests = aux;
 
         /* Connections */
-        aux = getLongInfoField(reply->str,"total_connections_received");
+        aux = infoGetLong(info,"total_connections_received");
         sprintf(buf,"%ld",aux);
         printf(" %-12s",buf);
 
         /* Children */
-        aux = getLongInfoField(reply->str,"bgsave_in_progress");
-        aux |= getLongInfoField(reply->str,"aof_rewrite_in_progress") << 1;
+        aux = infoGetLong(info,"bgsave_in_progress");
+        aux |= infoGetLong(info,"aof_rewrite_in_progress") << 1;
         switch(aux) {
         case 0: break;
         case 1:
@@ -179,13 +219,12 @@ static void overview() {
         }
 
         printf("\n");
-        freeReplyObject(reply);
         usleep(config.delay*1000);
     }
 }
 
 static void vmstat() {
-    redisReply *reply;
+    info *info;
     long aux, pagein = 0, pageout = 0, usedpages = 0, usedmemory = 0;
     long swapped = 0;
     int i = 0;
@@ -193,13 +232,8 @@ static void vmstat() {
     while(1) {
         char buf[64];
 
-        reply = reconnectingCommand("INFO");
-        if (reply->type == REDIS_REPLY_ERROR) {
-            fprintf(stderr, "Error: %s\n", reply->str);
-            exit(1);
-        }
-
-        aux = getLongInfoField(reply->str,"vm_enabled");
+        info = sampleInfo();
+        aux = infoGetLong(info,"vm_enabled");
         if (aux == LONG_MIN || aux == 0) {
             fprintf(stderr, "Error: Redis instance has VM disabled\n");
             exit(1);
@@ -212,19 +246,19 @@ static void vmstat() {
         }
 
         /* pagein */
-        aux = getLongInfoField(reply->str,"vm_stats_swappin_count");
+        aux = infoGetLong(info,"vm_stats_swappin_count");
         sprintf(buf,"%ld",aux-pagein);
         pagein = aux;
         printf(" %-9s",buf);
 
         /* pageout */
-        aux = getLongInfoField(reply->str,"vm_stats_swappout_count");
+        aux = infoGetLong(info,"vm_stats_swappout_count");
         sprintf(buf,"%ld",aux-pageout);
         pageout = aux;
         printf("%-9s",buf);
 
         /* Swapped objects */
-        aux = getLongInfoField(reply->str,"vm_stats_swapped_objects");
+        aux = infoGetLong(info,"vm_stats_swapped_objects");
         sprintf(buf,"%ld",aux);
         printf(" %-10s",buf);
 
@@ -235,7 +269,7 @@ static void vmstat() {
         printf("%-10s",buf);
 
         /* used pages */
-        aux = getLongInfoField(reply->str,"vm_stats_used_pages");
+        aux = infoGetLong(info,"vm_stats_used_pages");
         sprintf(buf,"%ld",aux);
         printf("%-9s",buf);
 
@@ -246,7 +280,7 @@ static void vmstat() {
         printf("%-9s",buf);
 
         /* Used memory */
-        aux = getLongInfoField(reply->str,"used_memory");
+        aux = infoGetLong(info,"used_memory");
         bytesToHuman(buf,aux);
         printf(" %-9s",buf);
 
@@ -257,264 +291,1766 @@ static void vmstat() {
         printf("%-9s",buf);
 
         printf("\n");
-        freeReplyObject(reply);
         usleep(config.delay*1000);
     }
 }
 
+/* Multi instance overview: all the instances given with "hosts" or
+ * "hostsfile" are polled concurrently with async contexts on a single event
+ * loop. The INFO requests of every round are sent at the same tick, aligned
+ * to a multiple of "delay" on the wall clock, so the samples of different
+ * instances (and of different redis-stat processes) can be compared. The
+ * round is printed as soon as every instance replied, or at the next tick
+ * at the latest: an instance that did not reply by then is shown as stalled
+ * and does not get a new request until it replies, so it never delays the
+ * others. */
+typedef struct instance {
+    char *name;             /* "host:port" as given */
+    char *ip;
+    int port;
+    redisAsyncContext *context; /* NULL when not connected */
+    info *info;             /* last sample */
+    tsWriter *recorder;     /* with "record", file.host.port */
+    long long round;        /* round of the last request sent */
+    long long sent;         /* when the last request was sent */
+    int pending;            /* a request is in flight */
+    int ok;                 /* the last request got a sample */
+    long requests;          /* total_commands_processed of the last sample */
+    long long sampled;      /* when the last sample was received */
+    double reqpersec;
+    char err[64];           /* why the instance is down */
+} instance;
+
+static instance *createInstance(char *name) {
+    instance *inst = zmalloc(sizeof(*inst));
+    char *colon = strrchr(name,':');
+
+    inst->name = name;
+    inst->ip = zstrdup(name);
+    inst->port = config.hostport;
+    if (colon) {
+        inst->ip[colon-name] = '\0';
+        inst->port = atoi(colon+1);
+    }
+    inst->context = NULL;
+    inst->info = infoCreate();
+    inst->recorder = NULL;
+    inst->round = 0;
+    inst->sent = inst->sampled = 0;
+    inst->pending = inst->ok = 0;
+    inst->requests = LONG_MIN;
+    inst->reqpersec = 0;
+    strcpy(inst->err,"not connected");
+    return inst;
+}
+
+/* Add the instances of a "host:port,host:port" list. */
+static void addInstances(char *list) {
+    char *name;
+
+    for (name = strtok(list,", \t\r\n"); name; name = strtok(NULL,", \t\r\n")) {
+        config.instances = zrealloc(config.instances,
+            sizeof(instance*)*(config.numinstances+1));
+        config.instances[config.numinstances++] = createInstance(zstrdup(name));
+    }
+}
+
+/* Add the instances listed in a file, one or more per line. */
+static void addInstancesFromFile(char *filename) {
+    FILE *fp = fopen(filename,"r");
+    char line[1024];
+
+    if (fp == NULL) {
+        perror(filename);
+        exit(1);
+    }
+    while (fgets(line,sizeof(line),fp) != NULL) {
+        if (line[0] == '#') continue;
+        addInstances(line);
+    }
+    fclose(fp);
+}
+
+static void instanceDisconnected(const redisAsyncContext *context, int status) {
+    instance *inst = context->data;
+
+    if (status != REDIS_OK)
+        snprintf(inst->err,sizeof(inst->err),"%s",context->errstr);
+    else
+        strcpy(inst->err,"connection closed");
+    inst->context = NULL;
+    inst->pending = 0;
+    inst->ok = 0;
+}
+
+static void instanceConnect(instance *inst) {
+    redisAsyncContext *ac = redisAsyncConnect(inst->ip,inst->port);
+
+    if (ac->err) {
+        snprintf(inst->err,sizeof(inst->err),"%s",ac->errstr);
+        redisFree(&ac->c);
+        return;
+    }
+    ac->data = inst;
+    redisAsyncSetDisconnectCallback(ac,instanceDisconnected);
+    redisAeAttach(config.el,ac);
+    inst->context = ac;
+}
+
+static void printRound(void) {
+    long long now = microseconds();
+    long keys = 0, mem = 0, clients = 0, blocked = 0;
+    long maxkeys = 0, maxmem = 0, maxclients = 0, maxblocked = 0;
+    double reqpersec = 0, maxreqpersec = 0;
+    int j, up = 0, late = 0, stalled = 0, down = 0;
+    char buf[64];
+    time_t t = config.roundtick/1000;
+
+    /* An instance that stalled and then replied is late: it has a sample,
+     * just not one of this round, as it got no request in this round. */
+    for (j = 0; j < config.numinstances; j++) {
+        instance *inst = config.instances[j];
+
+        if (inst->pending) stalled++;
+        else if (!inst->ok) down++;
+        else if (inst->round == config.round) up++;
+        else late++;
+    }
+    strftime(buf,sizeof(buf),"%Y-%m-%d %H:%M:%S",localtime(&t));
+    printf("--- %s --- %d up, %d late, %d stalled, %d down\n", buf, up, late,
+        stalled, down);
+    printf("%-24s %-10s %-9s %-8s %-8s %-10s %s\n",
+        "instance", "keys", "mem", "clients", "blocked", "req/s", "child");
+
+    for (j = 0; j < config.numinstances; j++) {
+        instance *inst = config.instances[j];
+        long k, m, c, b, child;
+
+        printf("%-24s ", inst->name);
+        if (inst->pending) {
+            printf("stalled for %.1f s\n", (double)(now-inst->sent)/1000000);
+            continue;
+        } else if (!inst->ok) {
+            printf("down: %s\n", inst->err);
+            continue;
+        }
+        k = infoSumKeyspace(inst->info,"keys");
+        m = infoGetLong(inst->info,"used_memory");
+        c = infoGetLong(inst->info,"connected_clients");
+        b = infoGetLong(inst->info,"blocked_clients");
+        child = infoGetLong(inst->info,"bgsave_in_progress") == 1;
+        child |= (infoGetLong(inst->info,"aof_rewrite_in_progress") == 1) << 1;
+        keys += k; mem += m; clients += c; blocked += b;
+        reqpersec += inst->reqpersec;
+        if (k > maxkeys) maxkeys = k;
+        if (m > maxmem) maxmem = m;
+        if (c > maxclients) maxclients = c;
+        if (b > maxblocked) maxblocked = b;
+        if (inst->reqpersec > maxreqpersec) maxreqpersec = inst->reqpersec;
+
+        bytesToHuman(buf,m);
+        printf("%-10ld %-9s %-8ld %-8ld %-10.0f %s%s\n", k, buf, c, b,
+            inst->reqpersec, child == 3 ? "SAVE+AOF" :
+                             child == 2 ? "AOF" : child == 1 ? "SAVE" : "",
+            inst->round == config.round ? "" : " (late)");
+    }
+    bytesToHuman(buf,mem);
+    printf("%-24s %-10ld %-9s %-8ld %-8ld %.0f\n", "fleet total", keys,
+        buf, clients, blocked, reqpersec);
+    bytesToHuman(buf,maxmem);
+    printf("%-24s %-10ld %-9s %-8ld %-8ld %.0f\n", "fleet max", maxkeys,
+        buf, maxclients, maxblocked, maxreqpersec);
+    printf("\n");
+    fflush(stdout);
+}
+
+static void exporterRoundDone(void);
+
+/* The round is over: every instance replied, or the next tick came. */
+static void roundDone(void) {
+    if (config.printed) return;
+    config.printed = 1;
+    if (config.stat == STAT_EXPORTER) exporterRoundDone();
+    else printRound();
+}
+
+static void instanceReply(redisAsyncContext *context, void *r, void *privdata) {
+    redisReply *reply = r;
+    instance *inst = privdata;
+
+    inst->pending = 0;
+    config.replies++;
+    if (reply == NULL) {
+        snprintf(inst->err,sizeof(inst->err),"%s",context->errstr);
+        inst->ok = 0;
+    } else if (reply->type != REDIS_REPLY_STRING) {
+        snprintf(inst->err,sizeof(inst->err),"%s",
+            reply->type == REDIS_REPLY_ERROR ? reply->str : "bad reply");
+        inst->ok = 0;
+    } else {
+        long long now = microseconds();
+        long requests;
+
+        infoParse(inst->info,reply->str,reply->len);
+        if (inst->recorder) record(inst->recorder,config.roundtick,inst->info);
+        requests = infoGetLong(inst->info,"total_commands_processed");
+        inst->reqpersec = 0;
+        if (inst->requests != LONG_MIN && now > inst->sampled)
+            inst->reqpersec = (double)(requests-inst->requests)*1000000/
+                              (now-inst->sampled);
+        inst->requests = requests;
+        inst->sampled = now;
+        inst->ok = 1;
+    }
+    if (reply) freeReplyObject(reply);
+
+    /* Print the round when the last instance of this round replied. */
+    if (inst->round == config.round && --config.waiting == 0) roundDone();
+}
+
+/* Milliseconds to the next multiple of the delay on the wall clock. */
+static long long msToNextTick(void) {
+    long long ms = microseconds()/1000;
+
+    config.tick = ms-(ms % config.delay)+config.delay;
+    return config.tick-ms;
+}
+
+static int fleetTick(struct aeEventLoop *el, long long id, void *privdata) {
+    long long now = microseconds();
+    int j;
+    REDIS_NOTUSED(el); REDIS_NOTUSED(id); REDIS_NOTUSED(privdata);
+
+    /* Whatever did not reply to the previous round is stalled by now. */
+    if (config.round) roundDone();
+
+    config.roundtick = config.tick;
+    config.round++;
+    config.printed = 0;
+    config.waiting = 0;
+    for (j = 0; j < config.numinstances; j++) {
+        instance *inst = config.instances[j];
+
+        if (inst->context == NULL) instanceConnect(inst);
+        if (inst->context == NULL || inst->pending) continue;
+        if (redisAsyncCommand(inst->context,instanceReply,inst,"INFO")
+            != REDIS_OK) continue;
+        inst->pending = 1;
+        inst->round = config.round;
+        inst->sent = now;
+        config.waiting++;
+    }
+    if (config.waiting == 0) roundDone();
+    return msToNextTick();
+}
+
+static void fleet(void) {
+    char filename[1024];
+    int j;
+
+    for (j = 0; config.recordfile && j < config.numinstances; j++) {
+        instance *inst = config.instances[j];
+
+        snprintf(filename,sizeof(filename),"%s.%s.%d",config.recordfile,
+            inst->ip,inst->port);
+        inst->recorder = openRecording(filename);
+    }
+    if (config.el == NULL) config.el = aeCreateEventLoop();
+    aeCreateTimeEvent(config.el,msToNextTick(),fleetTick,NULL,NULL);
+    aeMain(config.el);
+}
+
+/* Metrics exporter: the instances are polled like in the multi instance
+ * overview, and at the end of every round the INFO fields are rendered in
+ * the Prometheus text format into a snapshot. A scrape of /metrics is
+ * answered with the snapshot plus the metrics of the exporter itself, so
+ * it never waits for Redis. As a round ends only when every instance
+ * replied (or at the next tick), a scrape finding replies newer than the
+ * snapshot builds it again, at most every EXPORTER_REBUILD_MS: so an
+ * instance that stalls only makes its own samples older, and their age is
+ * exported too. A client that did not get its response in
+ * EXPORTER_TIMEOUT_MS is closed. */
+#define EXPORTER_MAX_REQUEST 8192
+#define EXPORTER_IOBUF (1024*16)
+#define EXPORTER_REBUILD_MS 100
+#define EXPORTER_TIMEOUT_MS 10000
+
+typedef struct exporterMetric {
+    char *field;            /* INFO field, the first one found is used */
+    char *altfield;         /* older name of the field, or NULL */
+    char *name;
+    char *type;
+    char *help;
+} exporterMetric;
+
+static exporterMetric exporterMetrics[] = {
+    {"uptime_in_seconds",NULL,"redis_uptime_in_seconds","gauge",
+     "Seconds since the server started"},
+    {"connected_clients",NULL,"redis_connected_clients","gauge",
+     "Clients connected"},
+    {"blocked_clients",NULL,"redis_blocked_clients","gauge",
+     "Clients blocked in a blocking command"},
+    {"used_memory",NULL,"redis_memory_used_bytes","gauge",
+     "Memory allocated by the server"},
+    {"used_memory_rss",NULL,"redis_memory_rss_bytes","gauge",
+     "Memory resident in RAM"},
+    {"total_commands_processed",NULL,"redis_commands_processed_total",
+     "counter","Commands processed"},
+    {"total_connections_received",NULL,"redis_connections_received_total",
+     "counter","Connections accepted"},
+    {"expired_keys",NULL,"redis_expired_keys_total","counter",
+     "Keys expired"},
+    {"evicted_keys",NULL,"redis_evicted_keys_total","counter",
+     "Keys evicted for the maxmemory limit"},
+    {"keyspace_hits",NULL,"redis_keyspace_hits_total","counter",
+     "Lookups of existing keys"},
+    {"keyspace_misses",NULL,"redis_keyspace_misses_total","counter",
+     "Lookups of missing keys"},
+    {"rdb_bgsave_in_progress","bgsave_in_progress",
+     "redis_rdb_bgsave_in_progress","gauge","1 while a BGSAVE runs"},
+    {"aof_rewrite_in_progress",NULL,"redis_aof_rewrite_in_progress","gauge",
+     "1 while an AOF rewrite runs"},
+    {"rdb_changes_since_last_save","changes_since_last_save",
+     "redis_rdb_changes_since_last_save","gauge",
+     "Writes since the last save"},
+    {NULL,NULL,NULL,NULL,NULL}
+};
+
+typedef struct exporterClient {
+    int fd;
+    long long timer;        /* id of the timeout, -1 when it fired */
+    sds ibuf;
+    sds obuf;
+    size_t sent;            /* bytes of obuf written */
+    long long start;        /* us, when the request was complete */
+    int metrics;            /* the request was for /metrics */
+} exporterClient;
+
+static struct exporter {
+    sds snapshot;           /* metrics of the instances, last round */
+    long long snapshotted;  /* us, when the snapshot was built */
+    long long replies;      /* config.replies at that time */
+    long long roundusec;    /* duration of the last round */
+    long long scrapes;
+    histogram *latency;     /* of the scrapes, us */
+} exporter;
+
+/* Append the value of an INFO field if it is a number. */
+static sds exporterValue(sds out, char *name, char *instance,
+                         const char *v)
+{
+    char *end;
+
+    if (v == NULL || *v == '\0') return out;
+    strtod(v,&end);
+    if (*end != '\0') return out;
+    return sdscatprintf(out,"%s{instance=\"%s\"} %s\n", name, instance, v);
+}
+
+static sds exporterHeader(sds out, char *name, char *type, char *help) {
+    return sdscatprintf(out,"# HELP %s %s\n# TYPE %s %s\n", name, help,
+        name, type);
+}
+
+static void exporterSnapshot(void) {
+    sds out = sdsempty();
+    int j, k;
+
+    out = exporterHeader(out,"redis_up","gauge",
+        "1 if the last request to the instance got a sample");
+    for (j = 0; j < config.numinstances; j++) {
+        instance *inst = config.instances[j];
+
+        out = sdscatprintf(out,"redis_up{instance=\"%s\"} %d\n", inst->name,
+            inst->ok);
+    }
+    out = exporterHeader(out,"redis_db_keys","gauge","Keys of a DB");
+    for (j = 0; j < config.numinstances; j++) {
+        instance *inst = config.instances[j];
+
+        if (!inst->ok) continue;
+        for (k = 0; k < inst->info->numfields; k++) {
+            infoField *f = inst->info->fields+k;
+            char *name = infoName(inst->info,f), *dot = strchr(name,'.');
+
+            if (strncmp(name,"db",2) || !dot || strcmp(dot,".keys")) continue;
+            out = sdscatprintf(out,
+                "redis_db_keys{instance=\"%s\",db=\"%.*s\"} %s\n",
+                inst->name, (int)(dot-name), name, infoValue(inst->info,f));
+        }
+    }
+    for (k = 0; exporterMetrics[k].field; k++) {
+        exporterMetric *m = exporterMetrics+k;
+
+        out = exporterHeader(out,m->name,m->type,m->help);
+        for (j = 0; j < config.numinstances; j++) {
+            instance *inst = config.instances[j];
+            const char *v;
+
+            if (!inst->ok) continue;
+            v = infoGet(inst->info,m->field);
+            if (v == NULL && m->altfield) v = infoGet(inst->info,m->altfield);
+            out = exporterValue(out,m->name,inst->name,v);
+        }
+    }
+    sdsfree(exporter.snapshot);
+    exporter.snapshot = out;
+    exporter.snapshotted = microseconds();
+    exporter.replies = config.replies;
+}
+
+static void exporterRoundDone(void) {
+    exporterSnapshot();
+    exporter.roundusec = exporter.snapshotted-config.roundtick*1000;
+}
+
+/* The part of the response built at every scrape: the age of the samples
+ * and the metrics of the exporter itself. */
+static sds exporterSelfMetrics(sds out) {
+    long long now = microseconds();
+    int j, up = 0, stalled = 0, down = 0;
+    static double quantiles[] = {0.5,0.9,0.99};
+
+    out = exporterHeader(out,"redis_stat_sample_age_seconds","gauge",
+        "Age of the last sample of the instance");
+    for (j = 0; j < config.numinstances; j++) {
+        instance *inst = config.instances[j];
+
+        if (inst->pending) stalled++;
+        else if (inst->ok) up++;
+        else down++;
+        if (inst->sampled == 0) continue;
+        out = sdscatprintf(out,
+            "redis_stat_sample_age_seconds{instance=\"%s\"} %.3f\n",
+            inst->name, (double)(now-inst->sampled)/1000000);
+    }
+    out = exporterHeader(out,"redis_stat_instances","gauge",
+        "Instances polled, by state");
+    out = sdscatprintf(out,"redis_stat_instances{state=\"up\"} %d\n"
+        "redis_stat_instances{state=\"stalled\"} %d\n"
+        "redis_stat_instances{state=\"down\"} %d\n", up, stalled, down);
+    out = exporterHeader(out,"redis_stat_snapshot_age_seconds","gauge",
+        "Age of the snapshot of the metrics of the instances");
+    out = sdscatprintf(out,"redis_stat_snapshot_age_seconds %.3f\n",
+        exporter.snapshotted ? (double)(now-exporter.snapshotted)/1000000 : 0);
+    out = exporterHeader(out,"redis_stat_round_duration_seconds","gauge",
+        "Time to poll every instance in the last round");
+    out = sdscatprintf(out,"redis_stat_round_duration_seconds %.6f\n",
+        (double)exporter.roundusec/1000000);
+    out = exporterHeader(out,"redis_stat_scrape_duration_seconds","summary",
+        "Time to answer a scrape, from the request to the last byte sent");
+    for (j = 0; j < 3; j++)
+        out = sdscatprintf(out,
+            "redis_stat_scrape_duration_seconds{quantile=\"%g\"} %.6f\n",
+            quantiles[j],
+            (double)histPercentile(exporter.latency,quantiles[j]*100)/1000000);
+    out = sdscatprintf(out,"redis_stat_scrape_duration_seconds_sum %.6f\n"
+        "redis_stat_scrape_duration_seconds_count %llu\n",
+        exporter.latency->sum/1000000, exporter.latency->count);
+    out = exporterHeader(out,"redis_stat_scrapes_total","counter",
+        "Requests for /metrics");
+    out = sdscatprintf(out,"redis_stat_scrapes_total %lld\n",
+        exporter.scrapes);
+    return out;
+}
+
+static void freeExporterClient(exporterClient *c) {
+    if (c->timer != -1) aeDeleteTimeEvent(config.el,c->timer);
+    aeDeleteFileEvent(config.el,c->fd,AE_READABLE|AE_WRITABLE);
+    close(c->fd);
+    sdsfree(c->ibuf);
+    sdsfree(c->obuf);
+    zfree(c);
+}
+
+static void exporterWritable(aeEventLoop *el, int fd, void *privdata,
+                             int mask)
+{
+    exporterClient *c = privdata;
+    ssize_t nwritten;
+    REDIS_NOTUSED(el); REDIS_NOTUSED(mask);
+
+    while (c->sent < sdslen(c->obuf)) {
+        nwritten = write(fd,c->obuf+c->sent,sdslen(c->obuf)-c->sent);
+        if (nwritten == -1) {
+            if (errno == EAGAIN) return;
+            freeExporterClient(c);
+            return;
+        }
+        c->sent += nwritten;
+    }
+    if (c->metrics) histAdd(exporter.latency,microseconds()-c->start);
+    freeExporterClient(c);
+}
+
+static void exporterRespond(exporterClient *c, char *status, sds body) {
+    c->obuf = sdscatprintf(c->obuf,"HTTP/1.0 %s\r\n"
+        "Content-Type: text/plain; version=0.0.4\r\n"
+        "Content-Length: %zu\r\nConnection: close\r\n\r\n",
+        status, sdslen(body));
+    c->obuf = sdscatlen(c->obuf,body,sdslen(body));
+    sdsfree(body);
+    aeDeleteFileEvent(config.el,c->fd,AE_READABLE);
+    if (aeCreateFileEvent(config.el,c->fd,AE_WRITABLE,exporterWritable,c)
+        == AE_ERR) freeExporterClient(c);
+}
+
+static void exporterReadable(aeEventLoop *el, int fd, void *privdata,
+                             int mask)
+{
+    exporterClient *c = privdata;
+    char buf[EXPORTER_IOBUF], *eol;
+    ssize_t nread;
+    REDIS_NOTUSED(el); REDIS_NOTUSED(mask);
+
+    nread = read(fd,buf,sizeof(buf));
+    if (nread == -1 && errno == EAGAIN) return;
+    if (nread <= 0) {
+        freeExporterClient(c);
+        return;
+    }
+    c->ibuf = sdscatlen(c->ibuf,buf,nread);
+    if (strstr(c->ibuf,"\r\n\r\n") == NULL && strstr(c->ibuf,"\n\n") == NULL) {
+        if (sdslen(c->ibuf) > EXPORTER_MAX_REQUEST) freeExporterClient(c);
+        return;
+    }
+
+    /* Only the request line matters: GET <path> HTTP/1.x */
+    c->start = microseconds();
+    eol = strchr(c->ibuf,'\n');
+    *eol = '\0';
+    if (strncmp(c->ibuf,"GET ",4)) {
+        exporterRespond(c,"405 Method Not Allowed",
+            sdsnew("Only GET is supported\n"));
+    } else if (!strncmp(c->ibuf+4,"/metrics",8) &&
+               (c->ibuf[12] == ' ' || c->ibuf[12] == '?'))
+    {
+        sds body = sdsempty();
+
+        exporter.scrapes++;
+        c->metrics = 1;
+        if (exporter.replies != config.replies && c->start-
+            exporter.snapshotted >= EXPORTER_REBUILD_MS*1000) exporterSnapshot();
+        if (exporter.snapshot)
+            body = sdscatlen(body,exporter.snapshot,sdslen(exporter.snapshot));
+        exporterRespond(c,"200 OK",exporterSelfMetrics(body));
+    } else {
+        exporterRespond(c,"404 Not Found",
+            sdsnew("The metrics are at /metrics\n"));
+    }
+}
+
+static int exporterTimeout(aeEventLoop *el, long long id, void *privdata) {
+    exporterClient *c = privdata;
+    REDIS_NOTUSED(el); REDIS_NOTUSED(id);
+
+    c->timer = -1;
+    freeExporterClient(c);
+    return AE_NOMORE;
+}
+
+static void exporterAccept(aeEventLoop *el, int fd, void *privdata,
+                           int mask)
+{
+    exporterClient *c;
+    int cfd;
+    REDIS_NOTUSED(privdata); REDIS_NOTUSED(mask);
+
+    cfd = accept(fd,NULL,NULL);
+    if (cfd == -1) return;
+    fcntl(cfd,F_SETFL,fcntl(cfd,F_GETFL)|O_NONBLOCK);
+
+    c = zmalloc(sizeof(*c));
+    c->fd = cfd;
+    c->ibuf = sdsempty();
+    c->obuf = sdsempty();
+    c->sent = 0;
+    c->start = 0;
+    c->metrics = 0;
+    c->timer = -1;
+    if (aeCreateFileEvent(el,cfd,AE_READABLE,exporterReadable,c) == AE_ERR) {
+        freeExporterClient(c);
+        return;
+    }
+    c->timer = aeCreateTimeEvent(el,EXPORTER_TIMEOUT_MS,exporterTimeout,c,
+        NULL);
+}
+
+/* Listen on "[ip:]port", the loopback interface when no ip is given. */
+static int exporterListen(char *addr) {
+    struct sockaddr_in sa;
+    char *colon = strrchr(addr,':'), ip[64] = "127.0.0.1";
+    int fd, yes = 1;
+
+    if (colon) snprintf(ip,sizeof(ip),"%.*s",(int)(colon-addr),addr);
+    memset(&sa,0,sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons(atoi(colon ? colon+1 : addr));
+    if (inet_aton(ip,&sa.sin_addr) == 0) {
+        fprintf(stderr, "Error: invalid address '%s'\n", ip);
+        exit(1);
+    }
+    if ((fd = socket(AF_INET,SOCK_STREAM,0)) == -1 ||
+        setsockopt(fd,SOL_SOCKET,SO_REUSEADDR,&yes,sizeof(yes)) == -1 ||
+        bind(fd,(struct sockaddr*)&sa,sizeof(sa)) == -1 ||
+        listen(fd,511) == -1)
+    {
+        fprintf(stderr, "Error listening on %s: %s\n", addr, strerror(errno));
+        exit(1);
+    }
+    fcntl(fd,F_SETFL,fcntl(fd,F_GETFL)|O_NONBLOCK);
+    printf("Serving the metrics of %d instances on http://%s:%d/metrics\n",
+        config.numinstances, ip, ntohs(sa.sin_port));
+    fflush(stdout);
+    return fd;
+}
+
+static void exporterMain(void) {
+    char *name;
+
+    /* A single instance is polled like a fleet of one. */
+    if (config.numinstances == 0) {
+        name = zmalloc(strlen(config.hostip)+16);
+        sprintf(name,"%s:%d",config.hostip,config.hostport);
+        addInstances(name);
+        zfree(name);
+    }
+    signal(SIGPIPE,SIG_IGN);
+    exporter.snapshot = NULL;
+    exporter.snapshotted = exporter.roundusec = exporter.replies = 0;
+    exporter.scrapes = 0;
+    exporter.latency = histCreate();
+    config.el = aeCreateEventLoop();
+    aeCreateFileEvent(config.el,exporterListen(config.listen),AE_READABLE,
+        exporterAccept,NULL);
+    fleet();
+}
+
+/* Nanoseconds from an arbitrary point, not affected by clock changes. */
+static long long monotonicNanoseconds(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return (long long)ts.tv_sec*1000000000+ts.tv_nsec;
+}
+
+/* Print the distribution of a window and, after it, the one of all the
+ * windows so far. Values are divided by 1000 (us to ms, ns to us). */
+static void printLatencyWindow(histogram *window, histogram *all, int *lines,
+                               char *unit)
+{
+    if ((*lines)++ % 20 == 0) {
+        printf(
+"----------------------- window (%s) ----------------------- --------- all (%s) ---------\n"
+"samples    min      avg      p50      p99      max          p99      p99.9    max\n",
+            unit, unit);
+    }
+    printf("%-10llu %-8.2f %-8.2f %-8.2f %-8.2f %-8.2f     %-8.2f %-8.2f %.2f\n",
+        window->count, (double)window->min/1000, histMean(window)/1000,
+        (double)histPercentile(window,50)/1000,
+        (double)histPercentile(window,99)/1000, (double)window->max/1000,
+        (double)histPercentile(all,99)/1000,
+        (double)histPercentile(all,99.9)/1000, (double)all->max/1000);
+    fflush(stdout);
+}
+
+/* Measure the PING round trip time. Without "rate" a PING is sent and
+ * printed every "delay" milliseconds. With "rate" PINGs are sent at that
+ * rate, and every "delay" milliseconds the distribution of the window is
+ * printed, with the percentiles since the start. */
 static void latency() {
+    histogram *window, *all;
     redisReply *reply;
-    long long start;
-    int seq = 1;
+    long long start, next, interval, windowstart, rtt;
+    int seq = 1, lines = 0;
 
-    while(1) {
+    while(config.rate == 0) {
         start = microseconds();
         reply = reconnectingCommand("PING");
         freeReplyObject(reply);
         printf("%d: %.2f ms\n",seq++,(double)(microseconds()-start)/1000);
         usleep(config.delay*1000);
     }
+
+    window = histCreate();
+    all = histCreate();
+    interval = 1000000/config.rate;
+    next = windowstart = microseconds();
+    while(1) {
+        start = microseconds();
+        if (next > start) {
+            usleep(next-start);
+            start = microseconds();
+        } else if (start-next > interval) {
+            /* Late by more than a PING: don't send a burst to catch up. */
+            next = start;
+        }
+        next += interval;
+
+        reply = reconnectingCommand("PING");
+        freeReplyObject(reply);
+        rtt = microseconds()-start;
+        histAdd(window,rtt);
+        histAdd(all,rtt);
+        if (start-windowstart >= (long long)config.delay*1000) {
+            printLatencyWindow(window,all,&lines,"ms");
+            histReset(window);
+            windowstart = start;
+        }
+    }
 }
 
-size_t getSerializedLen(char *key) {
-    redisContext *c = config.context;
-    redisReply *reply;
-    size_t sl = 0;
+/* Measure the latency of the host itself, with no server involved: a busy
+ * loop reads the clock, and any gap between two reads is time the process
+ * did not run (scheduler, interrupts, the hypervisor stealing the CPU).
+ * Comparing it with the latency stat tells the host noise apart from the
+ * network and the server. */
+static void intrinsicLatency() {
+    histogram *window = histCreate(), *all = histCreate();
+    long long last, now, windowstart;
+    int lines = 0;
+
+    printf("Measuring the intrinsic latency of this host, "
+           "run it where the server runs\n");
+    last = windowstart = monotonicNanoseconds();
+    while(1) {
+        now = monotonicNanoseconds();
+        histAdd(window,now-last);
+        histAdd(all,now-last);
+        last = now;
+        if (now-windowstart >= (long long)config.delay*1000000) {
+            printLatencyWindow(window,all,&lines,"us");
+            histReset(window);
+            windowstart = last = monotonicNanoseconds();
+        }
+    }
+}
+
+#define SAMPLE_SERIALIZEDLEN 0
+#define SAMPLE_MEMORY 1
+#define SAMPLE_STRLEN 2
+
+/* Read the next reply of a pipeline, exiting on connection errors. */
+static redisReply *pipelineReply(redisContext *c) {
+    void *reply;
+
+    if (redisGetReply(c,&reply) != REDIS_OK) {
+        fprintf(stderr, "Error: %s\n", c->errstr);
+        exit(1);
+    }
+    return reply;
+}
+
+/* Extract the requested size from the reply to the probe of a key, 0 when
+ * the key is gone or the probe failed. */
+static size_t sampleValue(redisReply *r, int type) {
     char *p;
 
-    /* The value may be swapped out, try to load it */
-    reply = redisCommand(c,"GET %s",key);
-    freeReplyObject(reply);
+    if (type == SAMPLE_SERIALIZEDLEN) {
+        if (r->type != REDIS_REPLY_STRING && r->type != REDIS_REPLY_STATUS)
+            return 0;
+        p = strstr(r->str,"serializedlength:");
+        return p ? strtoul(p+17,NULL,10) : 0;
+    } else {
+        /* MEMORY USAGE and STRLEN, that is 0 for a key that is gone. */
+        return r->type == REDIS_REPLY_INTEGER ? (size_t)r->integer : 0;
+    }
+}
 
-    reply = redisCommand(c,"DEBUG OBJECT %s",key);
-    if (reply->type == REDIS_REPLY_STRING) {
-        p = strstr(reply->str,"serializedlength:");
-        if (p) sl = strtol(p+17,NULL,10);
+/* Sample the size of "samplesize" random keys of DB 0: the length of the
+ * value once serialized (DEBUG OBJECT), the memory it uses (MEMORY USAGE),
+ * or the length of the strings (STRLEN, the keys of other types are counted
+ * as skipped). Every sample is passed to "proc" with the length of its key,
+ * and nothing
+ * is kept here, so the memory used does not depend on the sample size.
+ * Both steps are pipelined: a batch of RANDOMKEY first, then a batch of
+ * probes for the keys returned, so every SAMPLE_BATCH samples cost two
+ * round trips. Keys that disappear in the meantime are not counted. The
+ * progress goes to stderr when stdout is CSV or JSON. */
+#define SAMPLE_BATCH 1000
+typedef void sampleProc(size_t keylen, size_t value, void *privdata);
+
+static void sampleDataset(redisContext *c, int type, sampleProc *proc,
+                          void *privdata)
+{
+    FILE *out = config.format == HIST_FORMAT_TEXT ? stdout : stderr;
+    redisReply *keys[SAMPLE_BATCH], *r;
+    double avg, totsl = 0, totsq = 0;
+    size_t sl;
+    int j, k, n = 0, batch, skipped = 0;
+    char err[128];
+
+    fprintf(out,"Sampling %d random keys from DB 0...\n", config.samplesize);
+    while (n < config.samplesize) {
+        batch = config.samplesize-n;
+        if (batch > SAMPLE_BATCH) batch = SAMPLE_BATCH;
+
+        for (j = 0; j < batch; j++) redisAppendCommand(c,"RANDOMKEY");
+        for (j = 0; j < batch; j++) {
+            keys[j] = pipelineReply(c);
+            if (keys[j]->type == REDIS_REPLY_NIL) {
+                printf("Sorry but DB 0 is empty\n");
+                exit(1);
+            } else if (keys[j]->type == REDIS_REPLY_ERROR) {
+                printf("Error: %s\n", keys[j]->str);
+                exit(1);
+            }
+        }
+
+        for (j = 0; j < batch; j++) {
+            if (type == SAMPLE_SERIALIZEDLEN)
+                redisAppendCommand(c,"DEBUG OBJECT %b",keys[j]->str,
+                    keys[j]->len);
+            else if (type == SAMPLE_STRLEN)
+                redisAppendCommand(c,"STRLEN %b",keys[j]->str,keys[j]->len);
+            else
+                redisAppendCommand(c,"MEMORY USAGE %b",keys[j]->str,
+                    keys[j]->len);
+        }
+        err[0] = '\0';
+        for (j = 0, k = n; j < batch; j++) {
+            r = pipelineReply(c);
+            if ((sl = sampleValue(r,type)) != 0) {
+                proc(keys[j]->len,sl,privdata);
+                totsl += sl;
+                totsq += (double)sl*sl;
+                n++;
+            } else if (type == SAMPLE_STRLEN &&
+                       r->type == REDIS_REPLY_ERROR &&
+                       !strncmp(r->str,"WRONGTYPE",9)) {
+                skipped++;
+                n++;
+            } else if (r->type == REDIS_REPLY_ERROR) {
+                snprintf(err,sizeof(err),"%s",r->str);
+            }
+            freeReplyObject(r);
+            freeReplyObject(keys[j]);
+        }
+        /* Not a single probe of the batch worked: the command is probably
+         * not supported by this server, or disabled. */
+        if (n == k) {
+            printf("Error: %s\n", err[0] ? err : "can't probe the keys");
+            exit(1);
+        }
+        fprintf(out,"%d\r", n);
+        fflush(out);
+    }
+    if (skipped)
+        fprintf(out,"  Skipped: %d keys that are not strings\n", skipped);
+    if (n == skipped) return;
+    avg = totsl/(n-skipped);
+    fprintf(out,"  Average: %.0f\n", avg);
+    fprintf(out,"  Standard deviation: %.2lf\n\n",
+        sqrt(fabs(totsq/(n-skipped)-avg*avg)));
+}
+
+/* The "memory-efficiency" stat: how much memory do the keys of this dataset
+ * really take once the allocator rounded every allocation to its size
+ * class, and the slabs got the holes left by the freed keys? The lengths of
+ * the sampled keys and values feed the simulation in memsim.c, that is run
+ * for a few allocators at once. The simulation knows the allocations of a
+ * string key only, so the values are sampled with STRLEN and the keys of
+ * the other types are left out. This replaces the old "vmpage" stat, the
+ * VM being gone, and "vmpage" is still accepted as a name for it. */
+#define SIM_KEYS 200000
+typedef struct sampleArrays {
+    size_t *values, *keylens;
+    int n;
+} sampleArrays;
+
+static void storeSample(size_t keylen, size_t value, void *privdata) {
+    sampleArrays *sa = privdata;
+
+    sa->keylens[sa->n] = keylen;
+    sa->values[sa->n++] = value;
+}
+
+static void memoryEfficiency() {
+    sampleArrays sa;
+
+    sa.values = zmalloc(config.samplesize*sizeof(size_t));
+    sa.keylens = zmalloc(config.samplesize*sizeof(size_t));
+    sa.n = 0;
+    sampleDataset(config.context,SAMPLE_STRLEN,storeSample,&sa);
+    if (sa.n == 0) {
+        printf("Sorry but none of the sampled keys is a string\n");
+        exit(1);
+    }
+    memsimRun(sa.values,sa.keylens,sa.n,SIM_KEYS);
+    zfree(sa.values);
+    zfree(sa.keylens);
+}
+
+static void histSample(size_t keylen, size_t value, void *privdata) {
+    REDIS_NOTUSED(keylen);
+    histAdd(privdata,value);
+}
+
+/* The ondisk-size and memory-size stats: the samples are streamed into a
+ * log-linear histogram, printed with four rows for every power of two, or
+ * one with "logscale". */
+#define GRAPH_ROW_BITS 2
+static void valueSize(int type) {
+    histogram *h = histCreate();
+
+    sampleDataset(config.context,type,histSample,h);
+    histPrint(h,config.format,config.logscale ? 0 : GRAPH_ROW_BITS);
+    histRelease(h);
+}
+
+/* Full keyspace walk with SCAN, shared by the analyze and bigkeys stats.
+ *
+ * The keyspace of DB 0 is split among "connections" async connections. The
+ * SCAN cursor is the hash table bucket index with its bits reversed, and it
+ * is incremented from the top: so with 2^k parts, the cursors of part p are
+ * the ones whose k low bits are the k bits of p reversed, and a connection
+ * starting there is done when SCAN returns a cursor out of its part (or 0).
+ * This is how the cursor of a standalone Redis works, not something SCAN
+ * promises: in cluster mode the low bits of the cursor are the slot, so
+ * there (or when INFO does not look like Redis at all) a single connection
+ * follows the cursor as an opaque value. The parts are also kept to at most
+ * one every SCAN_KEYS_PER_PART keys, as a table smaller than 2^k buckets
+ * would have parts scanning the same buckets. A SCAN crossing the end of its
+ * part may return a few keys of the next one, that are then seen twice:
+ * fine for statistics.
+ *
+ * For every batch of keys returned by SCAN the type and the memory usage of
+ * the keys are pipelined, then the length with the command of the type.
+ * Every key is handed to scan.keyproc and forgotten, so memory does not
+ * grow with the keyspace.
+ *
+ * With "budget" set a separate connection pings the server every 100 ms.
+ * When the ping takes longer than the budget the connections pause between
+ * batches, doubling the pause as long as the latency is over budget, and
+ * halving it when it is back below half the budget. */
+#define SCAN_KEYS_PER_PART 16
+#define KEY_STRING 0
+#define KEY_LIST 1
+#define KEY_SET 2
+#define KEY_ZSET 3
+#define KEY_HASH 4
+#define KEY_STREAM 5
+#define KEY_OTHER 6
+#define KEY_TYPES 7
+static char *keyTypeName[KEY_TYPES] = {
+    "string", "list", "set", "zset", "hash", "stream", "other"
+};
+static char *keyTypeLenCommand[KEY_TYPES] = {
+    "STRLEN", "LLEN", "SCARD", "ZCARD", "HLEN", "XLEN", NULL
+};
+
+typedef struct scanKey {
+    struct scanWorker *worker;
+    char *name;             /* points into the SCAN reply */
+    size_t namelen;
+    int type;               /* KEY_* or -1 if the key is gone */
+    long long len;          /* elements, or bytes for strings */
+    long long mem;          /* MEMORY USAGE, -1 if not available */
+} scanKey;
+
+typedef struct scanWorker {
+    redisAsyncContext *context;
+    unsigned long long cursor;
+    unsigned long long partmask, partbits; /* cursors of this part */
+    redisReply *reply;      /* SCAN reply of the current batch */
+    scanKey *keys;
+    int numkeys, maxkeys;
+    int pending;            /* replies missing to complete the batch */
+    int last;               /* the current batch is the last one */
+} scanWorker;
+
+typedef void scanKeyProc(scanKey *k);
+typedef void scanReportProc(int final);
+
+static struct scanState {
+    scanWorker *workers;
+    int numworkers, running;
+    scanKeyProc *keyproc;
+    scanReportProc *reportproc;
+    long long start;
+    long long keys;         /* keys seen so far */
+    long long pause;        /* ms between batches, set by the throttle */
+    redisAsyncContext *probe;
+    long long probesent;    /* when the pending PING was sent, 0 if none */
+    long long latency;      /* of the last PING, in microseconds */
+    long long maxlatency;
+} scan;
+
+static void scanNext(scanWorker *w);
+
+static void scanDisconnected(const redisAsyncContext *context, int status) {
+    if (status != REDIS_OK) {
+        fprintf(stderr, "Error: %s\n", context->errstr);
+        exit(1);
+    }
+}
+
+static redisAsyncContext *scanConnect(void) {
+    redisAsyncContext *ac = redisAsyncConnect(config.hostip,config.hostport);
+
+    if (ac->err) {
+        fprintf(stderr, "Error connecting to Redis: %s\n", ac->errstr);
+        exit(1);
+    }
+    redisAsyncSetDisconnectCallback(ac,scanDisconnected);
+    redisAeAttach(config.el,ac);
+    return ac;
+}
+
+static int scanResume(struct aeEventLoop *el, long long id, void *privdata) {
+    REDIS_NOTUSED(el); REDIS_NOTUSED(id);
+
+    scanNext(privdata);
+    return AE_NOMORE;
+}
+
+static void scanBatchDone(scanWorker *w) {
+    int j;
+
+    for (j = 0; j < w->numkeys; j++)
+        if (w->keys[j].type != -1) scan.keyproc(w->keys+j);
+    scan.keys += w->numkeys;
+    freeReplyObject(w->reply);
+    w->reply = NULL;
+
+    if (w->last) {
+        if (--scan.running == 0) aeStop(config.el);
+    } else if (scan.pause) {
+        aeCreateTimeEvent(config.el,scan.pause,scanResume,w,NULL);
     } else {
-        printf("Expected string reply... exiting.\n");
+        scanNext(w);
+    }
+}
+
+static void scanLenReply(redisAsyncContext *context, void *r, void *privdata) {
+    redisReply *reply = r;
+    scanKey *k = privdata;
+    REDIS_NOTUSED(context);
+
+    if (reply && reply->type == REDIS_REPLY_INTEGER) k->len = reply->integer;
+    if (reply) freeReplyObject(reply);
+    if (--k->worker->pending == 0) scanBatchDone(k->worker);
+}
+
+static void scanTypeReply(redisAsyncContext *context, void *r, void *privdata) {
+    redisReply *reply = r;
+    scanKey *k = privdata;
+    int j;
+
+    if (reply && reply->type == REDIS_REPLY_STATUS) {
+        k->type = KEY_OTHER;
+        for (j = 0; j < KEY_TYPES; j++)
+            if (!strcmp(reply->str,keyTypeName[j])) k->type = j;
+        if (!strcmp(reply->str,"none")) k->type = -1;
+    }
+    if (reply) freeReplyObject(reply);
+    if (k->type != -1 && keyTypeLenCommand[k->type]) {
+        k->worker->pending++;
+        redisAsyncCommand(context,scanLenReply,k,"%s %b",
+            keyTypeLenCommand[k->type],k->name,k->namelen);
+    }
+    if (--k->worker->pending == 0) scanBatchDone(k->worker);
+}
+
+static void scanMemReply(redisAsyncContext *context, void *r, void *privdata) {
+    redisReply *reply = r;
+    scanKey *k = privdata;
+    REDIS_NOTUSED(context);
+
+    if (reply && reply->type == REDIS_REPLY_INTEGER) k->mem = reply->integer;
+    if (reply) freeReplyObject(reply);
+    if (--k->worker->pending == 0) scanBatchDone(k->worker);
+}
+
+static void scanReply(redisAsyncContext *context, void *r, void *privdata) {
+    redisReply *reply = r, *keys;
+    scanWorker *w = privdata;
+    int j;
+
+    if (reply == NULL) return;
+    if (reply->type == REDIS_REPLY_ERROR) {
+        fprintf(stderr, "Error: %s\n", reply->str);
         exit(1);
     }
+    assert(reply->type == REDIS_REPLY_ARRAY && reply->elements == 2);
+    w->cursor = strtoull(reply->element[0]->str,NULL,10);
+    w->last = w->cursor == 0 || (w->cursor & w->partmask) != w->partbits;
+    w->reply = reply;
+
+    keys = reply->element[1];
+    if (keys->elements > (size_t)w->maxkeys) {
+        w->maxkeys = keys->elements;
+        w->keys = zrealloc(w->keys,sizeof(scanKey)*w->maxkeys);
+    }
+    w->numkeys = keys->elements;
+    w->pending = 1;
+    for (j = 0; j < w->numkeys; j++) {
+        scanKey *k = w->keys+j;
+
+        k->worker = w;
+        k->name = keys->element[j]->str;
+        k->namelen = keys->element[j]->len;
+        k->type = -1;
+        k->len = 0;
+        k->mem = -1;
+        w->pending += 2;
+        redisAsyncCommand(context,scanTypeReply,k,"TYPE %b",
+            k->name,k->namelen);
+        redisAsyncCommand(context,scanMemReply,k,"MEMORY USAGE %b",
+            k->name,k->namelen);
+    }
+    if (--w->pending == 0) scanBatchDone(w);
+}
+
+static void scanNext(scanWorker *w) {
+    redisAsyncCommand(w->context,scanReply,w,"SCAN %llu COUNT %d",
+        w->cursor,config.scancount);
+}
+
+static void scanProbeReply(redisAsyncContext *context, void *r, void *privdata) {
+    REDIS_NOTUSED(context); REDIS_NOTUSED(privdata);
+
+    if (r) freeReplyObject(r);
+    scan.latency = microseconds()-scan.probesent;
+    if (scan.latency > scan.maxlatency) scan.maxlatency = scan.latency;
+    scan.probesent = 0;
+}
+
+static int scanCron(struct aeEventLoop *el, long long id, void *privdata) {
+    static long long lastreport = 0;
+    long long now = microseconds(), latency;
+    REDIS_NOTUSED(el); REDIS_NOTUSED(id); REDIS_NOTUSED(privdata);
+
+    if (config.budget) {
+        /* A PING still pending is at least as slow as it is old. */
+        latency = scan.probesent ? now-scan.probesent : scan.latency;
+        if (latency > (long long)config.budget*1000) {
+            scan.pause = scan.pause ? scan.pause*2 : 1;
+            if (scan.pause > 1000) scan.pause = 1000;
+        } else if (latency < (long long)config.budget*500) {
+            scan.pause /= 2;
+        }
+        if (scan.probesent == 0) {
+            scan.probesent = now;
+            redisAsyncCommand(scan.probe,scanProbeReply,NULL,"PING");
+        }
+    }
+    if (now-lastreport >= 1000000) {
+        if (lastreport) scan.reportproc(0);
+        lastreport = now;
+    }
+    return 100;
+}
+
+/* Print a progress line for the reports of the stats using the scan. */
+static void scanProgress(void) {
+    double elapsed = (double)(microseconds()-scan.start)/1000000;
+
+    printf("%lld keys scanned in %.0f s (%.0f keys/s), %d of %d parts left",
+        scan.keys, elapsed, elapsed > 0 ? scan.keys/elapsed : 0,
+        scan.running, scan.numworkers);
+    if (config.budget)
+        printf(", latency %.1f ms, pause %lld ms",
+            (double)scan.latency/1000, scan.pause);
+    printf("\n");
+}
+
+static unsigned long long reverseBits(unsigned long long v, int bits) {
+    unsigned long long r = 0;
+    int j;
+
+    for (j = 0; j < bits; j++) {
+        r = (r << 1) | (v & 1);
+        v >>= 1;
+    }
+    return r;
+}
+
+/* True if the SCAN cursor has the layout of a standalone Redis, so that it
+ * can be split in parts. */
+static int scanCanSplit(void) {
+    redisReply *reply = reconnectingCommand("INFO");
+    int split = 0;
+
+    if (reply->type == REDIS_REPLY_STRING) {
+        infoParse(config.info,reply->str,reply->len);
+        split = infoGet(config.info,"redis_version") != NULL &&
+                infoGetLong(config.info,"cluster_enabled") != 1;
+    }
     freeReplyObject(reply);
-    return sl;
+    return split;
 }
 
-#define SAMPLE_SERIALIZEDLEN 0
-#define SAMPLE_TYPE 1
-#define SAMPLE_REFCOUNT 2
-#if 0
-static size_t *sampleDataset(int fd, int type) {
-    redisReply *r;
-    size_t *samples = zmalloc(config.samplesize*sizeof(size_t));
-    size_t totsl = 0, deltasum, avg;
+static void scanKeyspace(scanKeyProc *keyproc, scanReportProc *reportproc) {
+    redisReply *reply;
+    long long dbsize;
+    int bits = 0, j;
+
+    reply = reconnectingCommand("DBSIZE");
+    dbsize = reply->type == REDIS_REPLY_INTEGER ? reply->integer : 0;
+    freeReplyObject(reply);
+    if (dbsize == 0) {
+        printf("Sorry but DB 0 is empty\n");
+        exit(1);
+    }
+    if (config.connections > 1 && scanCanSplit()) {
+        while ((2LL << bits) <= config.connections &&
+               (2LL << bits)*SCAN_KEYS_PER_PART <= dbsize) bits++;
+    }
+
+    config.el = aeCreateEventLoop();
+    scan.keyproc = keyproc;
+    scan.reportproc = reportproc;
+    scan.numworkers = scan.running = 1 << bits;
+    scan.workers = zmalloc(sizeof(scanWorker)*scan.numworkers);
+    scan.start = microseconds();
+    scan.keys = scan.pause = scan.latency = scan.maxlatency = 0;
+    scan.probesent = 0;
+    printf("Scanning %lld keys of DB 0 with %d connections...\n",
+        dbsize, scan.numworkers);
+    for (j = 0; j < scan.numworkers; j++) {
+        scanWorker *w = scan.workers+j;
+
+        w->context = scanConnect();
+        w->partmask = scan.numworkers-1;
+        w->partbits = w->cursor = reverseBits(j,bits);
+        w->reply = NULL;
+        w->keys = NULL;
+        w->numkeys = w->maxkeys = 0;
+        scanNext(w);
+    }
+    if (config.budget) scan.probe = scanConnect();
+    aeCreateTimeEvent(config.el,100,scanCron,NULL,NULL);
+    aeMain(config.el);
+    scan.reportproc(1);
+}
+
+/* The "analyze" stat: percentage of types, average and maximum length and
+ * memory per type. */
+static struct typeStats {
+    long long keys;
+    long long len, maxlen;
+    long long mem, maxmem, memkeys; /* memkeys: keys with MEMORY USAGE */
+} typeStats[KEY_TYPES];
+
+static void analyzeKey(scanKey *k) {
+    struct typeStats *ts = typeStats+k->type;
+
+    ts->keys++;
+    ts->len += k->len;
+    if (k->len > ts->maxlen) ts->maxlen = k->len;
+    if (k->mem != -1) {
+        ts->memkeys++;
+        ts->mem += k->mem;
+        if (k->mem > ts->maxmem) ts->maxmem = k->mem;
+    }
+}
+
+static void analyzeReport(int final) {
+    struct typeStats tot;
+    char mem[64], maxmem[64], totmem[64];
     int j;
 
-    printf("Sampling %d random keys from DB 0...\n", config.samplesize);
-    for (j = 0; j < config.samplesize; j++) {
-        size_t sl = 0;
+    scanProgress();
+    if (!final) return;
 
-        /* Select a RANDOM key */
-        r = redisCommand(fd,"RANDOMKEY");
-        if (r->type == REDIS_REPLY_NIL) {
-            printf("Sorry but DB 0 is empty\n");
-            exit(1);
-        } else if (r->type == REDIS_REPLY_ERROR) {
-            printf("Error: %s\n", r->reply);
-            exit(1);
+    memset(&tot,0,sizeof(tot));
+    for (j = 0; j < KEY_TYPES; j++) {
+        tot.keys += typeStats[j].keys;
+        tot.mem += typeStats[j].mem;
+        tot.memkeys += typeStats[j].memkeys;
+    }
+    printf("\n%-8s %12s %7s %12s %12s %10s %10s %10s\n", "type", "keys", "%",
+        "avg len", "max len", "avg mem", "max mem", "total mem");
+    for (j = 0; j < KEY_TYPES; j++) {
+        struct typeStats *ts = typeStats+j;
+
+        if (ts->keys == 0) continue;
+        strcpy(mem,"-"); strcpy(maxmem,"-"); strcpy(totmem,"-");
+        if (ts->memkeys) {
+            bytesToHuman(mem,ts->mem/ts->memkeys);
+            bytesToHuman(maxmem,ts->maxmem);
+            bytesToHuman(totmem,ts->mem);
         }
-        /* Store the lenght of this object in our sampling vector */
-        if (type == SAMPLE_SERIALIZEDLEN) {
-            sl = getSerializedLen(fd, r->reply);
-            freeReplyObject(r);
+        printf("%-8s %12lld %6.2f%% %12.1f %12lld %10s %10s %10s\n",
+            keyTypeName[j], ts->keys, (double)ts->keys*100/tot.keys,
+            (double)ts->len/ts->keys, ts->maxlen, mem, maxmem, totmem);
+    }
+    if (tot.memkeys) {
+        bytesToHuman(mem,tot.mem/tot.memkeys);
+        bytesToHuman(totmem,tot.mem);
+        printf("\nAverage bytes per key: %s, total: %s\n", mem, totmem);
+    }
+    if (config.budget)
+        printf("Max PING latency during the scan: %.1f ms\n",
+            (double)scan.maxlatency/1000);
+}
 
-            if (sl == 0) {
-                /* Problem getting the  length of this object, don't count
-                 * this try. */
-                j--;
-                continue;
-            }
+static void analyze(void) {
+    memset(typeStats,0,sizeof(typeStats));
+    scanKeyspace(analyzeKey,analyzeReport);
+}
+
+/* The "bigkeys" stat: the largest keys by memory and by length, and the
+ * memory used by every key prefix, printed as the scan goes on.
+ *
+ * The largest keys are kept in two min-heaps of "top" entries, so a key only
+ * costs a comparison with the smallest of the current top unless it enters.
+ *
+ * Prefixes are the components of the key names split at "delimiter", all
+ * but the last one, in a trie whose nodes count the keys and memory of their
+ * whole branch. The trie is bounded to "prefixnodes" nodes: when it is full
+ * the nodes using less memory are dropped, children first, down to half the
+ * budget. The counters of a parent always include what was dropped below
+ * it, but a dropped branch that comes back only counts the keys seen after
+ * it was dropped: heavy prefixes are never dropped, so their numbers are
+ * exact, while the small ones are approximate. */
+#define BIGKEYS_REPORT_PERIOD 10 /* seconds between interim reports */
+
+typedef struct bigKey {
+    char *name;
+    size_t namelen;
+    int type;
+    long long value;        /* memory or length, what the heap is sorted by */
+    long long len, mem;
+} bigKey;
+
+typedef struct bigKeyHeap {
+    bigKey *keys;           /* keys[0] is the smallest */
+    int numkeys;
+} bigKeyHeap;
+
+typedef struct prefixNode {
+    struct prefixNode *parent;
+    struct prefixNode *hnext; /* next node in the same hash bucket */
+    char *name;             /* the component, not the whole prefix */
+    size_t namelen;
+    unsigned int hash;
+    long long keys, mem;
+    int depth;
+} prefixNode;
+
+static struct bigKeysState {
+    bigKeyHeap bymem, bylen;
+    prefixNode root;
+    prefixNode **nodes;     /* all the nodes but the root */
+    int numnodes, maxnodes;
+    prefixNode **table;     /* by (parent, name) */
+    unsigned int tablesize;
+    long long dropped;      /* nodes dropped so far */
+    int reports;
+} bigkeys;
+
+static int bigKeyCompare(const void *a, const void *b) {
+    const bigKey *ka = a, *kb = b;
+
+    return (ka->value < kb->value) ? 1 : (ka->value > kb->value ? -1 : 0);
+}
+
+static void heapSiftDown(bigKeyHeap *h, int j) {
+    while (1) {
+        int l = j*2+1, r = l+1, min = j;
+        bigKey tmp;
+
+        if (l < h->numkeys && h->keys[l].value < h->keys[min].value) min = l;
+        if (r < h->numkeys && h->keys[r].value < h->keys[min].value) min = r;
+        if (min == j) break;
+        tmp = h->keys[j]; h->keys[j] = h->keys[min]; h->keys[min] = tmp;
+        j = min;
+    }
+}
+
+static void heapSiftUp(bigKeyHeap *h, int j) {
+    while (j > 0 && h->keys[(j-1)/2].value > h->keys[j].value) {
+        bigKey tmp = h->keys[j];
+
+        h->keys[j] = h->keys[(j-1)/2];
+        h->keys[(j-1)/2] = tmp;
+        j = (j-1)/2;
+    }
+}
+
+static void heapAdd(bigKeyHeap *h, scanKey *k, long long value) {
+    int full = h->numkeys == config.top, j;
+    bigKey *bk;
+
+    if (full && value <= h->keys[0].value) return;
+
+    /* A key returned twice by SCANs crossing their part is listed once. */
+    for (j = 0; j < h->numkeys; j++) {
+        if (h->keys[j].namelen == k->namelen &&
+            !memcmp(h->keys[j].name,k->name,k->namelen)) return;
+    }
+    if (full) {
+        /* Replace the smallest key, as this one is larger. */
+        bk = h->keys;
+        zfree(bk->name);
+    } else {
+        bk = h->keys+h->numkeys++;
+    }
+    bk->name = zmalloc(k->namelen);
+    memcpy(bk->name,k->name,k->namelen);
+    bk->namelen = k->namelen;
+    bk->type = k->type;
+    bk->value = value;
+    bk->len = k->len;
+    bk->mem = k->mem;
+    if (full) heapSiftDown(h,0);
+    else heapSiftUp(h,h->numkeys-1);
+}
+
+static unsigned int prefixHash(prefixNode *parent, const char *s, size_t len) {
+    unsigned int hash = 5381 ^ (unsigned int)(size_t)parent;
+
+    while (len--) hash = ((hash << 5) + hash) + (unsigned char)*s++;
+    return hash;
+}
+
+static prefixNode *prefixChild(prefixNode *parent, const char *s, size_t len) {
+    unsigned int hash = prefixHash(parent,s,len);
+    prefixNode *n = bigkeys.table[hash & (bigkeys.tablesize-1)];
+
+    for (; n; n = n->hnext)
+        if (n->hash == hash && n->parent == parent && n->namelen == len &&
+            !memcmp(n->name,s,len)) return n;
+
+    n = zmalloc(sizeof(*n));
+    n->parent = parent;
+    n->name = zmalloc(len);
+    memcpy(n->name,s,len);
+    n->namelen = len;
+    n->hash = hash;
+    n->keys = n->mem = 0;
+    n->depth = parent->depth+1;
+    n->hnext = bigkeys.table[hash & (bigkeys.tablesize-1)];
+    bigkeys.table[hash & (bigkeys.tablesize-1)] = n;
+    if (bigkeys.numnodes == bigkeys.maxnodes) {
+        bigkeys.maxnodes *= 2;
+        bigkeys.nodes = zrealloc(bigkeys.nodes,
+            sizeof(prefixNode*)*bigkeys.maxnodes);
+    }
+    bigkeys.nodes[bigkeys.numnodes++] = n;
+    return n;
+}
+
+static int prefixCompareMem(const void *a, const void *b) {
+    const prefixNode *na = *(prefixNode**)a, *nb = *(prefixNode**)b;
+
+    if (na->mem != nb->mem) return na->mem < nb->mem ? -1 : 1;
+    return nb->depth-na->depth; /* children first */
+}
+
+/* Drop the nodes using less memory until half the budget is left. */
+static void prefixPrune(void) {
+    int drop = bigkeys.numnodes-config.prefixnodes/2, j, k;
+    unsigned int h;
+
+    qsort(bigkeys.nodes,bigkeys.numnodes,sizeof(prefixNode*),
+        prefixCompareMem);
+    /* As the memory of a node is at least the one of its children, and
+     * children sort first on ties, the first "drop" nodes are whole
+     * branches. Mark them, unlink them from the table, then free them. */
+    for (j = 0; j < drop; j++) bigkeys.nodes[j]->keys = -1;
+    for (h = 0; h < bigkeys.tablesize; h++) {
+        prefixNode **p = bigkeys.table+h;
+
+        while (*p) {
+            if ((*p)->keys == -1) *p = (*p)->hnext;
+            else p = &(*p)->hnext;
         }
+    }
+    for (j = 0; j < drop; j++) {
+        zfree(bigkeys.nodes[j]->name);
+        zfree(bigkeys.nodes[j]);
+    }
+    for (j = drop, k = 0; j < bigkeys.numnodes; j++)
+        bigkeys.nodes[k++] = bigkeys.nodes[j];
+    bigkeys.numnodes = k;
+    bigkeys.dropped += drop;
+}
 
-        samples[j] = sl;
-        totsl += sl;
+static void bigKeysKey(scanKey *k) {
+    prefixNode *n = &bigkeys.root;
+    const char *p = k->name, *end = k->name+k->namelen, *delim;
+    long long mem = k->mem == -1 ? 0 : k->mem;
+
+    if (k->mem != -1) heapAdd(&bigkeys.bymem,k,k->mem);
+    heapAdd(&bigkeys.bylen,k,k->len);
+
+    /* Prune before the walk, so that the nodes of the walk stay around. A
+     * key can take the trie a few nodes over the budget, no more. */
+    if (bigkeys.numnodes >= config.prefixnodes) prefixPrune();
+    n->keys++;
+    n->mem += mem;
+    while ((delim = memchr(p,config.delimiter,end-p)) != NULL) {
+        n = prefixChild(n,p,delim-p+1);
+        n->keys++;
+        n->mem += mem;
+        p = delim+1;
     }
-    printf("  Average: %zu\n", totsl/config.samplesize);
+}
+
+static void printPrefix(prefixNode *n) {
+    if (n->parent == NULL) return;
+    printPrefix(n->parent);
+    fwrite(n->name,n->namelen,1,stdout);
+}
 
-    deltasum = 0, avg = totsl/config.samplesize;
-    for (j = 0; j < config.samplesize; j++) {
-        long delta = avg-samples[j];
+static void printBigKeys(bigKeyHeap *h, char *what) {
+    bigKey *sorted = zmalloc(sizeof(bigKey)*(h->numkeys ? h->numkeys : 1));
+    char mem[64];
+    int j;
 
-        deltasum += delta*delta;
+    memcpy(sorted,h->keys,sizeof(bigKey)*h->numkeys);
+    qsort(sorted,h->numkeys,sizeof(bigKey),bigKeyCompare);
+    printf("Largest keys by %s:\n", what);
+    for (j = 0; j < h->numkeys; j++) {
+        if (sorted[j].mem == -1) strcpy(mem,"-");
+        else bytesToHuman(mem,sorted[j].mem);
+        printf("  %10s %12lld %-7s ", mem, sorted[j].len,
+            keyTypeName[sorted[j].type]);
+        fwrite(sorted[j].name,sorted[j].namelen,1,stdout);
+        printf("\n");
     }
-    printf("  Standard deviation: %.2lf\n\n",
-        sqrt(deltasum/config.samplesize));
-    return samples;
+    zfree(sorted);
 }
-#else
-static size_t *sampleDataset(redisContext *c, int type) {
-REDIS_NOTUSED(c); REDIS_NOTUSED(type);
-static size_t samples[10000] = {35,2,2,11,8,2,2,2,264,13,62,7,324,91,62,312,8,6,3,7,7,2,3,20,64,107,272,2,91,272,8,2,62,77,7,10,100,53,24,272,44,6,2,11,24,7,5,34,62,7,62,7,48,47,7,24,24,8,15,111,5,7,268,24,320,16,21,1,11,6,24,7,2,195,7,6,24,2,2,2,4,15,29,62,24,62,195,2,2,6,62,7,5,5,138,8,97,64,24,20,7,2,24,11,8,7,2,2,2,64,91,2,3,89,2,20,2,2,6,7,324,14,5,1,7,47,103,113,13,7,24,2,3,62,90,272,2,264,7,7,8,2,62,264,20,2,11,8,62,2,1,268,7,272,272,50,7,8,2,6,9,2,2,6,62,64,59,334,9,13,60,9,24,7,6,2,272,13,7,43,11,62,276,2,8,5,35,24,10,2,2,1,272,64,11,7,344,2,2,2,24,6,3,6,11,24,62,62,2,20,20,12,272,24,2,2,272,2,58,3,24,1,2,2,45,8,51,272,2,11,320,3,59,8,62,64,24,13,7,344,20,60,24,11,6,25,5,14,276,62,5,24,62,7,7,92,24,24,6,24,2,24,64,24,85,7,2,85,12,83,7,24,19,272,2,191,10,7,272,87,20,60,6,47,24,20,2,2,6,58,24,8,264,64,2,276,352,7,64,344,2,195,67,24,5,2,2,24,24,6,24,9,62,91,22,11,62,8,62,62,24,24,132,62,24,24,276,272,20,12,2,11,62,13,115,3,2,24,24,13,59,11,2,22,58,7,7,13,24,47,8,8,64,2,272,24,62,7,47,195,2,24,2,51,20,62,2,11,7,2,24,3,2,62,2,6,12,344,11,191,6,64,24,6,60,8,2,13,9,2,244,2,62,64,11,58,20,9,11,13,24,191,5,100,6,9,2,61,89,2,24,62,7,56,2,142,2,87,113,2,320,64,2,191,6,2,248,20,64,62,2,11,9,383,7,62,24,4,106,8,59,9,6,13,8,24,7,6,24,5,3,2,64,272,2,6,1,62,272,5,2,45,7,9,8,64,87,80,24,6,62,7,2,6,6,62,11,29,24,8,62,49,7,24,64,24,64,2,22,56,25,3,61,2,62,71,2,13,7,58,356,2,60,7,50,7,58,2,11,60,64,62,5,34,7,24,62,2,7,102,2,2,2,6,5,2,62,264,2,90,5,2,2,35,191,64,62,20,20,2,8,91,7,105,476,272,272,16,64,1,2,55,11,24,1,7,205,86,46,260,62,24,8,61,2,64,97,59,6,2,63,60,62,96,47,24,24,58,94,5,20,24,62,9,49,11,272,64,24,5,20,7,24,276,2,272,6,2,3,24,272,107,92,11,56,11,62,11,15,5,6,6,272,6,14764,20,272,24,9,27,31,5,7,2,8,62,195,59,6,62,24,7,6,8,3,2,195,2,7,2,62,64,5,2,64,64,8,64,2,64,2,20,24,2,2,2,47,59,195,24,62,87,7,395,24,6,272,2,13,344,64,24,276,195,4,195,50,191,19,2,6,64,7,2,2,24,7,272,66,24,61,23,11,11,7,2,5,2,50,58,5,64,11,59,8,62,48,276,2,2,320,6,92,43,20,11,2,24,24,20,60,272,260,3,195,5,31,264,2,2,2,13,24,62,276,260,11,2,8,2,52,2,10,332,6,14,19,3,62,37,24,14,4,2,12,9,24,62,5,44,24,2,8,20,272,44,24,58,14,24,51,51,59,63,60,8,2,24,89,49,2,9,7,4902,24,61,6,268,24,2,2,6,24,2,6,24,2,6,32,13,2,11,2,320,91,6,2,64,9,6,11,5,2,268,6,89,1,272,89,191,272,59,7,7,7,24,4,2,7,7,24,11,2,6,61,328,2,11,61,3,13,272,2,46,62,24,2,13,9,64,24,59,6,14,24,11,8,89,2,2,2,49,62,6,191,92,3,3,24,62,268,102,24,13,62,13,106,14,2,2,9,272,24,1,62,6,7,13,60,89,2,2,6,51,11,16,24,64,24,99,13,2,24,9,11,6,89,7,89,56,7,7,20,340,24,58,21,2,11,324,13,2,11,5,2,93,2,264,87,11,59,24,91,64,2,6,20,2,64,2,272,191,60,2,115,2,2,48,98,6,6,272,2,11,276,272,11,7,2,272,5,11,2,24,91,61,6,60,7,2,6,62,7,272,2,5,8,62,11,8,2,10,6,2,2,24,24,2,6,62,24,24,6,24,2,87,23,9,62,24,11,49,20,7,8,24,6,4,89,5,23,2,272,24,52,191,9,2,11,58,2,14,9,11,2,11,24,62,6,272,2,2,2,11,2,2,29,10,60,7,9,24,24,24,70,20,26,344,2,2,9,272,64,10,5,24,13,5,2,9,62,6,23,64,8,58,2,2,2,14,195,64,3,94,2,9,3,58,11,89,56,6,11,11,24,8,272,24,6,13,5,24,24,7,16,6,11,191,2,2,191,58,268,276,9,24,1,7,20,62,7,276,2,5,8,2,11,7,7,60,268,7,2,2,59,20,6,272,56,131,89,2,100,8,62,24,13,328,272,24,320,6,2,7,12,121,64,7,7,7,33,24,58,2,2,107,2,11,62,89,2,9,8,62,2,111,6,24,62,121,60,7,6,43,264,6,90,40,2,276,18,24,272,2,272,2,24,24,10,59,15,2,59,2,2,24,2,2,8,7,24,89,2,64,24,2,9,11,2,62,6,507,8,62,20,24,12,61,24,96,2,20,316,13,8,2,2,89,62,11,2,6,191,23,5,24,2,58,272,11,2,324,2,58,13,191,191,96,62,5,6,20,91,7,8,2,46,2,24,39,62,11,6,2,32,6,9,13,24,5,8,24,13,5,6,268,64,5,103,7,89,3,5,6,64,47,2,21,62,2,5,2,6,2,56,7,7,320,24,7,62,104,191,11,15,5,272,64,2,24,3,62,268,9,9,13,6,5,7,60,11,7,60,2,6,2,24,20,94,7,6,272,9,2,6,62,24,320,320,59,50,5,3,2,2,61,6,62,58,20,2,2,2,62,40,7,191,62,2,276,2,2,62,2,131,11,86,86,2,7,13,276,272,5,11,2,11,2,24,24,11,2,2,24,264,135,6,11,16,320,17,24,5,6,52,20,2,320,11,16,9,91,2,64,20,324,24,24,24,13,16,56,6,320,8,142,24,352,2,7,24,13,2,4,2,9,2,4,191,2,264,215,11,23,11,2,62,64,62,6,272,344,7,6,64,6,5,89,45,11,69,6,6,24,66,11,20,320,2,13,62,62,64,2,2,13,272,24,11,2,11,58,2,64,58,2,24,1,15,2,2,6,272,272,95,62,11,62,58,7,3,2,2,2,2,62,2,5,24,56,64,2,62,20,20,24,7,91,20,24,11,24,2,7,5,6,272,24,9,2,8,2,2,24,7,2,56,58,95,51,2,1,2,4,20,186,2,2,9,2,11,2,58,272,38,320,24,272,2,2,6,5,3,20,24,24,2,91,6,64,8,6,90,3,8,24,45,24,91,6,7,2,74,91,24,24,24,15,6,64,13,2,24,4,103,135,91,2,40,6,2,52,11,5,2,2,24,8,260,2,2,2,24,24,3,11,2,7,2,2,60,11,13,344,24,6,24,11,7,24,62,24,1,14,191,60,2,7,62,6,60,268,7,2,6,9,183,195,2,191,86,20,62,62,5,11,6,340,6,276,50,6,6,2,2,5,2,24,89,20,2,12,34,11,62,2,11,6,20,2,2007,11,9,324,23,2,11,324,2,6,24,62,59,24,7,109,272,67,5,103,276,34,2,28,47,11,64,268,48,15,4,5,24,1,9,2,66,87,9,11,20,3,9,11,11,11,2,24,7,272,2,101,6,2,61,11,24,5,8,4,11,8,59,68,85,104,24,7,7,62,4,24,48,24,2,2,272,2,5,20,93,13,2,58,348,6,7,62,8,60,272,9,6,2,2,139,20,16,44,11,62,3,6,64,5,90,24,2,328,8,14,13,2,24,7,320,11,8,62,11,244,24,89,3,11,13,24,3,24,276,62,2,62,5,4,272,1,59,96,64,2,7,24,20,13,45,6,6,24,13,63,8,60,268,24,5,11,7,2,191,2,11,2,2,13,15,24,2,24,6,253,13,2,7,44,3,64,50,4,20,89,11,19,62,2,2,58,2,276,272,9,264,6,59,2,50,2,46,6,2,86,3,29,56,14,67,20,2,11,49,2,24,49,87,260,24,97,7,6,62,2,272,6,348,4,11,2,13,2,59,11,17,48,264,91,24,11,24,62,2,24,13,11,11,64,2,62,3,7,2,2,7,2,7,7,94,20,35,2,11,8,14,18,2,8,2,62,2,24,62,6,89,11,20,24,2,2,11,5,14,2,11,11,2,11,48,6,13,1,2,24,31,187,2,61,91,24,11,46,6,20,2,2,328,2,8,46,7,11,110,8,24,2,6,59,51,60,320,6,2,24,2,34,32,53,5,59,2,7,44,24,207,8,2,9,62,2,11,4,21,11,24,8,11,4,8,24,11,20,7,9,91,5,62,195,8,8,24,61,45,88,111,24,5,2,2,2,2,3,7,59,6,59,2,7,195,3,89,6,2,59,35,11,191,112,25,272,95,2,6,98,2,2,87,316,6,64,7,89,24,24,195,5,62,220,4,320,13,8,104,43,20,9,59,8,2,9,11,2,2,13,58,2,272,89,20,104,111,8,6,191,2,2,2,1,9,2,18,2,62,2,2,2,203,20,5,11,62,24,11,6,47,24,60,60,187,2,260,62,59,20,7,60,5,3,8,2,24,2,107,58,4,24,272,6,11,9,64,89,60,9,2,2,58,20,20,195,24,49,3,2,11,24,20,13,142,91,118,11,264,89,2,7,24,61,7,60,7,47,11,43,62,24,2,12,24,24,67,2,64,24,272,24,6,2,89,272,61,5,2,60,2,7,2,13,11,62,2,62,24,24,276,12,49,95,44,20,48,28,2,3,2,60,89,7,9,1769,86,5,191,60,24,11,13,60,5,5,191,11,89,9,8,272,89,20,272,140,5,7,23,7,9,276,272,2,6,89,24,272,2,64,50,31,276,10,5,7,61,2,2,11,64,8,31,2,24,44,17,62,11,2,2,6,8,62,62,24,6,56,20,272,2,2,20,3,264,2,7,5,7,61,2,45,9,20,8,11,24,320,11,24,62,3,113,91,11,115,6,9,6,24,6,268,6,7,3,64,187,2,2,191,2,64,2,320,101,6,195,13,15,2,8,2,64,191,272,62,11,6,62,45,11,5,24,7,5,5,89,96,24,24,62,3,264,2,59,11,13,141,2,61,6,7,11,64,8,2,2,2,2,7,2,90,7,2,11,49,20,46,50,46,64,191,272,64,62,8,8,59,10,60,268,24,2,320,2,5,8,20,15,2,12,24,11,3,7,7,92,2,64,5,24,6,62,2,2,119,63,64,91,24,8,112,2,108,62,89,320,2,5,68,3,2,15,9,119,62,6,276,96,89,10,272,2,272,2,62,11,7,20,64,7,2,6,24,105,20,272,56,2,2,2,11,7,2,2,62,8,62,62,64,6,62,6,90,6,6,20,62,2,3,2,11,2,87,272,2,2,5,61,13,272,7,122,6,2,58,62,11,3,5,2,2,6,62,24,20,2,2,62,20,2,5,24,2,62,3,6,91,62,2,334,7,7,6,59,7,6,67,54,2,11,268,5,49,20,91,2,48,2,191,7,24,61,191,2,2,12,7,59,6,62,2,11,2,59,472,10,11,13,9,87,11,24,62,13,1,102,107,58,7,7,14,2,33,24,9,11,81,45,3,11,2,62,272,20,62,2,24,60,20,260,56,24,6,62,18,272,64,11,7,6,64,2,2,14,3,24,48,5,195,11,8,7,61,24,7,2,24,13,2,62,7,2,60,24,11,60,2,6,7,62,2,91,7,11,7,2,2,2,2,24,320,24,2,50,62,3,6,5,20,11,6,2,2,6,24,58,9,2,62,195,6,2,2,60,3,195,2,20,84,24,7,272,60,2,3,187,2,24,62,7,11,3,6,2,13,2,20,3,62,2,62,264,2,2,24,91,2,2,64,58,24,24,2,58,11,2,2,11,6,24,2,62,62,107,20,324,6,8,24,89,7,2,89,24,6,191,272,2,17,2,11,16,59,20,2,272,63,2,2,6,7,5,3,24,2,13,2,24,50,8,24,64,58,2,2,47,60,64,8,10,14,13,24,195,18,7,24,324,2,1,2,89,2,24,191,62,6,56,2,2,62,11,56,276,1143,62,91,7,2,7,2,272,24,62,13,2,139,6,7,11,268,2,62,24,49,89,2,264,2,2,20,7,60,11,62,67,24,24,23,5,24,24,148,2,5,6,24,85,8,272,105,5,64,276,13,64,62,2,5,3,85,15,50,49,5,2,11,24,2,104,24,24,59,6,272,4,2,344,11,6,312,2,5,87,11,87,8,86,1,94,24,272,7,17,5,11,264,8,122,13,2,20,272,62,24,1,2,24,61,2,24,5,264,63,2,58,13,11,3,67,59,13,8,24,2,58,344,2,209,2,20,64,60,19,47,6,142,2,7,99,24,8,332,2,2,13,2,2,195,8,20,6,107,6,11,20,40,2,8,5,7,68,2,13,9,88,2,13,6,4,11,11,5,66,5,205,3,6,8,2,11,58,13,2,93,24,60,8,2,27,6,62,6,24,40,52,6,62,320,24,320,11,2,11,24,7,24,191,5,2,24,59,2,2,338,59,20,2,24,191,53,10,61,24,5,62,6,1,24,2,89,2,62,24,6,62,272,24,87,62,8,195,2,20,20,50,8,2,2,6,7,11,2,24,8,66,17,2,59,2,2,3,2,2,11,60,19,328,62,13,2,2,6,90,2,191,344,7,60,62,20,334,25,26,24,2,83,268,7,59,2,46,8,24,20,6,2,60,2,17,62,2,60,23,191,61,39,62,2,272,11,272,60,6,3,2,195,2,89,8,24,320,24,32,8,2,11,59,89,13,11,13,320,88,62,272,137,11,272,91,7,8,84,2,320,8,4,58,11,6,24,62,93,6,2,13,58,11,272,2,80,20,63,360,316,62,59,2,8,11,24,6,134,5,24,6,2,64,24,272,5,569,7,89,7,2,13,71,24,191,62,7,87,2,8,24,60,62,11,14,88,24,272,5,24,2,81,24,2,13,62,87,8,64,7,7,7,38,7,2,179,24,8,260,272,6,191,13,8,2,24,91,9,69,58,185,7,89,195,24,5,6,89,64,2,2,4,6,6,16,24,2,61,11,6,5,6,5,11,46,7,24,6,60,21,62,11,272,58,88,272,62,24,7,191,24,15,62,59,20,88,2,7,91,12,24,62,24,7,95,3,320,6,272,62,7,312,6,2,91,64,7,2,272,58,11,6,62,11,7,9,2,116,62,12,11,3,56,64,11,7,2,191,6,20,328,476,8,31,24,3,3,59,60,191,20,9,6,8,7,98,7,15,58,195,2,272,56,2,24,11,86,20,320,2,9,24,62,17,9,2,2,89,24,2,11,13,8,5,24,5,195,15,24,13,8,11,272,7,24,11,7,2,62,7,5,272,2,24,2,11,24,6,2,20,139,7,5,2,24,6,6,2,7,2,276,86,14,264,2,2,85,35,8,12,2,7,2,14,24,272,62,7,2,19,24,1,2,24,64,272,97,5,9,109,20,106,27,11,7,18,98,24,9,272,24,62,2,62,8,62,20,40,24,53,2,8,11,7,15,91,6,58,2,24,2,2,6,320,24,24,20,24,2,6,24,5,2,6,14,13,2,24,7,2,6,91,8,320,272,7,11,49,2,3,187,24,241,268,24,2,2,348,48,142,24,62,8,24,64,56,62,3,11,2,187,24,13,13,62,11,2,24,7,7,320,7,2,2,7,6,59,8,2,59,5,62,2,91,6,2,324,7,52,24,344,7,11,10,272,2,320,569,6,33,47,7,45,11,11,476,7,20,46,24,12,6,7,13,2,13,6,62,2,25,11,7,7,2,62,2,77,272,10,62,5,11,2,62,11,191,11,24,2,22,6,272,20,138,87,5,53,59,11,2,11,2,62,89,5,62,338,2,62,10,63,71,16,4,77,11,13,20,11,48,24,2,191,2,6,13,56,128,11,2,58,99,867,12,11,13,5,2,11,2,11,2,11,8,20,11,20,69,5,96,187,2,49,60,5,20,45,7,13,195,11,6,187,13,60,11,6,62,91,2,2,9,24,7,24,24,272,272,272,11,8,89,8,320,11,62,6,24,320,62,24,320,59,6,5,64,24,2,30,8,2,8,272,11,62,2,14,191,91,2,24,66,66,11,2,109,6,264,3,62,58,11,2,2,6,7,21,77,24,52,9,1,2,46,2,100,103,6,6,11,59,17,7,272,7,48,5,2,24,52,7,11,102,8,15,2,268,11,24,122,11,195,7,24,2,8,7,7,2,2,62,64,272,11,20,6,2,21,31,89,11,91,2,340,62,53,24,6,62,62,46,24,75,312,8,2,2,134,11,94,21,13,6,6,8,91,24,2,6,11,88,24,24,264,24,10,62,62,24,6,11,11,24,10,276,324,7,89,24,24,89,2,10,83,63,3,58,24,62,187,104,320,11,2,191,272,60,2,24,187,6,24,2,13,7,7,272,2,62,20,195,7,7,264,272,2,64,62,3,24,2,20,58,60,9,24,2,24,195,2,264,2,4,62,272,5,6,244,24,11,5,6,86,24,6,6,7,187,20,89,24,328,2,7,7,6,24,48,24,62,24,11,11,338,11,8,7,11,2,59,2,61,2,2,2,62,11,11,260,62,13,20,5,89,62,5,2,108,47,20,15,62,11,100,24,2,24,2,9,7,2,6,62,5,2,1,268,94,8,89,48,195,2,8,62,2,2,2,24,24,320,2,24,324,7,29,2,6,34,7,328,62,24,58,61,62,191,272,5,9,62,20,13,24,24,9,2,20,62,24,64,7,7,64,46,2,272,89,2,40,6,51,101,2,7,11,11,7,64,62,7,11,24,59,62,191,58,58,62,8,5,6,11,24,100,2,24,2,8,187,356,34,97,4,11,89,2,191,8,62,5,89,93,244,9,13,64,20,7,34,11,7,195,64,6,46,2,24,2,13,2,34,2,260,4,91,4,2,10,60,62,62,17,48,24,2,63,24,69,24,7,332,2,95,272,6,6,7,7,5,2,14,64,62,7,3,91,84,268,2,2,24,11,195,11,60,8,2,13,8,8,13,59,13,24,2,2,320,62,2,2,2,127,126,91,11,11,142,59,7,61,4,24,272,191,24,344,144,11,2,11,56,2,7,272,320,20,5,13,21,332,24,44,7,264,6,195,24,2,6,62,64,2,332,2,18,74,2,24,2,61,2,2,40,20,332,2,62,9,12,2,260,4,15,24,29,8,60,24,5,4,268,6,6,2,11,23,272,8,2,13,7,2,11,5,272,6,276,195,272,2,2,8,24,7,272,2,58,272,187,2,6,2,62,6,24,24,2,24,62,4,11,272,320,6,62,7,13,24,62,272,86,6,191,2,348,49,2,9,11,6,9,24,90,59,2,6,24,64,244,2,7,48,20,328,2,2,6,6,24,2,3,2,20,7,6,62,90,24,137,20,268,62,62,6,24,264,344,8,268,56,2,23,24,2,62,19,336,2,2,2,16,5,11,2,24,24,9,8,2,8,2,8,52,5,48,64,23,64,46,6,244,320,2,2,2,24,24,60,60,76,11,20,320,7,7,7,62,62,2,191,272,2,59,2,20,64,11,8,59,5,2,9,2,5,86,63,8,2,2,34,3,101,107,2,18,24,11,64,5,2,2,7,2,9,272,2,7,8,24,49,59,11,100,11,2,56,58,16,13,2,12,6,2,24,268,316,195,64,10,24,24,11,91,100,7,328,11,61,11,2,24,11,13,24,11,20,3,2,24,2,2,62,8,80,13,2,24,91,24,58,89,9,24,264,191,11,6,2,64,9,37,87,103,59,11,13,11,2,11,20,191,58,11,6,5,7,64,7,13,24,62,2,49,7,62,62,320,9,91,24,24,2,17,320,24,11,3,9,195,11,24,62,24,13,64,2,5,52,2,6,6,6,45,62,6,2,7,88,272,62,195,58,24,272,6,40,58,8,20,11,62,58,44,7,7,24,2,5,59,5,2,24,58,62,2,4,56,24,24,4,11,89,24,9,11,9,332,7,60,59,272,24,332,60,8,24,320,6,11,24,264,28,11,9,20,24,24,6,11,2,11,52,56,8,2,3,24,56,2,64,1,2,50,2,24,24,91,24,64,191,2,6,89,264,7,12,24,2,324,111,12,20,59,62,17,62,44,56,10,12,20,7,5,86,2,5,11,195,64,13,15,48,5,3,2,334,6,352,2,62,2,20,60,58,2,75,7,57,13,64,191,11,2,43,24,219,18,92,383,13,18,62,272,2,11,64,11,62,2,91,5,272,64,264,11,2,17,51,268,11,2,2,5,24,2,27,9,2,272,8,58,276,51,96,9,2,106,7,24,5,8,24,7,12,11,3,56,20,24,5,7,2,20,11,2,8,64,11,62,272,8,20,3,320,62,24,96,62,24,46,191,6,11,62,7,320,20,191,85,18,7,5,4,10,61,62,56,24,8,7,24,320,49,10,73,20,8,8,62,336,56,83,58,118,62,2,11,11,7,24,16,11,13,27,5,2,7,8,11,2,11,6,11,2,2,2,6,7,5,2,260,320,2,8,22,21,5,62,16,64,2,5,13,7,2,9,8,7,45,44,62,332,8,11,24,6,5,268,7,2,2,7,7,24,62,7,13,67,109,18,13,58,2,11,8,6,8,59,12,2,268,103,24,6,24,24,2,17,59,11,85,6,6,86,2,11,7,2,11,2,7,24,7,2,7,24,2,3,11,7,5,24,91,3,7,7,64,2,1,2,5,62,5,13,5,268,2,187,2,157,24,2,324,20,11,2,24,2,80,260,2,8,16,3,64,68,87,2,2,64,60,29,11,11,24,10207,24,115,24,268,20,95,5,24,62,6,7,2,2,62,64,2,46,103,6,19,2,195,62,2,13,13,62,2,7,46,272,191,332,2,276,24,264,2,20,8,91,13,62,191,64,11,62,52,24,62,64,320,8,215,24,24,2,2,13,12,260,5,62,90,24,2,7,11,2,64,50,24,24,2,6,59,264,72,2,48,2,24,272,24,272,64,11,20,11,64,6,276,73,109,3,48,187,22,62,2,60,272,7,67,24,64,13,11,2,2,5,2,2,64,7,11,62,11,62,61,2,272,61,2,62,89,8,24,272,24,9,131,6,11,24,11,17,9,24,2,272,2,5,2,207,272,7,191,60,2,87,5,2,59,2,13,272,64,3,89,24,20,56,11,107,191,3,24,3,2,24,7,3,6,7,6,43,2,23,16,60,13,38,2,13,2,6,7,2,328,89,64,41,64,276,59,24,64,2,6,7,8,2,91,24,13,2,272,11,18,6,62,5,64,240,7,89,324,8,320,5,10,20,2,64,11,129,2,67,2,20,64,2,5,2,2,7,264,5,272,24,7,62,24,20,48,2,24,62,272,5,24,2,5,20,62,2,11,6,11,60,24,13,24,324,9,62,58,89,11,46,109,195,336,24,24,5,89,13,8,2,6,64,8,61,81,59,13,97,2,7,4,7,49,64,24,2,2,60,5,7,44,25,187,11,64,24,2,24,61,24,86,2,24,31,6,7,340,2,24,195,3,2,5,47,8,92,5,61,24,62,64,62,120,12,20,61,2,1,11,64,44,92,13,20,2,50,3,5,6,14,2,62,2,97,5,13,3,62,352,272,2,59,9,19,6,7,7,11,62,6,87,32,62,98,20,62,62,11,62,2,60,5,45,2,272,2,62,89,20,2,5,2,1,138,64,57,64,62,20,24,6,3,11,2,24,2,11,142,62,56,62,62,64,6,24,91,11,62,2,272,58,141,2,195,5,24,62,2,191,207,2,272,46,121,264,5,244,268,2,44,5,58,64,9,2,272,11,320,24,2,2,2,11,2,2,24,52,95,2,2,2,9,5,191,3,191,59,9,13,89,2,264,195,2,64,33,20,32,9,7,324,9,5,48,7,9,2,272,11,276,2,272,89,2,11,9,62,6,6,2,2,272,58,6,272,46,11,328,272,4,20,7,61,11,24,62,56,260,11,272,60,62,24,2,10,61,7,2,24,10,112,62,6,13,2,11,64,59,272,2,62,13,11,2,2,62,20,58,8,2,48,9,8,2,105,49,11,13,11,2,2,89,272,232,91,2,24,2,2,64,2,56,24,63,6,13,24,7,3,340,11,24,4,14,191,272,334,45,7,24,62,6,8,62,1,13,56,8,2,332,64,20,9,24,9,7,272,60,62,62,195,7,7,2,60,5,272,11,328,7,24,328,24,46,24,24,2,328,24,11,2,64,62,24,7,2,2,45,2,6,2,11,191,2,89,60,88,5,44,2,8,24,60,62,2,2,2,11,13,62,187,2,2,62,11,6,264,320,60,2,47,2,71,6,11,264,6,115,2,61,2,7,2,6,191,2,324,5,2,260,15,7,2,191,272,191,51,5,11,2,20,2,7,64,7,20,125,2,89,2,324,24,103,272,14,64,7,62,191,24,2,7,6,3,6,62,89,3,2,7,13,56,91,62,3,2,31,6,24,99,61,7,236,108,5,11,58,8,24,320,272,7,7,8,24,191,120,352,26,24,316,58,6,2,24,8,5,2,272,62,272,16,191,8,6,24,191,11,11,22,268,20,2,64,59,6,12,17,62,11,11,6,20,195,8,2,62,64,92,6,63,7,24,7,2,20,62,99,70,7,3,50,62,62,272,9,2,62,6,4,2,92,24,7,62,2,2,9,11,36,2,264,195,91,2,6,13,7,2,3,20,64,62,6,24,64,53,13,13,7,5,133,56,13,5,2,272,2,2,64,2,66,6,5,50,24,2,6,24,8,62,131,91,272,63,2,6,24,11,145,7,9,195,24,24,11,6,195,24,11,62,24,2,64,8,24,272,108,6,6,48,95,2,89,7,24,9,13,2,7,2,2,2,13,2,2,5,191,320,11,24,92,332,59,191,31,24,7,24,11,13,62,340,82,6,24,24,24,7,11,7,20,2,7,1,272,2,2,48,11,8,7,98,2,13,2,20,7,6,2,24,77,24,2,89,62,2,11,3,272,35,91,6,2,320,60,61,24,2,62,20,64,195,24,13,195,2,9,24,5,2,5,24,2,2,56,25,11,62,11,12,14,2,2,15,2,15,2,13,2,8,91,272,62,191,142,52,2,24,335,195,268,24,7,2,9,2,102,11,2,62,24,24,62,352,11,6,45,61,195,87,49,24,45,2,195,62,20,7,17,320,13,20,62,3,191,24,60,3,5,27,6,64,2,24,46,6,324,20,2,24,61,5,64,62,2,11,268,2,6,13,24,312,58,2,4,7,24,62,52,64,320,5,61,91,8,2,2,2,2,2,64,64,143,11,81,2,7,2,2,20,272,2,7,312,24,57,24,6,324,2,7,2,2,24,2,17,191,272,2,100,64,272,51,59,24,62,320,3,62,272,2,272,2,89,16,2,41,7,2,24,17,276,6,24,62,272,62,6,92,89,8,62,20,3,2,7,7,8,320,276,84,5,2,89,60,24,11,1,62,6,7,58,3,24,26,11,11,67,24,272,11,272,64,20,1,62,272,11,272,97,24,58,91,11,62,20,2,8,62,187,24,9,272,5,2,272,9,20,14,11,2,91,7,7,7,59,1,11,64,20,40,62,3,9,276,2,2,61,24,3,2,24,8,59,11,2,2,20,11,7,20,2,59,2,5,2,99,191,2,11,2,2,24,6,34,66,91,11,2,11,1,11,10,24,24,2,268,13,195,2,99,2,7,191,8,62,2,2,2,9,59,62,272,63,24,8,5,2,2,62,8,2,8,24,7,62,11,8,91,5,272,7,2,2,11,272,114,11,8,24,15,2,5,64,6,272,11,24,2,4,2,20,8,6,6,8,272,64,40,3,6,46,59,54,30,2,272,8,6,13,98,5,11,57,6,12,11,276,37,6,6,2,13,90,11,2,9,11,328,62,62,26,2,22,6,11,62,272,7,1,2,24,58,24,40,61,20,6,10,5,2,62,11,62,272,2,3,260,13,2,85,29,16,142,64,62,7,24,7,4,2,11,24,8,112,2,268,2,20,2,9,191,11,24,9,11,62,64,2,100,59,320,24,7,11,13,2,24,2,28,11,11,5,187,5,59,16,7,13,13,2,24,3,96,103,3,98,62,24,11,7,11,9,8,2,59,24,2,320,24,2,86,2,2,47,191,8,21,140,61,2,8,10,24,328,1,2,12,6,24,11,11,7,2,7,142,2,2,13,14,58,24,6,13,2,59,11,13,24,2,2,24,61,2,9,320,24,62,2,24,91,40,13,2,2,61,49,2,12,26,24,24,7,8,1,272,138,13,320,8,2,24,24,7,60,7,87,5,272,89,45,89,16,46,135,336,62,7,2,62,2,91,20,2,5,89,7,8,24,2,13,64,11,5,195,24,11,64,2,24,3,13,11,2,8,2,11,2,6,2,6,62,62,268,9,7,1,8,58,2,2,24,24,7,11,7,24,2,9,2,7,24,5,8,5,6,13,264,2,272,24,6,20,191,2,2,2,64,2,11,91,24,20,272,24,13,59,7,24,114,503,63,90,2,2,11,6,340,49,2,135,113,2,62,5,46,9,2,7,5,24,24,195,87,195,191,51,13,27,12,64,24,5,6,8,91,59,96,5,89,91,2,20,58,15,11,11,74,62,61,7,64,58,24,24,2,328,320,2,89,11,6,24,7,7,6,89,2,24,195,62,51,348,58,48,62,24,11,2,24,56,2,7,116,13,11,24,24,7,20,64,59,6,62,24,91,64,4,8,3,2,2,272,36,2,24,272,59,3,9,272,88,2,7,3,7,4,2,17,6,191,6,195,69,4,60,8,8,2,320,2,2,2,128,108,61,2,20,47,3,191,24,2,272,9,24,12,6,58,2,2,8,9,13,6,31,62,11,64,7,11,13,87,21,61,11,320,7,272,139,49,2,2,64,63,6,8,58,47,2,2,11,91,20,2,268,324,3,8,64,40,228,17,264,89,2,91,6,11,2,11,7,191,49,2,62,11,2,13,191,11,7,24,101,11,2,87,6,5,7,272,272,2,64,195,5,187,74,59,11,27,272,62,195,272,11,8,6,67,2,59,62,2,24,62,2,7,24,2,11,91,3,4,7,272,20,49,62,62,5,5,20,13,6,2,64,62,2,9,95,24,2,2,27,117,215,2,24,24,61,20,2,2,3,2,8,24,24,64,139,7,21,7,62,2,2,58,5,7,2,344,98,6,62,115,268,5,320,62,7,15,24,11,6,24,5,64,344,11,24,62,324,62,24,2,13,7,6,268,5,2,2,24,8,46,10,7,30,6,2,2,89,20,2,64,62,34,24,2,62,2,320,62,7,215,272,16,24,9,44,5,7,9,9,20,24,58,2,5,11,272,2,61,29,62,24,90,268,24,37,8,272,20,20,24,3,6,7,8,320,20,11,2,62,9,7,62,272,62,91,2,2,320,8,272,13,276,264,2,58,45,11,2,24,8,11,2,11,2,6,7,6,2,40,11,2,320,45,20,2,9,264,62,2,24,20,2,11,24,7,7,89,2,11,8,185,64,62,11,7,24,11,6,62,19,10,11,62,22,17,2,8,11,77,191,45,7,24,195,3,64,24,2,272,62,191,89,60,24,91,24,97,7,276,6,63,6,272,2,5,116,91,272,59,2,109,24,5,74,142,24,6,2,2,11,15,268,64,5,4,59,102,2,8,195,7,11,8,24,268,2,62,2,272,11,103,13,326,6,62,38,89,17,2,11,56,264,24,2,7,24,2,24,2,11,2,6,62,20,11,17,24,24,64,38,95,20,7,13,56,264,58,2,62,24,60,24,20,3,272,24,3,86,85,89,3,12,191,32,7,2,272,5,24,334,5,7,129,7,62,61,24,2,7,104,58,64,4,130,2,11,24,195,3,88,24,3,344,56,61,89,21,7,68,91,272,2,92,20,2,2,12,2,6,58,13,3,191,7,62,272,62,2,11,62,2,428,24,11,324,195,62,7,11,2,2,6,324,62,6,61,13,20,9,62,5,24,16,8,24,2,3,2,62,344,60,2,11,11,24,13,5,20,91,61,20,60,24,24,64,272,5,7,8,272,62,46,11,191,62,3,64,6,130,24,2,219,11,7,2,11,2,62,126,61,2,64,24,6,24,3,272,60,2,8,64,8,5,272,11,6,5,24,22,13,89,5,11,59,11,6,24,62,272,11,2,6,6,5,24,7,5,8,272,19,195,272,15,2,20,3,348,2,4,13,8,24,24,24,62,48,2,11,49,59,43,4,20,272,62,59,59,91,11,16,48,11,6,16,272,24,62,13,2,62,8,6,24,20,24,11,7,272,73,13,191,13,24,2,8,34,2,352,103,64,20,24,11,7,61,11,11,11,3,62,60,2,7,24,8,1,15,24,24,13,24,64,24,2,5,11,8,5,6,14,62,2,276,2,20,5,24,25,2,20,16,11,2,2,2,7,98,13,2,8,2,191,11,2,7,56,20,77,62,24,58,6,8,91,24,5,60,7,272,11,332,43,2,90,4,11,20,5,7,62,58,187,51,2,61,48,7,2,62,7,244,6,62,62,332,335,56,24,2,17,7,67,191,11,11,2,62,7,2,24,14,2,5,11,48,6,324,24,61,2,115,6,24,8,7,2,13,62,11,62,52,49,2,5,7,2,7,62,320,24,39,89,62,49,44,20,2,4,11,191,2,195,2,3,320,2,2,58,24,58,2,268,6,24,64,7,47,8,89,2,7,2,11,6,8,3,87,2,24,6,324,2,24,20,24,96,64,9,7,20,2,2,2,7,2,2,2,60,20,24,20,8,34,8,320,9,272,11,8,191,2,24,58,62,272,24,6,64,2,272,64,64,7,11,3,8,8,91,20,11,62,46,89,20,195,62,2,328,60,3,86,320,142,18,20,7,20,272,272,64,232,26,60,89,62,62,2,9,2,13,2,13,7,20,2,20,62,7,89,36,58,97,24,2,4,117,8,60,9,7,58,64,91,11,14,195,11,24,40,48,324,24,9,60,59,9,2,2,272,2,6,2,11,191,24,105,181,6,272,2,91,60,60,24,23,24,272,348,2,13,6,43,91,64,7,13,272,11,6,11,64,195,7,62,9,24,7,569,2,2,195,91,5,55,101,71,6,64,2,43,13,5,2,18,64,61,2,62,89,260,3,272,11,5,7,60,24,62,15,19,47,40,6,24,6,324,51,6,6,264,7,24,6,7,64,272,24,324,24,104,2,62,91,2,56,7,24,276,11,11,53,7,8,272,24,11,2,24,24,7,338,24,272,7,62,69,62,191,11,2,7,18,3,89,11,320,2,348,7,7,272,64,2,6,2,2,4,62,94,91,187,8,11,7,2,11,2,11,92,272,62,11,5,7,272,62,11,105,13,20,104,24,8,5,2,328,11,11,2,2,11,11,11,2,8,24,58,58,98,17,2,276,7,62,51,5,2,2,20,24,2,60,20,11,5,2,62,11,7,60,6,276,2,59,2,7,2,2,2,86,24,13,2,118,2,11,6,260,2,62,2,2,91,6,6,6,5,2,3,13,24,11,104,320,244,2,24,340,2,9,11,35,9,89,11,7,2,24,7,2,122,6,46,7,268,272,2,16,24,85,118,24,215,52,24,191,260,2,2,62,272,2,11,39,2,16,2,272,20,48,6,7,64,64,2,5,6,348,24,5,2,2,2,11,13,87,24,5,332,64,13,24,5,2,13,4,47,62,64,268,8,91,195,24,64,7,5,62,89,260,64,21,2,93,24,34,60,3,62,2,272,2,89,98,49,8,3,11,59,62,13,64,320,62,64,6,7,96,3,195,64,191,11,5,24,47,62,20,62,3,272,272,24,2,191,16,102,2,59,2,7,56,24,11,2,11,11,15,2,6,24,62,24,11,9,187,91,2,58,320,6,20,7,2,5,316,6,2,24,8,22,6,59,46,2,2,24,11,191,86,61,91,272,91,85,320,2,59,8,207,24,2,2,24,24,106,6,56,31,2,5,6,38,6,187,5,6,10,64,11,4,13,11,8,2,24,344,2,106,8,91,86,336,69,5,187,11,8,272,13,24,7,5,61,11,86,2,62,264,2,7,11,11,272,7,383,22,7,13,7,62,7,320,2,62,6,58,2,7,58,13,2,2,191,12,2,6,13,272,2,2,6,48,9,6,31,61,332,6,2,44,272,24,49,7,2,2,59,20,276,2,2,7,2,6,62,24,20,2,7,7,58,24,5,7,6,2,2,195,10,6,2,69,7,24,24,11,2,8,46,7,13,24,24,8,7,14,2,2,2,89,24,6,44,2,64,2,2,48,2,62,7,2,2,2,7,6,191,11,35,2,91,8,8,2,183,61,2,62,2,9,60,2,7,2,89,9,24,24,24,11,64,2,11,11,2,48,2,11,56,11,2,7,64,5,7,62,24,24,191,24,24,91,4,7,24,62,6,11,7,92,2,2,2,2,44,2,276,2,2,332,2,133,46,2,941,272,11,2,8,8,59,24,10,24,2,2,272,6,195,2,7,191,8,5,64,91,5,62,2,20,48,7,2,264,20,89,58,7,45,7,61,24,11,5,15,2,11,15,272,24,12,5,11,6,2,24,64,7,272,268,11,24,13,20,62,24,62,48,272,9,44,11,3,332,11,105,2,89,62,105,24,58,7,2,272,7,24,30,138,11,62,11,2,2,24,62,7,2,7,8,24,104,6,13,20,9,2,272,6,2,268,24,38,6,24,2,62,272,5,6,11,2,24,13,8,272,62,276,24,58,2,24,89,91,2,64,272,2,2,69,6,272,24,24,24,2,50,30,2,62,13,6,272,64,6,86,20,2,98,7,60,3,2,17,3,127,13,7,11,7,24,6,62,8,316,7,62,61,268,7,100,62,11,2,2,2,13,2,24,191,2,56,43,2,62,5,356,58,59,299,14,62,138,6,5,11,191,3,272,15,320,11,2,276,2,91,11,2,16,2,11,2,22,62,64,7,2,13,58,49,320,9,2,52,13,7,2,13,2,2,7,2,2,3,8,2,11,12,320,11,24,6,6,6,35,324,7,20,43,2,11,20,60,2,8,59,108,13,13,13,6,264,89,11,24,8,87,72,24,191,2,45,6,6,59,13,16,2,191,13,7,2,8,24,18,3,62,272,11,6,276,8,3,116,272,58,62,99,2,4,2,2,62,6,2,59,7,73,6,320,12,24,49,264,15,12,20,2,3,59,8,24,4,20,324,2,195,13,105,13,100,11,272,24,328,62,2,13,11,15,2,11,2,62,272,7,7,6,24,3,6,62,13,324,11,109,11,20,24,2,7,11,24,62,11,13,6,63,13,11,24,2,2,4,6,264,2,191,24,2,138,7,7,2,24,2,64,6,74,13,272,2,191,2,3,5,2,5,6,62,3,11,2,195,8,6,195,7,62,17,14,93,348,56,2,5,6,191,64,8,6,2,91,264,18,62,27,9,6,2,1,20,48,2,2,24,29,11,2,20,8,2,2,328,76,2,67,7,24,7,7,2,2,12,2,2,9,96,2,62,17,5,13,344,13,24,8,48,7,2,60,59,2,24,2,91,92,8,2,2,7,272,32,2,7,2,11,9,24,2,20,11,276,24,11,88,24,2,24,59,87,6,11,2,24,2,191,2,24,60,20,11,58,62,62,2,16,5,2,62,61,2,108,8,62,24,24,89,2,11,11,91,2,24,87,3,7,6,8,24,2,38,5,11,62,13,24,6,191,2,6,11,20,6,7,99,91,191,8,24,58,2,20,7,9,10,2,7,2,2,5,58,6,3,272,2,63,12,14,2,24,348,62,6,272,24,6,24,91,272,320,7,6,276,2,2,24,60,84,8,2,22,324,58,7,12,11,272,14,62,2,187,2,13,2,6,24,5,104,11,89,272,46,6,3,268,11,3,91,110,328,2,268,60,2,2,7,60,2,11,24,51,2,7,9,24,102,13,13,62,3,6,272,6,2,2,60,8,272,13,91,64,14,60,2,6,45,7,89,24,8,58,24,268,2,59,62,8,11,6,272,11,8,62,6,2,2,344,6,13,62,62,260,62,62,2,2,6,16,4,24,7,195,15,10,64,7,11,6,89,2,11,58,4,89,24,114,272,2,5,17,13,272,62,11,6,6,2,276,64,24,2,24,8,56,62,2,91,2,24,272,272,2,107,121,24,13,64,47,59,15,24,2,2,24,103,312,24,3,62,11,272,191,2,10,6,2,320,268,12,64,260,91,2,51,64,2,16,25,7,276,26,13,245,272,108,187,6,93,276,6,24,2,264,11,24,11,2,20,328,4,11,2,2,24,9,272,3,6,45,6,2,272,2,2,64,7,11,62,89,6,272,264,7,49,64,62,6,7,24,6,3,2,2,191,6,2,45,62,26,2,89,20,24,2,272,24,8,268,24,8,7,195,120,24,2,264,27,272,24,2,24,58,15,2,62,102,16,7,24,40,8,17,24,2,24,7,6,316,1,4,62,11,7,2,2,2,2,86,272,61,24,7,11,272,89,5,5,91,11,8,62,24,2,2,98,2,64,24,3,91,2,8,20,62,24,2,11,8,62,70,5,324,63,2,2,2,62,8,2,5,24,24,20,7,191,59,22,2,89,11,89,11,8,8,93,53,7,11,13,11,25,2,15,24,62,2,5,272,2,270,20,7,6,18,24,9,191,191,2,62,291,2,62,2,91,6,272,24,6,2,2,18,2,24,264,2,7,272,272,24,2,24,24,2,62,24,62,11,62,59,24,260,6,24,24,62,60,11,2,62,62,24,38,6,9,332,90,5,11,6,8,2,62,5,3,2,16,17,10,20,2,6,2,113,62,62,7,17,328,18,2,11,59,2,2,45,328,7,8,51,2,2,64,11,2,89,16,47,64,195,272,2,8,11,59,20,62,5,2,24,20,2,1,9,4,24,191,2,48,11,8,11,24,2,272,62,20,268,3,6,7,62,2,71,272,268,95,24,24,24,62,62,62,5,20,11,7,13,7,6,195,22,7,62,2,2,34,2,58,2,5,24,61,82,5,2,24,107,2,272,62,5,20,2,24,2,8,64,91,2,2,6,83,2,64,2,45,2,195,276,4,10,60,10,16,9,24,264,25,11,59,24,6,62,8,48,13,11,2,60,59,2,13,20,11,2,8,6,64,24,52,89,11,2,2,6,2,2,8,272,55,272,20,2,6,1,24,7,7,7,12,14,62,24,320,2,191,2,48,13,2,9,43,60,6,112,191,137,24,11,2,272,62,5,40,2,88,7,272,2,60,13,24,6,58,24,13,6,272,272,2,56,24,272,62,24,2,6,7,62,5,13,3,7,24,4,58,3,47,268,7,272,64,5,62,58,92,2,11,62,24,58,9,90,6,59,13,11,11,2,24,7,2,2,13,105,2,13,24,5,8,8,59,20,118,8,8,59,2,11,24,13,2,62,2,13,268,264,24,24,20,24,11,5,10,7,58,59,93,11,2,24,24,11,91,52,62,2,2,272,344,3,61,24,3,88,13,2,2,3,1,2,1,324,24,2,100,2,64,92,89,97,7,7,11,11,13,6,8,91,272,51,24,62,62,58,340,58,1,2,60,272,7,79,29,2,8,59,6,6,2,24,8,2,46,6,24,11,24,24,2,195,320,24,6,118,6,272,6,14,64,89,96,2,11,24,476,7,1,69,332,24,44,18,11,11,7,8,2,272,12,17,2,84,2,91,62,2,11,2,320,8,6,58,2,42,24,4,6,2,13,91,24,2,328,62,5,2,1,64,2,6,64,11,244,47,7,98,320,2,62,11,91,2,61,20,89,24,46,62,2,2,2,272,4,60,7,2,6,24,24,61,2,18,272,2,59,2,2,24,2,8,96,71,64,24,2,26,2,2,11,8,11,2,2,7,91,332,2,2,109,4,9,8,8,64,56,64,11,62,11,24,272,47,3,7,6,24,2,272,9,272,24,2,41,6,348,7,17,6,2,11,5,11,11,4,2,276,191,9,2,7,8,62,2,13,9,276,272,2,334,24,6,2,24,2,2,24,24,4,59,7,58,24,7,2,20,6,2,272,24,2,5,89,1,20,11,64,91,2,7,11,13,62,2,7,72,2,5,59,2,62,2,61,2,18,114,11,24,7,49,3,64,59,58,89,2,16,272,5,2,6,24,7,312,5,4,2,13,8,2,62,44,8,2,91,316,7,2,15,97,8,69,20,9,62,62,62,2,13,5,7,352,8,11,85,2,9,6,43,272,6,2,33,50,2,11,3,1,50,2,10,2,60,59,7,64,56,2,24,24,40,89,24,13,11706,103,6,48,2,62,64,64,2,3,2,62};
-size_t *s = zmalloc(sizeof(samples));
-memcpy(s,samples,sizeof(samples));
-srandom(time(NULL));
-return s;
+
+static void bigKeysReport(int final) {
+    prefixNode **sorted;
+    char mem[64];
+    int j;
+
+    scanProgress();
+    if (!final && ++bigkeys.reports % BIGKEYS_REPORT_PERIOD) return;
+
+    printf("\n");
+    printBigKeys(&bigkeys.bymem,"memory");
+    printBigKeys(&bigkeys.bylen,"length");
+
+    sorted = zmalloc(sizeof(prefixNode*)*(bigkeys.numnodes+1));
+    memcpy(sorted,bigkeys.nodes,sizeof(prefixNode*)*bigkeys.numnodes);
+    qsort(sorted,bigkeys.numnodes,sizeof(prefixNode*),prefixCompareMem);
+    printf("Prefixes using more memory (%d tracked, %lld dropped):\n",
+        bigkeys.numnodes, bigkeys.dropped);
+    for (j = bigkeys.numnodes-1; j >= 0 && j >= bigkeys.numnodes-config.top;
+         j--)
+    {
+        bytesToHuman(mem,sorted[j]->mem);
+        printf("  %10s %6.2f%% %12lld keys  ", mem,
+            bigkeys.root.mem ? (double)sorted[j]->mem*100/bigkeys.root.mem : 0,
+            sorted[j]->keys);
+        printPrefix(sorted[j]);
+        printf("\n");
+    }
+    printf("\n");
+    zfree(sorted);
 }
-#endif
 
-/* The following function implements the "vmpage" statistic, that is,
- * it tries to perform a few simulations with data gained from the dataset
- * in order to understand what's the best vm-page-size for your dataset.
- *
- * How dows it work? We use VMPAGE_PAGES pages of different sizes, and simulate
- * adding data with sizes sampled from the real dataset, in a random way.
- * While doing this we take stats about how efficiently our application is
- * using the swap file with every given page size. The best will win.
- *
- * Why the thing we take "fixed" is the number of pages? It's our constant
- * as Redis will use one bit of RAM for every page in the swap file, so we
- * want to optimized page size while the number of pages is taken fixed. */
-#define VMPAGE_PAGES 1000000
-static void vmpage() {
-    redisContext *c = config.context;
-    int j, pagesize, bestpagesize = 0;
-    double bestscore = 0;
-    size_t *samples;
-
-    samples = sampleDataset(c,SAMPLE_SERIALIZEDLEN);
-    printf("Simulate fragmentation with different page sizes...\n");
-    for (pagesize = 8; pagesize <= 1024*64; pagesize*=2) {
-        size_t totpages = VMPAGE_PAGES;
-        unsigned char *pages = zmalloc(totpages);
-        size_t stored_bytes, used_pages;
-        double score;
-
-        printf("%d: ",pagesize);
-        fflush(stdout);
-        stored_bytes = used_pages = 0;
-        memset(pages,0,totpages);
-        while(1) {
-            int r = random() % config.samplesize;
-            size_t bytes_needed = samples[r];
-            size_t pages_needed = (bytes_needed+(pagesize-1))/pagesize;
-
-            for(j = 0; j < 200; j++) {
-                size_t off = random()%(totpages-(pages_needed-1));
-                size_t i;
-
-                for (i = off; i < off+pages_needed; i++)
-                    if (pages[i] != 0) break;
-                if (i == off+pages_needed) {
-                    memset(pages+off,1,pages_needed);
-                    used_pages += pages_needed;
-                    stored_bytes += bytes_needed;
-                    break;
-                }
+static void bigKeys(void) {
+    if (config.top < 1) config.top = 1;
+    if (config.prefixnodes < 2) config.prefixnodes = 2;
+    bigkeys.bymem.keys = zmalloc(sizeof(bigKey)*config.top);
+    bigkeys.bylen.keys = zmalloc(sizeof(bigKey)*config.top);
+    bigkeys.bymem.numkeys = bigkeys.bylen.numkeys = 0;
+    memset(&bigkeys.root,0,sizeof(bigkeys.root));
+    bigkeys.maxnodes = config.prefixnodes+64;
+    bigkeys.nodes = zmalloc(sizeof(prefixNode*)*bigkeys.maxnodes);
+    bigkeys.numnodes = 0;
+    bigkeys.tablesize = 1;
+    while (bigkeys.tablesize < (unsigned int)config.prefixnodes*2)
+        bigkeys.tablesize *= 2;
+    bigkeys.table = zmalloc(sizeof(prefixNode*)*bigkeys.tablesize);
+    memset(bigkeys.table,0,sizeof(prefixNode*)*bigkeys.tablesize);
+    bigkeys.dropped = 0;
+    bigkeys.reports = 0;
+    scanKeyspace(bigKeysKey,bigKeysReport);
+}
+
+/* The "replay" stat reads a recording made with "record", without any
+ * server: for every field, the percentiles of its values in the window,
+ * and for the counters the percentiles of their rate per second between
+ * two samples. A counter going back was reset, by a restart (the uptime
+ * went back too) or CONFIG RESETSTAT: there is no rate for that interval
+ * only. A field going back in more than one interval every
+ * REPLAY_MAX_RESETS is not a counter. */
+#define REPLAY_FIELDS "used_memory,used_memory_rss,connected_clients," \
+    "blocked_clients,total_commands_processed,total_connections_received," \
+    "keyspace_hits,keyspace_misses,expired_keys,evicted_keys,db0.keys," \
+    "used_cpu_sys,used_cpu_user"
+#define REPLAY_MAX_RESETS 100
+
+typedef struct replayField {
+    char *name;
+    int id;                 /* -1 until the field is seen */
+    int scaled;             /* decimal field, values are times 1000 */
+    histogram *values;
+    histogram *rates;       /* times 1000 */
+    long long last, lastms;
+    int seen;
+    long long resets;       /* decreases, but at restarts */
+    int prev;               /* "last" is the value of the previous sample */
+} replayField;
+
+/* Parse a time of the replay window: unix time, a date, or a time ago. */
+static long long parseReplayTime(char *s) {
+    struct tm tm;
+    char *end;
+    double n;
+
+    memset(&tm,0,sizeof(tm));
+    if (s[0] == '-') {
+        n = strtod(s+1,&end);
+        switch(*end) {
+        case 'd': n *= 24;
+        /* fall through */
+        case 'h': n *= 60;
+        /* fall through */
+        case 'm': n *= 60;
+        }
+        return microseconds()/1000-(long long)(n*1000);
+    }
+    if ((end = strptime(s,"%Y-%m-%d %H:%M",&tm)) != NULL) {
+        if (*end == ':') strptime(end+1,"%S",&tm);
+        tm.tm_isdst = -1;
+        return (long long)mktime(&tm)*1000;
+    }
+    return strtoll(s,NULL,10)*1000;
+}
+
+/* Print a value kept as an integer times "unit". */
+static void printReplayValue(double v, double unit) {
+    char buf[64];
+
+    if (unit > 1) snprintf(buf,sizeof(buf),"%.3f",v/unit);
+    else snprintf(buf,sizeof(buf),"%.0f",v);
+    printf(" %12s",buf);
+}
+
+static void printReplayStats(replayField *f, histogram *h, double unit) {
+    printf("%-28s",f->name);
+    printReplayValue(h->min,unit);
+    printReplayValue(histMean(h),unit);
+    printReplayValue(histPercentile(h,50),unit);
+    printReplayValue(histPercentile(h,99),unit);
+    printReplayValue(h->max,unit);
+    printf("\n");
+}
+
+static int replayCounter(replayField *f) {
+    return f->rates->count &&
+           (unsigned long long)f->resets*REPLAY_MAX_RESETS <= f->rates->count;
+}
+
+static void replay(void) {
+    tsReader *r = tsOpen(config.replayfile);
+    long long from = config.from ? parseReplayTime(config.from) : 0;
+    long long to = config.to ? parseReplayTime(config.to) : LLONG_MAX;
+    long long first = 0, last = 0, samples = 0;
+    replayField *fields = NULL;
+    int numfields = 0, known = 0, j, counters = 0, uptimeid = -1, restarted;
+    long long uptime = 0;
+    char *list = zstrdup(config.fields), *name, buf[2][64];
+    time_t t;
+
+    if (r == NULL) {
+        fprintf(stderr, "Error opening %s: %s\n", config.replayfile,
+            errno == EINVAL ? "not a redis-stat recording" : strerror(errno));
+        exit(1);
+    }
+    for (name = strtok(list,", "); name; name = strtok(NULL,", ")) {
+        fields = zrealloc(fields,sizeof(replayField)*(numfields+1));
+        memset(fields+numfields,0,sizeof(replayField));
+        fields[numfields].name = name;
+        fields[numfields].id = -1;
+        fields[numfields].values = histCreate();
+        fields[numfields].rates = histCreate();
+        numfields++;
+    }
+
+    while (tsNext(r)) {
+        if (r->ms < from) continue;
+        if (r->ms > to) break;
+        if (samples++ == 0) first = r->ms;
+        last = r->ms;
+        /* Fields appear as the server adds them (a new DB, a command run
+         * for the first time): look the missing ones up again. */
+        if (known != r->fields.numfields) {
+            known = r->fields.numfields;
+            if (uptimeid == -1) uptimeid = tsFieldId(r,"uptime_in_seconds");
+            for (j = 0; j < numfields; j++) {
+                if (fields[j].id != -1) continue;
+                fields[j].id = tsFieldId(r,fields[j].name);
+                if (fields[j].id != -1)
+                    fields[j].scaled = r->fields.scales[fields[j].id] != 0;
             }
-            if (j == 200) break;
         }
-        printf("bytes per page: %.2lf, space efficiency: %.2lf%%\n",
-            (double)stored_bytes/totpages,
-            ((double)stored_bytes*100)/(totpages*pagesize));
-        score = ((double)stored_bytes/totpages)*
-                (((double)stored_bytes*100)/(totpages*pagesize));
-        if (bestpagesize == 0 || bestscore < score) {
-            bestpagesize = pagesize;
-            bestscore = score;
+        restarted = 0;
+        if (uptimeid != -1 && tsPresent(r,uptimeid)) {
+            restarted = r->fields.values[uptimeid] < uptime;
+            uptime = r->fields.values[uptimeid];
         }
-        zfree(pages);
-    }
-    printf("\nThe best compromise between bytes per page and swap file size: %d\n", bestpagesize);
-    zfree(samples);
-}
-
-#define SCALE_POWEROFTWO 0
-#define SCALE_LINEAR_SMALL 1
-#define SCALE_LINEAR_MED 2
-#define SCALE_LINEAR_LARGE 3
-#define SCALE_LINEAR_AUTO 4
-#define GRAPH_ROWS 20
-#define GRAPH_BAR_LEN 50
-static void samplesToGraph(size_t *samples, int scaletype) {
-    size_t freq[GRAPH_ROWS];
-    size_t scale[GRAPH_ROWS];
-    size_t max = 0, sum = 0;
-    int j, i, high;
-
-    /* Best linear scale auto detection */
-    if (scaletype == SCALE_LINEAR_AUTO) {
-        scaletype = SCALE_LINEAR_SMALL;
-        for (j = 0; j < config.samplesize; j++) {
-            if (scaletype == SCALE_LINEAR_SMALL && samples[j] > 1*GRAPH_ROWS)
-                scaletype = SCALE_LINEAR_MED;
-            if (scaletype == SCALE_LINEAR_MED && samples[j] > 5*GRAPH_ROWS) {
-                scaletype = SCALE_LINEAR_LARGE;
-                break; /* there is no scale bigger than this. */
+        for (j = 0; j < numfields; j++) {
+            replayField *f = fields+j;
+            long long v;
+
+            /* A field left out of INFO (the keyspace of an empty DB) has
+             * no value, and no rate with the next one. */
+            if (f->id == -1 || !tsPresent(r,f->id)) {
+                f->prev = 0;
+                continue;
             }
+            v = r->fields.values[f->id];
+            histAdd(f->values,v < 0 ? 0 : v);
+            if (f->prev && v < f->last) {
+                if (!restarted) f->resets++;
+            } else if (f->prev && r->ms > f->lastms) {
+                histAdd(f->rates,(unsigned long long)
+                    ((double)(v-f->last)*1000000/(r->ms-f->lastms)));
+            }
+            f->last = v;
+            f->lastms = r->ms;
+            f->seen = f->prev = 1;
         }
     }
 
-    /* Initialize the frequency table and the scale. */
-    memset(freq,0,sizeof(freq));
-    for (j = 0; j < GRAPH_ROWS; j++) {
-        switch(scaletype) {
-        case SCALE_POWEROFTWO:
-            scale[j] = (size_t) pow(2,j);
-            break;
-        case SCALE_LINEAR_SMALL:
-            scale[j] = j+1;
-            break;
-        case SCALE_LINEAR_MED:
-            scale[j] = (j+1)*5;
-            break;
-        case SCALE_LINEAR_LARGE:
-            scale[j] = (j+1)*50;
-            break;
+    t = first/1000;
+    strftime(buf[0],sizeof(buf[0]),"%Y-%m-%d %H:%M:%S",localtime(&t));
+    t = last/1000;
+    strftime(buf[1],sizeof(buf[1]),"%Y-%m-%d %H:%M:%S",localtime(&t));
+    printf("%lld samples from %s to %s (%.0f seconds)\n\n", samples,
+        samples ? buf[0] : "-", samples ? buf[1] : "-",
+        (double)(last-first)/1000);
+
+    printf("%-28s %12s %12s %12s %12s %12s\n", "field", "min", "mean",
+        "p50", "p99", "max");
+    for (j = 0; j < numfields; j++) {
+        if (!fields[j].seen) {
+            printf("%-28s not recorded\n", fields[j].name);
+            continue;
         }
+        printReplayStats(fields+j,fields[j].values,
+            fields[j].scaled ? 1000 : 1);
+        if (replayCounter(fields+j)) counters++;
     }
-    /* Increment the frequency table accordingly to the sample value */
-    for (j = 0; j < config.samplesize; j++) {
-        i = GRAPH_ROWS-1;
-        while (i > 0 && scale[i-1] >= samples[j]) i--;
-        freq[i]++;
-        printf("SAMPLE: %ld\n", samples[j]);
-    }
-    /* Check what's the highest non-zero frequency element, so we can avoid
-     * printing the part of the histogram that's empty. We also need the
-     * max value in the freq table. */
-    for (high = GRAPH_ROWS-1; high > 0; high--)
-        if (freq[high]) break;
-    for (j = 0; j <= high; j++) {
-        if (max < freq[j]) max = freq[j];
-        sum += freq[j];
-    }
-    /* Our ASCII art business can start */
-    for (j = 0; j <= high; j++) {
-        char buf[64];
-        char bar[GRAPH_BAR_LEN+1];
-        int barlen;
-
-        if (j != high)
-            sprintf(buf,"<= %ld",(long)scale[j]);
-        else
-            sprintf(buf,">  %ld",(long)scale[j-1]);
-        barlen = (freq[j]*GRAPH_BAR_LEN)/max;
-        memset(bar,'-',barlen);
-        bar[barlen] = '\0';
-        printf("%-13s |%s (%.2f%%)\n", buf, bar,
-            (float)freq[j]*100/sum);
+    if (counters) {
+        printf("\n%-28s %12s %12s %12s %12s %12s\n", "rate per second",
+            "min", "mean", "p50", "p99", "max");
+        for (j = 0; j < numfields; j++) {
+            replayField *f = fields+j;
+
+            if (!f->seen || !replayCounter(f)) continue;
+            /* The rates are kept in thousandths. */
+            printReplayStats(f,f->rates,f->scaled ? 1000000 : 1000);
+        }
     }
-    zfree(samples);
-}
 
-static void ondiskSize() {
-    redisContext *c = config.context;
-    size_t *samples;
-
-    samples = sampleDataset(c,SAMPLE_SERIALIZEDLEN);
-    if (config.logscale) {
-        samplesToGraph(samples, SCALE_POWEROFTWO);
-    } else {
-        samplesToGraph(samples, SCALE_LINEAR_AUTO);
+    for (j = 0; j < numfields; j++) {
+        histRelease(fields[j].values);
+        histRelease(fields[j].rates);
     }
+    zfree(fields);
+    zfree(list);
+    tsClose(r);
 }
 
 static void usage(char *wrong) {
@@ -525,16 +2061,50 @@ static void usage(char *wrong) {
 "Statistic types:\n"
 " overview (default)   Print general information about a Redis instance.\n"
 " vmstat               Print information about Redis VM activity.\n"
-" vmpage               Try to guess the best vm-page-size for your dataset.\n"
+" memory-efficiency    Simulate the memory used by keys like the sampled ones\n"
+"                      with different allocators: bytes per key and waste.\n"
+"                      Only the string keys are simulated.\n"
 " ondisk-size          Stats and graphs about values len once stored on disk.\n"
+" memory-size          Stats and graphs about the memory used by values.\n"
+" analyze              Scan the whole keyspace: percentage of types, average\n"
+"                      length and memory per type, bytes per key.\n"
+" bigkeys              Scan the whole keyspace for the largest keys and the\n"
+"                      prefixes using more memory.\n"
 " latency              Measure Redis server latency.\n"
+" intrinsic-latency    Measure the latency of this host, without a server.\n"
+" exporter             Serve the INFO fields of the instances in the\n"
+"                      Prometheus format on http://<listen>/metrics.\n"
+" replay <file>        Stats of the fields of a recording: percentiles of\n"
+"                      the values, and of the rates of the counters.\n"
 "\n"
 "Options:\n"
 " host <hostname>      Server hostname (default 127.0.0.1)\n"
 " port <hostname>      Server port (default 6379)\n"
+" hosts <host:port,..> Poll all these instances concurrently (overview and\n"
+"                      exporter)\n"
+" hostsfile <file>     Like hosts, reading the list from a file\n"
+" listen <[ip:]port>  Address of the exporter (default 127.0.0.1:9121)\n"
+" record <file>        Append the INFO samples of overview and vmstat to a\n"
+"                      file, <file>.<host>.<port> for every host of hosts.\n"
 " delay <milliseconds> Delay between requests (default: 1000 ms, 1 second).\n"
-" samplesize <keys>    Number of keys to sample for 'vmpage' stat.\n"
+" rate <pings/s>       Sample the latency at this rate, printing percentiles\n"
+"                      every 'delay' milliseconds.\n"
+" samplesize <keys>    Number of keys to sample (default 10000).\n"
 " logscale             User power-of-two logarithmic scale in graphs.\n"
+" csv, json            Print the graphs of value sizes as CSV or JSON.\n"
+" connections <n>      Parallel connections of keyspace scans (default 4,\n"
+"                      always 1 with Redis Cluster)\n"
+" scancount <n>        COUNT of every SCAN of keyspace scans (default 100)\n"
+" budget <ms>          Slow keyspace scans down when the server latency is\n"
+"                      over this budget (default: no limit)\n"
+" top <n>              Keys and prefixes listed by 'bigkeys' (default 10)\n"
+" delimiter <char>     Delimiter of the key prefixes (default ':')\n"
+" prefixnodes <n>      Max prefixes tracked by 'bigkeys' (default 10000)\n"
+" fields <f1,f2,..>    Fields shown by 'replay' (default used_memory,\n"
+"                      clients, commands, connections, keys, cpu and more)\n"
+" from <time>          Start of the window of 'replay': unix time,\n"
+"                      'YYYY-MM-DD HH:MM[:SS]' or a time ago: -30m, -2h, -7d\n"
+" to <time>            End of the window of 'replay', in the same format\n"
 );
     exit(1);
 }
@@ -551,24 +2121,85 @@ static int parseOptions(int argc, char **argv) {
         } else if (!strcmp(argv[i],"port") && !lastarg) {
             config.hostport = atoi(argv[i+1]);
             i++;
+        } else if (!strcmp(argv[i],"hosts") && !lastarg) {
+            addInstances(argv[i+1]);
+            i++;
+        } else if (!strcmp(argv[i],"hostsfile") && !lastarg) {
+            addInstancesFromFile(argv[i+1]);
+            i++;
+        } else if (!strcmp(argv[i],"record") && !lastarg) {
+            config.recordfile = argv[i+1];
+            i++;
+        } else if (!strcmp(argv[i],"replay") && !lastarg) {
+            config.stat = STAT_REPLAY;
+            config.replayfile = argv[i+1];
+            i++;
+        } else if (!strcmp(argv[i],"listen") && !lastarg) {
+            config.listen = argv[i+1];
+            i++;
+        } else if (!strcmp(argv[i],"fields") && !lastarg) {
+            config.fields = argv[i+1];
+            i++;
+        } else if (!strcmp(argv[i],"from") && !lastarg) {
+            config.from = argv[i+1];
+            i++;
+        } else if (!strcmp(argv[i],"to") && !lastarg) {
+            config.to = argv[i+1];
+            i++;
         } else if (!strcmp(argv[i],"delay") && !lastarg) {
             config.delay = atoi(argv[i+1]);
             i++;
+        } else if (!strcmp(argv[i],"connections") && !lastarg) {
+            config.connections = atoi(argv[i+1]);
+            i++;
+        } else if (!strcmp(argv[i],"scancount") && !lastarg) {
+            config.scancount = atoi(argv[i+1]);
+            i++;
+        } else if (!strcmp(argv[i],"top") && !lastarg) {
+            config.top = atoi(argv[i+1]);
+            i++;
+        } else if (!strcmp(argv[i],"delimiter") && !lastarg) {
+            config.delimiter = argv[i+1][0];
+            i++;
+        } else if (!strcmp(argv[i],"prefixnodes") && !lastarg) {
+            config.prefixnodes = atoi(argv[i+1]);
+            i++;
+        } else if (!strcmp(argv[i],"budget") && !lastarg) {
+            config.budget = atoi(argv[i+1]);
+            i++;
+        } else if (!strcmp(argv[i],"rate") && !lastarg) {
+            config.rate = atoi(argv[i+1]);
+            i++;
         } else if (!strcmp(argv[i],"samplesize") && !lastarg) {
             config.samplesize = atoi(argv[i+1]);
             i++;
         } else if (!strcmp(argv[i],"vmstat")) {
             config.stat = STAT_VMSTAT;
-        } else if (!strcmp(argv[i],"vmpage")) {
-            config.stat = STAT_VMPAGE;
+        } else if (!strcmp(argv[i],"memory-efficiency") ||
+                   !strcmp(argv[i],"vmpage")) {
+            config.stat = STAT_MEMORY_EFFICIENCY;
         } else if (!strcmp(argv[i],"overview")) {
             config.stat = STAT_OVERVIEW;
         } else if (!strcmp(argv[i],"ondisk-size")) {
             config.stat = STAT_ONDISK_SIZE;
+        } else if (!strcmp(argv[i],"bigkeys")) {
+            config.stat = STAT_BIGKEYS;
+        } else if (!strcmp(argv[i],"analyze")) {
+            config.stat = STAT_ANALYZE;
+        } else if (!strcmp(argv[i],"memory-size")) {
+            config.stat = STAT_MEMORY_SIZE;
         } else if (!strcmp(argv[i],"latency")) {
             config.stat = STAT_LATENCY;
+        } else if (!strcmp(argv[i],"intrinsic-latency")) {
+            config.stat = STAT_INTRINSIC_LATENCY;
+        } else if (!strcmp(argv[i],"exporter")) {
+            config.stat = STAT_EXPORTER;
         } else if (!strcmp(argv[i],"logscale")) {
             config.logscale = 1;
+        } else if (!strcmp(argv[i],"csv")) {
+            config.format = HIST_FORMAT_CSV;
+        } else if (!strcmp(argv[i],"json")) {
+            config.format = HIST_FORMAT_JSON;
         } else if (!strcmp(argv[i],"help")) {
             usage(NULL);
         } else {
@@ -587,27 +2218,97 @@ int main(int argc, char **argv) {
     config.delay = 1000;
     config.samplesize = 10000;
     config.logscale = 0;
+    config.format = HIST_FORMAT_TEXT;
+    config.rate = 0;
+    config.info = infoCreate();
+    config.instances = NULL;
+    config.numinstances = 0;
+    config.round = 0;
+    config.replies = 0;
+    config.connections = 4;
+    config.scancount = 100;
+    config.budget = 0;
+    config.top = 10;
+    config.prefixnodes = 10000;
+    config.delimiter = ':';
+    config.recordfile = NULL;
+    config.recorder = NULL;
+    config.replayfile = NULL;
+    config.fields = REPLAY_FIELDS;
+    config.from = config.to = NULL;
+    config.listen = "127.0.0.1:9121";
 
     parseOptions(argc,argv);
+    srandom(time(NULL));
+
+    if (config.stat == STAT_INTRINSIC_LATENCY) {
+        intrinsicLatency();
+        return 0;
+    }
+    if (config.stat == STAT_REPLAY) {
+        replay();
+        return 0;
+    }
+    if (config.recordfile && config.stat != STAT_OVERVIEW &&
+        config.stat != STAT_VMSTAT) {
+        fprintf(stderr, "Error: only overview and vmstat can be recorded\n");
+        exit(1);
+    }
+    if (config.samplesize < 1) {
+        fprintf(stderr, "Error: the sample size must be at least 1 key\n");
+        exit(1);
+    }
+
+    /* Rounds are aligned to multiples of the delay on the wall clock. */
+    if ((config.stat == STAT_EXPORTER || config.numinstances) &&
+        config.delay <= 0)
+    {
+        fprintf(stderr, "Error: the delay must be at least 1 ms with "
+                        "multiple hosts and exporter\n");
+        exit(1);
+    }
+    if (config.stat == STAT_EXPORTER) {
+        exporterMain();
+        return 0;
+    }
+    if (config.numinstances) {
+        if (config.stat != STAT_OVERVIEW) {
+            fprintf(stderr,
+                "Error: only overview and exporter support multiple hosts\n");
+            exit(1);
+        }
+        fleet();
+        return 0;
+    }
 
     c = config.context = redisConnect(config.hostip,config.hostport);
     if (c->err) {
         fprintf(stderr, "Error connecting to Redis: %s\n", c->errstr);
         exit(1);
     }
+    if (config.recordfile) config.recorder = openRecording(config.recordfile);
 
     switch(config.stat) {
     case STAT_VMSTAT:
         vmstat();
         break;
-    case STAT_VMPAGE:
-        vmpage();
+    case STAT_MEMORY_EFFICIENCY:
+        memoryEfficiency();
         break;
     case STAT_OVERVIEW:
         overview();
         break;
     case STAT_ONDISK_SIZE:
-        ondiskSize();
+        valueSize(SAMPLE_SERIALIZEDLEN);
+        break;
+    case STAT_MEMORY_SIZE:
+        valueSize(SAMPLE_MEMORY);
+        break;
+    case STAT_ANALYZE:
+        analyze();
+        break;
+    case STAT_BIGKEYS:
+        bigKeys();
         break;
     case STAT_LATENCY:
         latency();
@@ -0,0 +1,759 @@
+/* Local RESP stand-in server used by the benchmarks.
+ *
+ * Copyright (c) 2009-2010, Salvatore Sanfilippo <antirez at gmail dot com>
+ * All rights reserved.
+ *
+ * This software is NOT released under a free software license.
+ * It is a commercial tool, under the terms of the license you can find in
+ * the COPYING file in the Redis-Tools distribution.
+ *
+ * The stand-in speaks just enough of the protocol to drive client side
+ * benchmarks without a real Redis, so that what is measured is the client.
+ * Commands are parsed with the hiredis reader and either answered with
+ * canned replies of a fixed size, whatever the key, or executed against a
+ * small in-memory keyspace of strings, lists and hashes, so that clients
+ * reading their data back (redis-load check) work as well. Replies can be
+ * delayed to simulate a slow server.
+ */
+
+#include "fmacros.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <strings.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "ae.h"
+#include "adlist.h"
+#include "hiredis.h"
+#include "sds.h"
+#include "zmalloc.h"
+#include "standin.h"
+
+#define STANDIN_IOBUF (1024*16)
+#define STANDIN_TABLE_INITIAL 16
+
+#define OBJ_STRING 0
+#define OBJ_LIST 1
+#define OBJ_HASH 2
+
+/* Canned replies, used when the keyspace is not stored */
+#define CANNED_NONE 0   /* always run the command */
+#define CANNED_OK 1     /* +OK */
+#define CANNED_ONE 2    /* :1 */
+#define CANNED_VALUE 3  /* the canned value */
+#define CANNED_PAIR 4   /* a field/value pair */
+
+/* ------------------------------- Hash table -------------------------------
+ * A minimal chained hash table with sds keys, used both for the keyspace
+ * and for the fields of hashes. It doubles when it gets as many entries as
+ * buckets. */
+typedef struct tableEntry {
+    sds key;
+    void *val;
+    struct tableEntry *next;
+} tableEntry;
+
+typedef struct table {
+    tableEntry **buckets;
+    unsigned long size, used;
+    void (*freeval)(void *val);
+} table;
+
+typedef struct object {
+    int type;
+    void *ptr;  /* sds, list or table */
+} object;
+
+typedef struct standinClient {
+    int fd;
+    void *reader;
+    sds obuf;
+    int writing;
+    long long delayid;  /* time event of a delayed reply, or -1 */
+} standinClient;
+
+typedef struct standinCommand {
+    char *name;
+    int arity;  /* number of arguments, or -N for N or more */
+    void (*proc)(standinClient *c, redisReply *r);
+    int canned;
+} standinCommand;
+
+static struct {
+    aeEventLoop *el;
+    standinConfig cfg;
+    table *db;
+    sds value;          /* canned value */
+    unsigned int seed;  /* picks the delayed commands, deterministic */
+    long long clients;
+    long long connections;
+    long long commands;
+} server;
+
+static void standinWritable(aeEventLoop *el, int fd, void *privdata, int mask);
+
+static unsigned int hashKey(const char *key, size_t len) {
+    unsigned int hash = 5381;
+
+    while (len--) hash = ((hash << 5) + hash) + (unsigned char)*key++;
+    return hash;
+}
+
+static table *tableCreate(void (*freeval)(void *val)) {
+    table *t = zmalloc(sizeof(*t));
+
+    t->size = STANDIN_TABLE_INITIAL;
+    t->used = 0;
+    t->buckets = zmalloc(sizeof(tableEntry*)*t->size);
+    memset(t->buckets,0,sizeof(tableEntry*)*t->size);
+    t->freeval = freeval;
+    return t;
+}
+
+static void tableRelease(table *t) {
+    tableEntry *e, *next;
+    unsigned long j;
+
+    for (j = 0; j < t->size; j++) {
+        for (e = t->buckets[j]; e != NULL; e = next) {
+            next = e->next;
+            sdsfree(e->key);
+            t->freeval(e->val);
+            zfree(e);
+        }
+    }
+    zfree(t->buckets);
+    zfree(t);
+}
+
+static tableEntry **tableLookup(table *t, const char *key, size_t len) {
+    tableEntry **e = &t->buckets[hashKey(key,len) & (t->size-1)];
+
+    while (*e && (sdslen((*e)->key) != len || memcmp((*e)->key,key,len)))
+        e = &(*e)->next;
+    return e;
+}
+
+static void *tableFind(table *t, const char *key, size_t len) {
+    tableEntry *e = *tableLookup(t,key,len);
+    return e ? e->val : NULL;
+}
+
+static void tableExpand(table *t) {
+    unsigned long size = t->size*2, j;
+    tableEntry **buckets = zmalloc(sizeof(tableEntry*)*size);
+    tableEntry *e, *next;
+
+    memset(buckets,0,sizeof(tableEntry*)*size);
+    for (j = 0; j < t->size; j++) {
+        for (e = t->buckets[j]; e != NULL; e = next) {
+            unsigned long h = hashKey(e->key,sdslen(e->key)) & (size-1);
+
+            next = e->next;
+            e->next = buckets[h];
+            buckets[h] = e;
+        }
+    }
+    zfree(t->buckets);
+    t->buckets = buckets;
+    t->size = size;
+}
+
+/* Set "key" to "val", freeing the old value. Returns 1 when the key is
+ * new. */
+static int tableReplace(table *t, const char *key, size_t len, void *val) {
+    tableEntry **ep = tableLookup(t,key,len), *e = *ep;
+
+    if (e) {
+        t->freeval(e->val);
+        e->val = val;
+        return 0;
+    }
+    e = zmalloc(sizeof(*e));
+    e->key = sdsnewlen(key,len);
+    e->val = val;
+    e->next = NULL;
+    *ep = e;
+    if (++t->used >= t->size) tableExpand(t);
+    return 1;
+}
+
+static int tableDelete(table *t, const char *key, size_t len) {
+    tableEntry **ep = tableLookup(t,key,len), *e = *ep;
+
+    if (e == NULL) return 0;
+    *ep = e->next;
+    sdsfree(e->key);
+    t->freeval(e->val);
+    zfree(e);
+    t->used--;
+    return 1;
+}
+
+static void freeSds(void *s) {
+    sdsfree(s);
+}
+
+static void freeObject(void *ptr) {
+    object *o = ptr;
+
+    if (o->type == OBJ_STRING) sdsfree(o->ptr);
+    else if (o->type == OBJ_LIST) listRelease(o->ptr);
+    else tableRelease(o->ptr);
+    zfree(o);
+}
+
+static object *createObject(int type) {
+    object *o = zmalloc(sizeof(*o));
+
+    o->type = type;
+    if (type == OBJ_LIST) {
+        o->ptr = listCreate();
+        listSetFreeMethod((list*)o->ptr,freeSds);
+    } else if (type == OBJ_HASH) {
+        o->ptr = tableCreate(freeSds);
+    } else {
+        o->ptr = NULL;
+    }
+    return o;
+}
+
+/* -------------------------------- Replies --------------------------------- */
+static void addReply(standinClient *c, const char *s, size_t len) {
+    c->obuf = sdscatlen(c->obuf,s,len);
+}
+
+static void addReplyStr(standinClient *c, const char *s) {
+    addReply(c,s,strlen(s));
+}
+
+static void addReplyLong(standinClient *c, char prefix, long long n) {
+    c->obuf = sdscatprintf(c->obuf,"%c%lld\r\n",prefix,n);
+}
+
+static void addReplyBulk(standinClient *c, const char *s, size_t len) {
+    addReplyLong(c,'$',len);
+    addReply(c,s,len);
+    addReply(c,"\r\n",2);
+}
+
+static void addReplyNil(standinClient *c) {
+    addReply(c,"$-1\r\n",5);
+}
+
+static void addReplyWrongType(standinClient *c) {
+    addReplyStr(c,"-ERR Operation against a key holding the wrong kind of value\r\n");
+}
+
+/* ------------------------------- Commands --------------------------------- */
+#define ARG(j) (r->element[j]->str)
+#define ARGLEN(j) ((size_t)r->element[j]->len)
+
+/* Return the object at the key in argument 1, or NULL when it doesn't
+ * exist. When it exists with another type an error is replied and
+ * *wrongtype is set. */
+static object *lookupKey(standinClient *c, redisReply *r, int type,
+                         int *wrongtype)
+{
+    object *o = tableFind(server.db,ARG(1),ARGLEN(1));
+
+    *wrongtype = 0;
+    if (o && o->type != type) {
+        addReplyWrongType(c);
+        *wrongtype = 1;
+        return NULL;
+    }
+    return o;
+}
+
+static object *lookupKeyOrCreate(standinClient *c, redisReply *r, int type) {
+    int wrongtype;
+    object *o = lookupKey(c,r,type,&wrongtype);
+
+    if (o == NULL && !wrongtype) {
+        o = createObject(type);
+        tableReplace(server.db,ARG(1),ARGLEN(1),o);
+    }
+    return o;
+}
+
+static void pingCommand(standinClient *c, redisReply *r) {
+    ((void)r);
+    addReply(c,"+PONG\r\n",7);
+}
+
+static void echoCommand(standinClient *c, redisReply *r) {
+    addReplyBulk(c,ARG(1),ARGLEN(1));
+}
+
+static void okCommand(standinClient *c, redisReply *r) {
+    ((void)r);
+    addReply(c,"+OK\r\n",5);
+}
+
+static void getCommand(standinClient *c, redisReply *r) {
+    int wrongtype;
+    object *o = lookupKey(c,r,OBJ_STRING,&wrongtype);
+
+    if (wrongtype) return;
+    if (o == NULL) addReplyNil(c);
+    else addReplyBulk(c,o->ptr,sdslen(o->ptr));
+}
+
+static void setCommand(standinClient *c, redisReply *r) {
+    object *o = createObject(OBJ_STRING);
+
+    o->ptr = sdsnewlen(ARG(2),ARGLEN(2));
+    tableReplace(server.db,ARG(1),ARGLEN(1),o);
+    addReply(c,"+OK\r\n",5);
+}
+
+static void incrCommand(standinClient *c, redisReply *r) {
+    object *o = lookupKeyOrCreate(c,r,OBJ_STRING);
+    long long value;
+
+    if (o == NULL) return;
+    value = o->ptr ? strtoll(o->ptr,NULL,10)+1 : 1;
+    if (o->ptr) sdsfree(o->ptr);
+    o->ptr = sdscatprintf(sdsempty(),"%lld",value);
+    addReplyLong(c,':',value);
+}
+
+static void delCommand(standinClient *c, redisReply *r) {
+    size_t j;
+    int deleted = 0;
+
+    for (j = 1; j < r->elements; j++)
+        deleted += tableDelete(server.db,ARG(j),ARGLEN(j));
+    addReplyLong(c,':',deleted);
+}
+
+static void existsCommand(standinClient *c, redisReply *r) {
+    addReplyLong(c,':',tableFind(server.db,ARG(1),ARGLEN(1)) != NULL);
+}
+
+static void pushGenericCommand(standinClient *c, redisReply *r, int head) {
+    object *o = lookupKeyOrCreate(c,r,OBJ_LIST);
+    size_t j;
+
+    if (o == NULL) return;
+    for (j = 2; j < r->elements; j++) {
+        sds value = sdsnewlen(ARG(j),ARGLEN(j));
+
+        if (head) listAddNodeHead(o->ptr,value);
+        else listAddNodeTail(o->ptr,value);
+    }
+    addReplyLong(c,':',listLength((list*)o->ptr));
+}
+
+static void lpushCommand(standinClient *c, redisReply *r) {
+    pushGenericCommand(c,r,1);
+}
+
+static void rpushCommand(standinClient *c, redisReply *r) {
+    pushGenericCommand(c,r,0);
+}
+
+static void popGenericCommand(standinClient *c, redisReply *r, int head) {
+    int wrongtype;
+    object *o = lookupKey(c,r,OBJ_LIST,&wrongtype);
+    listNode *ln;
+    sds value;
+
+    if (wrongtype) return;
+    if (o == NULL) {
+        addReplyNil(c);
+        return;
+    }
+    ln = head ? listFirst((list*)o->ptr) : listLast((list*)o->ptr);
+    value = listNodeValue(ln);
+    addReplyBulk(c,value,sdslen(value));
+    listDelNode(o->ptr,ln);
+    if (listLength((list*)o->ptr) == 0)
+        tableDelete(server.db,ARG(1),ARGLEN(1));
+}
+
+static void lpopCommand(standinClient *c, redisReply *r) {
+    popGenericCommand(c,r,1);
+}
+
+static void rpopCommand(standinClient *c, redisReply *r) {
+    popGenericCommand(c,r,0);
+}
+
+static void llenCommand(standinClient *c, redisReply *r) {
+    int wrongtype;
+    object *o = lookupKey(c,r,OBJ_LIST,&wrongtype);
+
+    if (wrongtype) return;
+    addReplyLong(c,':',o ? listLength((list*)o->ptr) : 0);
+}
+
+static void hsetCommand(standinClient *c, redisReply *r) {
+    object *o = lookupKeyOrCreate(c,r,OBJ_HASH);
+    int added;
+
+    if (o == NULL) return;
+    added = tableReplace(o->ptr,ARG(2),ARGLEN(2),sdsnewlen(ARG(3),ARGLEN(3)));
+    addReplyLong(c,':',added);
+}
+
+static void hgetCommand(standinClient *c, redisReply *r) {
+    int wrongtype;
+    object *o = lookupKey(c,r,OBJ_HASH,&wrongtype);
+    sds value;
+
+    if (wrongtype) return;
+    if (o == NULL || (value = tableFind(o->ptr,ARG(2),ARGLEN(2))) == NULL)
+        addReplyNil(c);
+    else
+        addReplyBulk(c,value,sdslen(value));
+}
+
+static void hgetallCommand(standinClient *c, redisReply *r) {
+    int wrongtype;
+    object *o = lookupKey(c,r,OBJ_HASH,&wrongtype);
+    table *t;
+    tableEntry *e;
+    unsigned long j;
+
+    if (wrongtype) return;
+    if (o == NULL) {
+        addReply(c,"*0\r\n",4);
+        return;
+    }
+    t = o->ptr;
+    addReplyLong(c,'*',t->used*2);
+    for (j = 0; j < t->size; j++) {
+        for (e = t->buckets[j]; e != NULL; e = e->next) {
+            addReplyBulk(c,e->key,sdslen(e->key));
+            addReplyBulk(c,e->val,sdslen(e->val));
+        }
+    }
+}
+
+static void dbsizeCommand(standinClient *c, redisReply *r) {
+    ((void)r);
+    addReplyLong(c,':',server.db->used);
+}
+
+static void flushallCommand(standinClient *c, redisReply *r) {
+    ((void)r);
+    tableRelease(server.db);
+    server.db = tableCreate(freeObject);
+    addReply(c,"+OK\r\n",5);
+}
+
+static void infoCommand(standinClient *c, redisReply *r) {
+    sds info;
+    ((void)r);
+
+    info = sdscatprintf(sdsempty(),
+        "redis_version:standin\r\n"
+        "connected_clients:%lld\r\n"
+        "blocked_clients:0\r\n"
+        "used_memory:%zu\r\n"
+        "total_connections_received:%lld\r\n"
+        "total_commands_processed:%lld\r\n"
+        "bgsave_in_progress:0\r\n"
+        "aof_rewrite_in_progress:0\r\n"
+        "vm_enabled:0\r\n",
+        server.clients, zmalloc_used_memory(), server.connections,
+        server.commands);
+    if (server.db->used)
+        info = sdscatprintf(info,"db0:keys=%lu,expires=0\r\n",server.db->used);
+    addReplyBulk(c,info,sdslen(info));
+    sdsfree(info);
+}
+
+static standinCommand commandTable[] = {
+    {"ping",1,pingCommand,CANNED_NONE},
+    {"echo",2,echoCommand,CANNED_NONE},
+    {"select",2,okCommand,CANNED_NONE},
+    {"debug",-2,okCommand,CANNED_NONE},
+    {"info",-1,infoCommand,CANNED_NONE},
+    {"get",2,getCommand,CANNED_VALUE},
+    {"set",3,setCommand,CANNED_OK},
+    {"incr",2,incrCommand,CANNED_ONE},
+    {"del",-2,delCommand,CANNED_ONE},
+    {"exists",2,existsCommand,CANNED_ONE},
+    {"lpush",-3,lpushCommand,CANNED_ONE},
+    {"rpush",-3,rpushCommand,CANNED_ONE},
+    {"lpop",2,lpopCommand,CANNED_VALUE},
+    {"rpop",2,rpopCommand,CANNED_VALUE},
+    {"llen",2,llenCommand,CANNED_ONE},
+    {"hset",4,hsetCommand,CANNED_ONE},
+    {"hget",3,hgetCommand,CANNED_VALUE},
+    {"hgetall",2,hgetallCommand,CANNED_PAIR},
+    {"dbsize",1,dbsizeCommand,CANNED_ONE},
+    {"flushall",1,flushallCommand,CANNED_OK},
+    {NULL,0,NULL,0}
+};
+
+static standinCommand *lookupCommand(const char *name) {
+    standinCommand *cmd;
+
+    for (cmd = commandTable; cmd->name; cmd++)
+        if (!strcasecmp(cmd->name,name)) return cmd;
+    return NULL;
+}
+
+static void addCannedReply(standinClient *c, int canned) {
+    switch(canned) {
+    case CANNED_OK: addReply(c,"+OK\r\n",5); break;
+    case CANNED_ONE: addReply(c,":1\r\n",4); break;
+    case CANNED_VALUE: addReply(c,server.value,sdslen(server.value)); break;
+    case CANNED_PAIR:
+        addReply(c,"*2\r\n$5\r\nfield\r\n",15);
+        addReply(c,server.value,sdslen(server.value));
+        break;
+    }
+}
+
+static void processCommand(standinClient *c, redisReply *r) {
+    standinCommand *cmd;
+    size_t j;
+
+    if (r->type != REDIS_REPLY_ARRAY || r->elements == 0) {
+        addReplyStr(c,"-ERR protocol error\r\n");
+        return;
+    }
+    for (j = 0; j < r->elements; j++) {
+        if (r->element[j]->type != REDIS_REPLY_STRING) {
+            addReplyStr(c,"-ERR protocol error\r\n");
+            return;
+        }
+    }
+    server.commands++;
+    if ((cmd = lookupCommand(ARG(0))) == NULL) {
+        c->obuf = sdscatprintf(c->obuf,"-ERR unknown command '%s'\r\n",ARG(0));
+    } else if ((cmd->arity > 0 && (int)r->elements != cmd->arity) ||
+               (cmd->arity < 0 && (int)r->elements < -cmd->arity))
+    {
+        c->obuf = sdscatprintf(c->obuf,
+            "-ERR wrong number of arguments for '%s' command\r\n",cmd->name);
+    } else if (!server.cfg.store && cmd->canned != CANNED_NONE) {
+        addCannedReply(c,cmd->canned);
+    } else {
+        cmd->proc(c,r);
+    }
+}
+
+/* ------------------------------- Networking ------------------------------- */
+static void freeStandinClient(standinClient *c) {
+    aeDeleteFileEvent(server.el,c->fd,AE_READABLE|AE_WRITABLE);
+    if (c->delayid != -1) aeDeleteTimeEvent(server.el,c->delayid);
+    close(c->fd);
+    redisReplyReaderFree(c->reader);
+    sdsfree(c->obuf);
+    zfree(c);
+    server.clients--;
+}
+
+/* Write as much of the output buffer as the socket takes. The writable
+ * handler is only installed when something is left. Returns -1 when the
+ * client was freed. */
+static int flushStandinClient(standinClient *c) {
+    ssize_t nwritten;
+
+    while (sdslen(c->obuf)) {
+        nwritten = write(c->fd,c->obuf,sdslen(c->obuf));
+        if (nwritten == -1) {
+            if (errno == EAGAIN) break;
+            freeStandinClient(c);
+            return -1;
+        }
+        c->obuf = sdsrange(c->obuf,nwritten,-1);
+    }
+    if (sdslen(c->obuf) && !c->writing) {
+        aeCreateFileEvent(server.el,c->fd,AE_WRITABLE,standinWritable,c);
+        c->writing = 1;
+    } else if (!sdslen(c->obuf) && c->writing) {
+        aeDeleteFileEvent(server.el,c->fd,AE_WRITABLE);
+        c->writing = 0;
+    }
+    return 0;
+}
+
+static void standinWritable(aeEventLoop *el, int fd, void *privdata, int mask) {
+    AE_NOTUSED(el); AE_NOTUSED(fd); AE_NOTUSED(mask);
+    flushStandinClient(privdata);
+}
+
+static void standinReadable(aeEventLoop *el, int fd, void *privdata, int mask);
+
+/* The replies of a delayed client are written when the delay expires, and
+ * it only starts reading again then, so replies keep their order. */
+static int standinDelayExpired(aeEventLoop *el, long long id, void *privdata) {
+    standinClient *c = privdata;
+    AE_NOTUSED(id);
+
+    c->delayid = -1;
+    if (flushStandinClient(c) == 0)
+        aeCreateFileEvent(el,c->fd,AE_READABLE,standinReadable,c);
+    return AE_NOMORE;
+}
+
+static int shouldDelay(void) {
+    if (server.cfg.delay <= 0 || server.cfg.delayperc <= 0) return 0;
+    server.seed = server.seed*1103515245+12345;
+    return (int)((server.seed >> 16) % 100) < server.cfg.delayperc;
+}
+
+static void standinReadable(aeEventLoop *el, int fd, void *privdata, int mask) {
+    standinClient *c = privdata;
+    char buf[STANDIN_IOBUF];
+    void *reply;
+    ssize_t nread;
+    int delay = 0;
+    AE_NOTUSED(mask);
+
+    nread = read(fd,buf,sizeof(buf));
+    if (nread == -1 && errno == EAGAIN) return;
+    if (nread <= 0) {
+        freeStandinClient(c);
+        return;
+    }
+    redisReplyReaderFeed(c->reader,buf,nread);
+    while (redisReplyReaderGetReply(c->reader,&reply) == REDIS_OK &&
+           reply != NULL)
+    {
+        processCommand(c,reply);
+        freeReplyObject(reply);
+        if (shouldDelay()) delay = 1;
+    }
+    if (redisReplyReaderGetError(c->reader) != NULL) {
+        freeStandinClient(c);
+        return;
+    }
+    if (delay) {
+        aeDeleteFileEvent(el,fd,AE_READABLE);
+        c->delayid = aeCreateTimeEvent(el,server.cfg.delay,
+                                       standinDelayExpired,c,NULL);
+        return;
+    }
+    /* Replies to a pipeline are written in one go. */
+    flushStandinClient(c);
+}
+
+static void standinAccept(aeEventLoop *el, int fd, void *privdata, int mask) {
+    standinClient *c;
+    int cfd, yes = 1;
+    AE_NOTUSED(privdata); AE_NOTUSED(mask);
+
+    cfd = accept(fd,NULL,NULL);
+    if (cfd == -1) return;
+    fcntl(cfd,F_SETFL,fcntl(cfd,F_GETFL)|O_NONBLOCK);
+    setsockopt(cfd,IPPROTO_TCP,TCP_NODELAY,&yes,sizeof(yes));
+
+    c = zmalloc(sizeof(*c));
+    c->fd = cfd;
+    c->reader = redisReplyReaderCreate();
+    c->obuf = sdsempty();
+    c->writing = 0;
+    c->delayid = -1;
+    if (aeCreateFileEvent(el,cfd,AE_READABLE,standinReadable,c) == AE_ERR) {
+        close(cfd);
+        redisReplyReaderFree(c->reader);
+        sdsfree(c->obuf);
+        zfree(c);
+        return;
+    }
+    server.clients++;
+    server.connections++;
+}
+
+void standinDefaultConfig(standinConfig *cfg) {
+    cfg->port = 0;
+    cfg->store = 0;
+    cfg->valuelen = 64;
+    cfg->delay = 0;
+    cfg->delayperc = 100;
+}
+
+/* Create the listening socket on the loopback interface. The port actually
+ * used is stored in *port, that can be 0 to pick any free port. */
+int standinListen(int *port) {
+    struct sockaddr_in sa;
+    socklen_t salen = sizeof(sa);
+    int fd, yes = 1;
+
+    if ((fd = socket(AF_INET,SOCK_STREAM,0)) == -1) return -1;
+    setsockopt(fd,SOL_SOCKET,SO_REUSEADDR,&yes,sizeof(yes));
+    memset(&sa,0,sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons(*port);
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd,(struct sockaddr*)&sa,sizeof(sa)) == -1 ||
+        listen(fd,511) == -1 ||
+        getsockname(fd,(struct sockaddr*)&sa,&salen) == -1)
+    {
+        close(fd);
+        return -1;
+    }
+    *port = ntohs(sa.sin_port);
+    return fd;
+}
+
+/* Serve the clients connecting to the listening socket "fd" forever. */
+void standinServe(standinConfig *cfg, int fd) {
+    signal(SIGPIPE,SIG_IGN);
+    server.cfg = *cfg;
+    server.db = tableCreate(freeObject);
+    server.seed = 1;
+    server.clients = server.connections = server.commands = 0;
+    server.value = sdscatprintf(sdsempty(),"$%zu\r\n",cfg->valuelen);
+    server.value = sdsMakeRoomFor(server.value,cfg->valuelen+2);
+    memset(server.value+sdslen(server.value),'x',cfg->valuelen);
+    sdsIncrLen(server.value,cfg->valuelen);
+    server.value = sdscatlen(server.value,"\r\n",2);
+    server.el = aeCreateEventLoop();
+    aeCreateFileEvent(server.el,fd,AE_READABLE,standinAccept,NULL);
+    aeMain(server.el);
+}
+
+static pid_t standinChild = 0;
+
+static void standinAtExit(void) {
+    standinKill(standinChild);
+}
+
+/* Start the stand-in in a child process. The listening socket is created
+ * before forking, so clients can connect as soon as this returns. The port
+ * actually used is stored in cfg->port. Returns the pid of the child or -1
+ * on error. The child is killed when the parent exits. */
+pid_t standinSpawn(standinConfig *cfg) {
+    pid_t pid;
+    int fd;
+
+    if ((fd = standinListen(&cfg->port)) == -1) return -1;
+    if ((pid = fork()) != 0) {
+        close(fd);
+        if (pid > 0) {
+            if (standinChild == 0) atexit(standinAtExit);
+            standinChild = pid;
+        }
+        return pid;
+    }
+    signal(SIGINT,SIG_IGN); /* Ctrl+C is for the parent */
+    standinServe(cfg,fd);
+    _exit(0);
+}
+
+void standinKill(pid_t pid) {
+    if (pid <= 0) return;
+    if (pid == standinChild) standinChild = 0;
+    kill(pid,SIGTERM);
+    waitpid(pid,NULL,0);
+}
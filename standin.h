@@ -0,0 +1,30 @@
+/* Local RESP stand-in server used by the benchmarks.
+ *
+ * Copyright (c) 2009-2010, Salvatore Sanfilippo <antirez at gmail dot com>
+ * All rights reserved.
+ *
+ * This software is NOT released under a free software license.
+ * It is a commercial tool, under the terms of the license you can find in
+ * the COPYING file in the Redis-Tools distribution.
+ */
+
+#ifndef __REDISTOOLS_STANDIN_H
+#define __REDISTOOLS_STANDIN_H
+
+#include <sys/types.h>
+
+typedef struct standinConfig {
+    int port;           /* TCP port, 0 means any free port */
+    int store;          /* 1 = keep the data in memory, 0 = canned replies */
+    size_t valuelen;    /* length of the canned values */
+    int delay;          /* milliseconds replies are delayed by */
+    int delayperc;      /* percentage of the commands that are delayed */
+} standinConfig;
+
+void standinDefaultConfig(standinConfig *cfg);
+int standinListen(int *port);
+void standinServe(standinConfig *cfg, int fd);
+pid_t standinSpawn(standinConfig *cfg);
+void standinKill(pid_t pid);
+
+#endif
@@ -0,0 +1,449 @@
+/* Compact on-disk time series of INFO samples.
+ *
+ * Copyright (c) 2009-2010, Salvatore Sanfilippo <antirez at gmail dot com>
+ * All rights reserved.
+ *
+ * This software is NOT released under a free software license.
+ * It is a commercial tool, under the terms of the license you can find in
+ * the COPYING file in the Redis-Tools distribution.
+ *
+ * Every numeric INFO field gets an id the first time it is seen, and a
+ * sample only stores the fields that changed since the previous sample,
+ * as the difference from the previous value. Decimal values (the CPU time,
+ * the fragmentation ratio) are kept with TS_DECIMAL_DIGITS digits. The
+ * file is a header followed by records:
+ *
+ *   "RSTS" <version byte>
+ *   'F' <name length> <name> <scale byte>    a new field, ids are in order
+ *   'S' <ms delta> <fields> <bitmap> <value deltas...>
+ *
+ * where the bitmap has a bit for each of the first <fields> fields, set
+ * when the field changed, and the value deltas follow for the set bits.
+ * Numbers are varints of 7 bits per byte, and the deltas are zigzag
+ * encoded so that small negative ones are small too: most fields take one
+ * bit in a sample, and the counters one or two bytes.
+ *
+ * INFO leaves some fields out at times (the keyspace line of an empty DB,
+ * the aof_* fields), so a field missing from a sample is a change too: its
+ * value is written as 0, and the deltas of the fields present are written
+ * plus one. A field coming back is a delta from its last value.
+ *
+ * The reader maps the file in memory and decodes it in order. A record
+ * cut short by a crash ends the recording, and the writer truncates it
+ * away before appending, after reading the fields and the last values of
+ * the file so that the deltas go on where they were left.
+ */
+
+#include "fmacros.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "tseries.h"
+#include "zmalloc.h"
+
+#define TS_MAGIC "RSTS"
+#define TS_VERSION 1
+#define TS_HEADER_LEN 5
+#define TS_TABLE_MIN 64
+
+/* ------------------------------ Fields ---------------------------------- */
+
+static unsigned int tsHash(const char *s) {
+    unsigned int hash = 5381;
+
+    while (*s) hash = ((hash << 5) + hash) + (unsigned char)*s++;
+    return hash;
+}
+
+static void tsInitFields(tsFields *f) {
+    f->names = NULL;
+    f->scales = NULL;
+    f->values = NULL;
+    f->present = NULL;
+    f->numfields = f->maxfields = 0;
+    f->table = NULL;
+    f->tablesize = 0;
+}
+
+static void tsFreeFields(tsFields *f) {
+    int j;
+
+    for (j = 0; j < f->numfields; j++) zfree(f->names[j]);
+    zfree(f->names);
+    zfree(f->scales);
+    zfree(f->values);
+    zfree(f->present);
+    zfree(f->table);
+}
+
+static int tsLookup(tsFields *f, const char *name) {
+    unsigned int mask, h;
+    int id;
+
+    if (f->tablesize == 0) return -1;
+    mask = f->tablesize-1;
+    for (h = tsHash(name) & mask; (id = f->table[h]) != -1; h = (h+1) & mask)
+        if (!strcmp(f->names[id],name)) return id;
+    return -1;
+}
+
+/* Index the field "id" in the table, growing it to stay half empty. */
+static void tsIndex(tsFields *f, int id) {
+    unsigned int mask, h;
+    int j;
+
+    if ((unsigned int)f->numfields*2 > f->tablesize) {
+        zfree(f->table);
+        f->tablesize = f->tablesize ? f->tablesize*2 : TS_TABLE_MIN;
+        f->table = zmalloc(sizeof(int)*f->tablesize);
+        memset(f->table,-1,sizeof(int)*f->tablesize);
+        for (j = 0; j < id; j++) tsIndex(f,j);
+    }
+    mask = f->tablesize-1;
+    for (h = tsHash(f->names[id]) & mask; f->table[h] != -1; h = (h+1) & mask);
+    f->table[h] = id;
+}
+
+static int tsAddField(tsFields *f, const char *name, size_t len, int scale) {
+    int id = f->numfields;
+
+    if (f->numfields == f->maxfields) {
+        f->maxfields = f->maxfields ? f->maxfields*2 : 128;
+        f->names = zrealloc(f->names,sizeof(char*)*f->maxfields);
+        f->scales = zrealloc(f->scales,sizeof(int)*f->maxfields);
+        f->values = zrealloc(f->values,sizeof(long long)*f->maxfields);
+        f->present = zrealloc(f->present,f->maxfields);
+    }
+    f->names[id] = zmalloc(len+1);
+    memcpy(f->names[id],name,len);
+    f->names[id][len] = '\0';
+    f->scales[id] = scale;
+    f->values[id] = 0;
+    f->present[id] = 0;
+    f->numfields++;
+    tsIndex(f,id);
+    return id;
+}
+
+/* Parse a numeric INFO value. Returns 0 when it is not a number, else sets
+ * "scale" to the digits it needs (0 for integers) and "d" to its value. */
+static int tsParseValue(const char *s, int *scale, double *d) {
+    char *end;
+
+    if (*s == '\0') return 0;
+    errno = 0;
+    *d = (double)strtoll(s,&end,10);
+    if (*end == '\0' && errno == 0) {
+        *scale = 0;
+        return 1;
+    }
+    *d = strtod(s,&end);
+    if (*end != '\0' || *d != *d || fabs(*d) > 1e15) return 0;
+    *scale = TS_DECIMAL_DIGITS;
+    return 1;
+}
+
+static long long tsScale(double d, int scale) {
+    return scale ? llround(d*1000) : llround(d);
+}
+
+/* ------------------------------ Varints --------------------------------- */
+
+static unsigned long long tsZigZag(long long n) {
+    return ((unsigned long long)n << 1) ^ (unsigned long long)(n >> 63);
+}
+
+static long long tsUnZigZag(unsigned long long n) {
+    return (long long)(n >> 1) ^ -(long long)(n & 1);
+}
+
+/* Decode a varint at "*p", not reading past "end". Returns 0 when it is
+ * truncated or too long. */
+static int tsGetVarint(unsigned char **p, unsigned char *end,
+                       unsigned long long *v)
+{
+    int shift = 0;
+
+    *v = 0;
+    while (*p < end && shift < 64) {
+        unsigned char byte = *(*p)++;
+
+        *v |= (unsigned long long)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return 1;
+        shift += 7;
+    }
+    return 0;
+}
+
+/* ------------------------------ Reader ---------------------------------- */
+
+/* Map a recording in memory. Returns NULL with errno set on errors, EINVAL
+ * when the file is not a recording. */
+tsReader *tsOpen(const char *filename) {
+    tsReader *r;
+    struct stat sb;
+    void *map;
+    int fd = open(filename,O_RDONLY);
+
+    if (fd == -1) return NULL;
+    if (fstat(fd,&sb) == -1) {
+        close(fd);
+        return NULL;
+    }
+    if (sb.st_size < TS_HEADER_LEN) {
+        close(fd);
+        errno = EINVAL;
+        return NULL;
+    }
+    map = mmap(NULL,sb.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+    close(fd);
+    if (map == MAP_FAILED) return NULL;
+    if (memcmp(map,TS_MAGIC,4) || ((unsigned char*)map)[4] != TS_VERSION) {
+        munmap(map,sb.st_size);
+        errno = EINVAL;
+        return NULL;
+    }
+    madvise(map,sb.st_size,MADV_SEQUENTIAL);
+
+    r = zmalloc(sizeof(*r));
+    r->map = map;
+    r->size = sb.st_size;
+    r->pos = TS_HEADER_LEN;
+    r->ms = 0;
+    tsInitFields(&r->fields);
+    return r;
+}
+
+void tsClose(tsReader *r) {
+    munmap(r->map,r->size);
+    tsFreeFields(&r->fields);
+    zfree(r);
+}
+
+/* Decode the next sample: afterwards r->ms is its time and the values of
+ * the fields are in r->fields.values. Returns 0 at the end of the file, or
+ * at the first incomplete or invalid record. */
+int tsNext(tsReader *r) {
+    tsFields *f = &r->fields;
+    unsigned char *end = r->map+r->size;
+
+    while (r->pos < r->size) {
+        unsigned char *p = r->map+r->pos+1, *bitmap;
+        unsigned long long len, v, numfields;
+        int j;
+
+        if (r->map[r->pos] == 'F') {
+            if (!tsGetVarint(&p,end,&len) || len > (size_t)(end-p) ||
+                (size_t)(end-p) < len+1) return 0;
+            tsAddField(f,(char*)p,len,p[len]);
+            r->pos = (p+len+1)-r->map;
+        } else if (r->map[r->pos] == 'S') {
+            if (!tsGetVarint(&p,end,&v) || !tsGetVarint(&p,end,&numfields) ||
+                numfields > (unsigned long long)f->numfields ||
+                (size_t)(end-p) < (numfields+7)/8) return 0;
+            bitmap = p;
+            p += (numfields+7)/8;
+            /* Decode first, the sample is only applied when complete. */
+            for (j = 0; j < (int)numfields; j++) {
+                if (!(bitmap[j/8] & (1 << (j%8)))) continue;
+                if (!tsGetVarint(&p,end,&v)) return 0;
+            }
+            p = r->map+r->pos+1;
+            tsGetVarint(&p,end,&v);
+            r->ms += tsUnZigZag(v);
+            tsGetVarint(&p,end,&numfields);
+            p += (numfields+7)/8;
+            for (j = 0; j < (int)numfields; j++) {
+                if (!(bitmap[j/8] & (1 << (j%8)))) continue;
+                tsGetVarint(&p,end,&v);
+                f->present[j] = v != 0;
+                if (v) f->values[j] += tsUnZigZag(v-1);
+            }
+            r->pos = p-r->map;
+            return 1;
+        } else {
+            return 0;
+        }
+    }
+    return 0;
+}
+
+/* The id of a field, or -1 if it was not seen so far. */
+int tsFieldId(tsReader *r, const char *name) {
+    return tsLookup(&r->fields,name);
+}
+
+double tsValue(tsReader *r, int id) {
+    double v = (double)r->fields.values[id];
+
+    return r->fields.scales[id] ? v/1000 : v;
+}
+
+/* True if the field was in the current sample: else its value is the last
+ * one it had. */
+int tsPresent(tsReader *r, int id) {
+    return r->fields.present[id];
+}
+
+/* ------------------------------ Writer ---------------------------------- */
+
+static void tsReserve(tsWriter *w, size_t len) {
+    if (w->len+len > w->alloc) {
+        w->alloc = (w->len+len)*2;
+        w->buf = zrealloc(w->buf,w->alloc);
+    }
+}
+
+static void tsPutVarint(tsWriter *w, unsigned long long v) {
+    tsReserve(w,10);
+    while (v >= 0x80) {
+        w->buf[w->len++] = (unsigned char)(v | 0x80);
+        v >>= 7;
+    }
+    w->buf[w->len++] = (unsigned char)v;
+}
+
+/* Make room for the fields in the per sample arrays, clearing the new part
+ * of the bitmap. */
+static void tsGrow(tsWriter *w) {
+    int size = w->fields.maxfields, old = (w->size+7)/8;
+
+    if (w->size >= size) return;
+    w->changed = zrealloc(w->changed,(size+7)/8);
+    memset(w->changed+old,0,(size+7)/8-old);
+    w->next = zrealloc(w->next,sizeof(long long)*size);
+    w->seen = zrealloc(w->seen,size);
+    memset(w->seen+w->size,0,size-w->size);
+    w->size = size;
+}
+
+/* Open a recording for appending, creating it if needed. Returns NULL with
+ * errno set on errors, EINVAL when the file exists but is not a recording. */
+tsWriter *tsCreateWriter(const char *filename) {
+    tsWriter *w;
+    struct stat sb;
+    int exists = stat(filename,&sb) == 0 && sb.st_size > 0;
+
+    w = zmalloc(sizeof(*w));
+    w->filename = zstrdup(filename);
+    w->ms = 0;
+    w->buf = w->changed = w->seen = NULL;
+    w->next = NULL;
+    w->len = w->alloc = 0;
+    w->size = 0;
+    tsInitFields(&w->fields);
+    if (exists) {
+        tsReader *r = tsOpen(filename);
+
+        if (r == NULL) goto err;
+        while (tsNext(r));
+        /* Take over the fields and values, and drop what was not written
+         * completely. */
+        w->fields = r->fields;
+        w->ms = r->ms;
+        tsInitFields(&r->fields);
+        tsGrow(w);
+        if (truncate(filename,r->pos) == -1) {
+            tsClose(r);
+            goto err;
+        }
+        tsClose(r);
+    }
+    if ((w->fp = fopen(filename,"a")) == NULL) goto err;
+    if (!exists) {
+        fwrite(TS_MAGIC,4,1,w->fp);
+        fputc(TS_VERSION,w->fp);
+        if (fflush(w->fp) == EOF) {
+            fclose(w->fp);
+            goto err;
+        }
+    }
+    return w;
+
+err:
+    w->fp = NULL;
+    tsReleaseWriter(w);
+    return NULL;
+}
+
+void tsReleaseWriter(tsWriter *w) {
+    int saved = errno;
+
+    if (w->fp) fclose(w->fp);
+    tsFreeFields(&w->fields);
+    zfree(w->filename);
+    zfree(w->buf);
+    zfree(w->changed);
+    zfree(w->next);
+    zfree(w->seen);
+    zfree(w);
+    errno = saved;
+}
+
+/* Append the numeric fields of "i" as a sample taken at "ms" milliseconds.
+ * The record is flushed to the file at once. Returns 0 on success, -1 with
+ * errno set on write errors. */
+int tsAppend(tsWriter *w, long long ms, info *i) {
+    tsFields *f = &w->fields;
+    int j, id, scale, bitmaplen;
+    double d;
+
+    /* New fields are defined before the sample that uses them. */
+    w->len = 0;
+    for (j = 0; j < i->numfields; j++) {
+        const char *name = infoName(i,i->fields+j);
+
+        if (!tsParseValue(infoValue(i,i->fields+j),&scale,&d)) continue;
+        if ((id = tsLookup(f,name)) == -1) {
+            size_t len = strlen(name);
+
+            id = tsAddField(f,name,len,scale);
+            tsGrow(w);
+            tsReserve(w,len+12);
+            w->buf[w->len++] = 'F';
+            tsPutVarint(w,len);
+            memcpy(w->buf+w->len,name,len);
+            w->len += len;
+            w->buf[w->len++] = (unsigned char)scale;
+        }
+        w->next[id] = tsScale(d,f->scales[id]);
+        w->seen[id] = 1;
+    }
+    for (j = 0; j < f->numfields; j++) {
+        if (w->seen[j] != f->present[j] ||
+            (w->seen[j] && w->next[j] != f->values[j]))
+            w->changed[j/8] |= 1 << (j%8);
+    }
+
+    bitmaplen = (f->numfields+7)/8;
+    tsReserve(w,1+10+10+bitmaplen);
+    w->buf[w->len++] = 'S';
+    tsPutVarint(w,tsZigZag(ms-w->ms));
+    tsPutVarint(w,f->numfields);
+    memcpy(w->buf+w->len,w->changed,bitmaplen);
+    w->len += bitmaplen;
+    for (j = 0; j < f->numfields; j++) {
+        if (!(w->changed[j/8] & (1 << (j%8)))) continue;
+        f->present[j] = w->seen[j];
+        if (!w->seen[j]) {
+            tsPutVarint(w,0);
+            continue;
+        }
+        tsPutVarint(w,tsZigZag(w->next[j]-f->values[j])+1);
+        f->values[j] = w->next[j];
+    }
+    memset(w->changed,0,bitmaplen);
+    memset(w->seen,0,f->numfields);
+    w->ms = ms;
+
+    if (fwrite(w->buf,w->len,1,w->fp) != 1 || fflush(w->fp) == EOF)
+        return -1;
+    return 0;
+}
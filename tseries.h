@@ -0,0 +1,63 @@
+/* Compact on-disk time series of INFO samples.
+ *
+ * Copyright (c) 2009-2010, Salvatore Sanfilippo <antirez at gmail dot com>
+ * All rights reserved.
+ *
+ * This software is NOT released under a free software license.
+ * It is a commercial tool, under the terms of the license you can find in
+ * the COPYING file in the Redis-Tools distribution.
+ */
+
+#ifndef __REDISTOOLS_TSERIES_H
+#define __REDISTOOLS_TSERIES_H
+
+#include <stdio.h>
+#include "info.h"
+
+/* The fields seen so far in a recording. Ids are given in order of
+ * appearance and never change, so they are valid for the whole file. */
+typedef struct tsFields {
+    char **names;
+    int *scales;            /* decimal digits kept: 0 or TS_DECIMAL_DIGITS */
+    long long *values;      /* last value, times 10^scale */
+    unsigned char *present; /* 1 if the field is in the last sample */
+    int numfields, maxfields;
+    int *table;             /* open addressing index into names, -1 = free */
+    unsigned int tablesize;
+} tsFields;
+
+#define TS_DECIMAL_DIGITS 3
+
+typedef struct tsWriter {
+    char *filename;
+    FILE *fp;
+    tsFields fields;
+    long long ms;           /* time of the last sample */
+    unsigned char *buf;     /* the record being encoded */
+    size_t len, alloc;
+    unsigned char *changed; /* bitmap of the fields changed by this sample */
+    long long *next;        /* and their new values */
+    unsigned char *seen;    /* 1 if the field is in this sample */
+    int size;               /* fields "changed" and "next" can hold */
+} tsWriter;
+
+typedef struct tsReader {
+    unsigned char *map;
+    size_t size;
+    size_t pos;             /* end of the last complete record */
+    tsFields fields;
+    long long ms;           /* time of the current sample */
+} tsReader;
+
+tsWriter *tsCreateWriter(const char *filename);
+void tsReleaseWriter(tsWriter *w);
+int tsAppend(tsWriter *w, long long ms, info *i);
+
+tsReader *tsOpen(const char *filename);
+void tsClose(tsReader *r);
+int tsNext(tsReader *r);
+int tsFieldId(tsReader *r, const char *name);
+double tsValue(tsReader *r, int id);
+int tsPresent(tsReader *r, int id);
+
+#endif